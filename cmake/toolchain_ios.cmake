@@ -8,7 +8,7 @@ set(CMAKE_MACOSX_BUNDLE YES)
 set(CMAKE_TRY_COMPILE_TARGET_TYPE STATIC_LIBRARY )
 
 set(CMAKE_XCODE_ATTRIBUTE_ONLY_ACTIVE_ARCH "YES")
-set(CMAKE_XCODE_ATTRIBUTE_CLANG_CXX_LANGUAGE_STANDARD "c++17")
+set(CMAKE_XCODE_ATTRIBUTE_CLANG_CXX_LANGUAGE_STANDARD "c++20")
 set(CMAKE_XCODE_ATTRIBUTE_CLANG_CXX_LANGUAGE_LIBRARY "libc++")
 set(CMAKE_XCODE_ATTRIBUTE_SKIP_INSTALL "NO")
 set(CMAKE_XCODE_ATTRIBUTE_CODE_SIGN_IDENTITY "Apple Development")
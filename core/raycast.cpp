@@ -40,7 +40,7 @@ namespace core {
 
     class SphereShapeImpl : public BaseShapeImpl {
     public:
-        SphereShapeImpl(const core::SceneInterfacePtr &scene, const std::vector<math::vector3f> &points, const std::vector<double> &radiuses, std::uint64_t id, std::uint64_t m)
+        SphereShapeImpl(const core::SceneInterfacePtr &scene, const util::FrameVector<math::vector3f> &points, const util::FrameVector<double> &radiuses, std::uint64_t id, std::uint64_t m)
         : BaseShapeImpl(id, m)
         {
             for (std::size_t i = 0; i < points.size(); i++) {
@@ -103,7 +103,7 @@ namespace core {
 namespace core {
     class BoxShapeImpl : public BaseShapeImpl {
     public:
-        BoxShapeImpl(const core::SceneInterfacePtr &scene, const std::vector<math::vector3f> &points, const std::vector<math::vector3f> &sizes, std::uint64_t id, std::uint64_t m)
+        BoxShapeImpl(const core::SceneInterfacePtr &scene, const util::FrameVector<math::vector3f> &points, const util::FrameVector<math::vector3f> &sizes, std::uint64_t id, std::uint64_t m)
         : BaseShapeImpl(id, m)
         {
             for (std::size_t i = 0; i < points.size(); i++) {
@@ -223,16 +223,19 @@ namespace core {
     public:
         auto addShape(const util::Description &desc, std::uint64_t uniqueId, std::uint64_t mask) -> ShapePtr override {
             const core::RaycastInterface::ShapeType shapeType = static_cast<core::RaycastInterface::ShapeType>(desc.getInteger("type", 0));
-            const std::vector<math::vector3f> points = desc.getVector3fs("points");
+            util::FrameVector<math::vector3f> points;
+            desc.getVector3fs("points", points);
             ShapePtr result;
             
             if (shapeType == core::RaycastInterface::ShapeType::SPHERES) {
-                const std::vector<double> radiuses = desc.getNumbers("radiuses");
-                result = _shapes.emplace_back(std::make_shared<SphereShapeImpl>(_scene, points, radiuses, uniqueId, mask));
+                util::FrameVector<double> radiuses;
+                desc.getNumbers("radiuses", radiuses);
+                result = util::makeSlotShared(_shapes, std::make_unique<SphereShapeImpl>(_scene, points, radiuses, uniqueId, mask));
             }
             else if (shapeType == core::RaycastInterface::ShapeType::BOXES) {
-                const std::vector<math::vector3f> sizes = desc.getVector3fs("sizes");
-                result = _shapes.emplace_back(std::make_shared<BoxShapeImpl>(_scene, points, sizes, uniqueId, mask));
+                util::FrameVector<math::vector3f> sizes;
+                desc.getVector3fs("sizes", sizes);
+                result = util::makeSlotShared(_shapes, std::make_unique<BoxShapeImpl>(_scene, points, sizes, uniqueId, mask));
             }
             else {
                 _platform->logError("[RaycastInterfaceImpl::addShape] Unknown raycast shape type");
@@ -242,8 +245,8 @@ namespace core {
         auto rayCast(const math::vector3f &start, const math::vector3f &dir, float length, std::uint64_t mask) const -> RaycastResult override {
             RaycastResult result;
             IntersectIntermediateInfo intermediate;
-            for (auto &shape : _shapes) {
-                if (shape->mask & mask) {
+            for (const BaseShapeImpl *shape : *_shapes) {
+                if (shape && (shape->mask & mask)) {
                     shape->preCast(start, dir, length, intermediate);
                 }
             }
@@ -253,14 +256,14 @@ namespace core {
             return result;
         }
         void update(float dtSec) override {
-            util::cleanupUnused(_shapes);
+            _shapes->compact();
         }
         
     private:
         const foundation::PlatformInterfacePtr _platform;
         const core::SceneInterfacePtr _scene;
         
-        std::vector<std::shared_ptr<BaseShapeImpl>> _shapes;
+        const std::shared_ptr<util::SlotMap<BaseShapeImpl *>> _shapes = std::make_shared<util::SlotMap<BaseShapeImpl *>>();
     };
 }
 
@@ -2,6 +2,7 @@
 #include "scene.h"
 #include "palette.h"
 #include "foundation/layouts.h"
+#include "foundation/memory.h"
 
 #include <cfloat>
 #include <memory>
@@ -11,6 +12,10 @@
 
 #include <list>
 
+namespace {
+    const std::uint8_t MEMORY_TAG_CUSTOM_MESH = 1;
+}
+
 namespace core {
     ParticlesParams::ParticlesParams(const util::Description &desc) {
         float bakingTimeTable[] = {
@@ -197,8 +202,16 @@ namespace core {
     
     class VoxelMeshImpl : public SceneInterface::VoxelMesh {
     public:
-        std::unique_ptr<foundation::RenderDataPtr[]> frames;
+        struct VoxelMeshData {
+            math::transform3f transform;
+            math::vector4f frameBlend; // voxel is visible if x <= its dissolve value < y
+        };
+        
+        foundation::RenderDataPtr frames;
+        std::unique_ptr<std::uint32_t[]> frameOffsets; // frameCount + 1 entries, frame i is [frameOffsets[i], frameOffsets[i + 1])
         std::uint32_t frameIndex = 0;
+        std::uint32_t nextFrameIndex = 0;
+        float frameBlend = 0.0f;
         std::uint32_t frameCount = 0;
         math::transform3f transform = math::transform3f::identity();
         util::Description description;
@@ -208,15 +221,16 @@ namespace core {
         math::vector3f currentVoxelOffset;
         
     public:
-        VoxelMeshImpl(const foundation::RenderDataPtr *frameArray, std::uint32_t count, const util::Description &desc) {
+        VoxelMeshImpl(const foundation::RenderDataPtr &data, const std::uint32_t *offsets, std::uint32_t count, const util::Description &desc) {
+            frames = data;
             frameCount = count;
-            frames = std::make_unique<foundation::RenderDataPtr[]>(count);
+            frameOffsets = std::make_unique<std::uint32_t[]>(count + 1);
             description = desc;
             originVoxelOffset = description.getVector3f("offset", {});
             currentVoxelOffset = {0, 0, 0};
-
-            for (std::uint32_t i = 0; i < count; i++) {
-                frames[i] = std::move(frameArray[i]);
+            
+            for (std::uint32_t i = 0; i <= count; i++) {
+                frameOffsets[i] = offsets[i];
             }
         }
         ~VoxelMeshImpl() override {}
@@ -245,7 +259,13 @@ namespace core {
             transform = trfm;
         }
         void setFrame(std::uint32_t index) override {
+            frameIndex = nextFrameIndex = std::min(index, frameCount - 1);
+            frameBlend = 0.0f;
+        }
+        void setFrame(std::uint32_t index, std::uint32_t nextIndex, float blend) override {
             frameIndex = std::min(index, frameCount - 1);
+            nextFrameIndex = std::min(nextIndex, frameCount - 1);
+            frameBlend = frameIndex != nextFrameIndex ? std::max(0.0f, std::min(blend, 1.0f)) : 0.0f;
         }
         std::uint32_t getFrameCount() const override {
             return frameCount;
@@ -289,9 +309,9 @@ namespace core {
     public:
         foundation::RenderShaderPtr shader;
         std::vector<std::pair<foundation::RenderTexturePtr, foundation::SamplerType>> textureList;
-        std::vector<std::uint8_t> shaderConst;
-        std::vector<std::uint8_t> vdata;
-        std::vector<std::uint32_t> idata;
+        std::vector<std::uint8_t, foundation::PoolAllocator<std::uint8_t, foundation::MemoryPoolId::SCENE, MEMORY_TAG_CUSTOM_MESH>> shaderConst;
+        std::vector<std::uint8_t, foundation::PoolAllocator<std::uint8_t, foundation::MemoryPoolId::SCENE, MEMORY_TAG_CUSTOM_MESH>> vdata;
+        std::vector<std::uint32_t, foundation::PoolAllocator<std::uint32_t, foundation::MemoryPoolId::SCENE, MEMORY_TAG_CUSTOM_MESH>> idata;
         std::uint32_t vcount = 0;
         bool drawIntoGBuffer = false;
         
@@ -444,7 +464,7 @@ namespace core {
         auto addLineSet() -> LineSetPtr override;
         auto addBoundingSphere(const math::vector3f &position, float radius, const math::color &rgba) -> BoundingSpherePtr override;
         auto addBoundingBox(const math::vector3f &position, const math::bound3f &bbox, const math::color &rgba) -> BoundingBoxPtr override;
-        auto addVoxelMesh(const std::vector<foundation::RenderDataPtr> &frames, const util::Description &description) -> VoxelMeshPtr override;
+        auto addVoxelMesh(const foundation::RenderDataPtr &frames, const std::vector<std::uint32_t> &frameOffsets, const util::Description &description) -> VoxelMeshPtr override;
         auto addGroundMesh(const foundation::RenderDataPtr &mesh, const foundation::RenderTexturePtr &texture) -> GroundMeshPtr override;
         auto addCustomMesh(const char *shaderName, const char *shaderSrc, const foundation::InputLayout &layout, bool drawIntoGBuffer) -> CustomMeshPtr override;
         auto addParticles(const foundation::RenderTexturePtr &tx, const foundation::RenderTexturePtr &map, const ParticlesParams &params) -> ParticlesPtr override;
@@ -486,14 +506,14 @@ namespace core {
         foundation::RenderTargetPtr _gbuffer;
         foundation::RenderShaderPtr _gbufferToScreenShader;
         
-        std::vector<std::shared_ptr<ArrowsImpl>> _arrows;
-        std::vector<std::shared_ptr<LineSetImpl>> _lineSets;
-        std::vector<std::shared_ptr<BoundingSphereImpl>> _boundingSpheres;
-        std::vector<std::shared_ptr<BoundingBoxImpl>> _boundingBoxes;
-        std::vector<std::shared_ptr<VoxelMeshImpl>> _voxelMeshes;
-        std::vector<std::shared_ptr<GroundMeshImpl>> _groundMeshes;
-        std::vector<std::shared_ptr<CustomMeshImpl>> _customMeshes;
-        std::vector<std::shared_ptr<ParticleEmitterImpl>> _particleEmitters;
+        const std::shared_ptr<util::SlotMap<ArrowsImpl *>> _arrows = std::make_shared<util::SlotMap<ArrowsImpl *>>();
+        const std::shared_ptr<util::SlotMap<LineSetImpl *>> _lineSets = std::make_shared<util::SlotMap<LineSetImpl *>>();
+        const std::shared_ptr<util::SlotMap<BoundingSphereImpl *>> _boundingSpheres = std::make_shared<util::SlotMap<BoundingSphereImpl *>>();
+        const std::shared_ptr<util::SlotMap<BoundingBoxImpl *>> _boundingBoxes = std::make_shared<util::SlotMap<BoundingBoxImpl *>>();
+        const std::shared_ptr<util::SlotMap<VoxelMeshImpl *>> _voxelMeshes = std::make_shared<util::SlotMap<VoxelMeshImpl *>>();
+        const std::shared_ptr<util::SlotMap<GroundMeshImpl *>> _groundMeshes = std::make_shared<util::SlotMap<GroundMeshImpl *>>();
+        const std::shared_ptr<util::SlotMap<CustomMeshImpl *>> _customMeshes = std::make_shared<util::SlotMap<CustomMeshImpl *>>();
+        const std::shared_ptr<util::SlotMap<ParticleEmitterImpl *>> _particleEmitters = std::make_shared<util::SlotMap<ParticleEmitterImpl *>>();
         
         std::unordered_map<std::string, foundation::RenderShaderPtr> _customShaders;
         
@@ -624,12 +644,15 @@ namespace {
         }
         const {
             modelTransform : matrix4
+            frameBlend : float4
         }
         inout {
             normalc : float4
         }
         vssrc {
             float3 cubeCenter = float3(vertex_position_color_mask.xyz);
+            float dissolve = _frac(_dot(cubeCenter, float3(0.2357, 0.4871, 0.7613)));
+            float visible = _step(const_frameBlend.x, dissolve) * (1.0 - _step(const_frameBlend.y, dissolve));
             float3 worldCubePos = _transform(float4(cubeCenter, 1.0), const_modelTransform).xyz;
             float3 toCamSign = _sign(_transform(const_modelTransform, float4(frame_cameraPosition.xyz - worldCubePos, 0.0)).xyz);
             
@@ -641,7 +664,7 @@ namespace {
             float4 absVertexPos = float4(cubeCenter, 0.0) + relVertexPos;
             
             output_normalc = float4(_transform(fixed_normal[faceIndex], const_modelTransform).xyz * 0.5 + 0.5, float(colorIndex) / 255.0); //
-            output_position = _transform(absVertexPos, _transform(const_modelTransform, frame_plmVPMatrix));
+            output_position = visible * _transform(absVertexPos, _transform(const_modelTransform, frame_plmVPMatrix));
         }
         fssrc {
             output_color[0] = input_normalc;
@@ -844,54 +867,53 @@ namespace core {
     }
     
     SceneInterface::ArrowsPtr SceneInterfaceImpl::addArrows() {
-        return _arrows.emplace_back(std::make_shared<ArrowsImpl>());
+        return util::makeSlotShared(_arrows, std::make_unique<ArrowsImpl>());
     }
     
     SceneInterface::LineSetPtr SceneInterfaceImpl::addLineSet() {
-        return _lineSets.emplace_back(std::make_shared<LineSetImpl>());
+        return util::makeSlotShared(_lineSets, std::make_unique<LineSetImpl>());
     }
     
     SceneInterface::BoundingSpherePtr SceneInterfaceImpl::addBoundingSphere(const math::vector3f &position, float radius, const math::color &rgba) {
-        return _boundingSpheres.emplace_back(std::make_shared<BoundingSphereImpl>(position, radius, rgba));
+        return util::makeSlotShared(_boundingSpheres, std::make_unique<BoundingSphereImpl>(position, radius, rgba));
     }
     
     SceneInterface::BoundingBoxPtr SceneInterfaceImpl::addBoundingBox(const math::vector3f &position, const math::bound3f &bbox, const math::color &rgba) {
-        return _boundingBoxes.emplace_back(std::make_shared<BoundingBoxImpl>(position, bbox, rgba));
+        return util::makeSlotShared(_boundingBoxes, std::make_unique<BoundingBoxImpl>(position, bbox, rgba));
     }
     
-    SceneInterface::VoxelMeshPtr SceneInterfaceImpl::addVoxelMesh(const std::vector<foundation::RenderDataPtr> &frames, const util::Description &description) {
-        std::shared_ptr<VoxelMeshImpl> result = std::make_shared<VoxelMeshImpl>(frames.data(), std::uint32_t(frames.size()), description);
-        return _voxelMeshes.emplace_back(result);
+    SceneInterface::VoxelMeshPtr SceneInterfaceImpl::addVoxelMesh(const foundation::RenderDataPtr &frames, const std::vector<std::uint32_t> &frameOffsets, const util::Description &description) {
+        if (frames == nullptr || frameOffsets.size() < 2) {
+            _platform->logError("[SceneInterfaceImpl::addVoxelMesh] Mesh without frames");
+            return nullptr;
+        }
+        
+        return util::makeSlotShared(_voxelMeshes, std::make_unique<VoxelMeshImpl>(frames, frameOffsets.data(), std::uint32_t(frameOffsets.size() - 1), description));
     }
     
     SceneInterface::GroundMeshPtr SceneInterfaceImpl::addGroundMesh(const foundation::RenderDataPtr &mesh, const foundation::RenderTexturePtr &texture) {
-        std::shared_ptr<GroundMeshImpl> result = std::make_shared<GroundMeshImpl>(mesh, texture);
-        return _groundMeshes.emplace_back(result);
+        return util::makeSlotShared(_groundMeshes, std::make_unique<GroundMeshImpl>(mesh, texture));
     }
 
     SceneInterface::CustomMeshPtr SceneInterfaceImpl::addCustomMesh(const char *shaderName, const char *shaderSrc, const foundation::InputLayout &layout, bool drawIntoGBuffer) {
         if (shaderName == nullptr || shaderSrc == nullptr) {
-            std::shared_ptr<CustomMeshImpl> result = std::make_shared<CustomMeshImpl>(_groundMeshShader, false);
-            return _customMeshes.emplace_back(result);
+            return util::makeSlotShared(_customMeshes, std::make_unique<CustomMeshImpl>(_groundMeshShader, false));
         }
         else {
             auto index = _customShaders.find(shaderName);
             if (index != _customShaders.end()) {
-                std::shared_ptr<CustomMeshImpl> result = std::make_shared<CustomMeshImpl>(index->second, drawIntoGBuffer);
-                return _customMeshes.emplace_back(result);
+                return util::makeSlotShared(_customMeshes, std::make_unique<CustomMeshImpl>(index->second, drawIntoGBuffer));
             }
             else {
                 foundation::RenderShaderPtr shader = _rendering->createShader(shaderName, shaderSrc, layout);
                 auto newEntry = _customShaders.emplace(std::string(shaderName), shader);
-                std::shared_ptr<CustomMeshImpl> result = std::make_shared<CustomMeshImpl>(newEntry.first->second, drawIntoGBuffer);
-                return _customMeshes.emplace_back(result);
+                return util::makeSlotShared(_customMeshes, std::make_unique<CustomMeshImpl>(newEntry.first->second, drawIntoGBuffer));
             }
         }
     }
     
     SceneInterface::ParticlesPtr SceneInterfaceImpl::addParticles(const foundation::RenderTexturePtr &tx, const foundation::RenderTexturePtr &map, const ParticlesParams &params) {
-        std::shared_ptr<ParticleEmitterImpl> result = std::make_shared<ParticleEmitterImpl>(tx, map, params);
-        return _particleEmitters.emplace_back(result);
+        return util::makeSlotShared(_particleEmitters, std::make_unique<ParticleEmitterImpl>(tx, map, params));
     }
     
     SceneInterface::LightSourcePtr SceneInterfaceImpl::addLightSource(float r, float g, float b, float radius) {
@@ -938,19 +960,19 @@ namespace core {
     //
     //
     void SceneInterfaceImpl::updateAndDraw(float dtSec) {
-        util::cleanupUnused(_arrows);
-        util::cleanupUnused(_lineSets);
-        util::cleanupUnused(_boundingSpheres);
-        util::cleanupUnused(_boundingBoxes);
-        util::cleanupUnused(_voxelMeshes);
-        util::cleanupUnused(_groundMeshes);
-        util::cleanupUnused(_customMeshes);
-        util::cleanupUnused(_particleEmitters);
+        _arrows->compact();
+        _lineSets->compact();
+        _boundingSpheres->compact();
+        _boundingBoxes->compact();
+        _voxelMeshes->compact();
+        _groundMeshes->compact();
+        _customMeshes->compact();
+        _particleEmitters->compact();
         _rendering->updateFrameConstants(_camera.plmVPMatrix, _camera.stdVPMatrix, _camera.invVPMatrix, _camera.position, _camera.forward);
         
         _rendering->forTarget(_gbuffer, nullptr, math::color{0.0, 0.0, 0.0, 1.0}, [&](foundation::RenderingInterface &rendering) {
             rendering.applyShader(_groundMeshShader, foundation::RenderTopology::TRIANGLES, foundation::BlendType::DISABLED, foundation::DepthBehavior::TEST_AND_WRITE);
-            for (const auto &groundMesh : _groundMeshes) {
+            for (const GroundMeshImpl *groundMesh : *_groundMeshes) {
                 rendering.applyShaderConstants(&groundMesh->transform);
                 rendering.applyTextures({
                     {groundMesh->texture, foundation::SamplerType::NEAREST}
@@ -959,10 +981,18 @@ namespace core {
             }
             
             rendering.applyShader(_voxelMeshShader, foundation::RenderTopology::TRIANGLESTRIP, foundation::BlendType::DISABLED, foundation::DepthBehavior::TEST_AND_WRITE);
-            for (const auto &voxelMesh : _voxelMeshes) {
-                const math::transform3f transform = voxelMesh->getFinalTransform();
-                rendering.applyShaderConstants(&transform);
-                rendering.draw(voxelMesh->frames[voxelMesh->frameIndex]);
+            for (const VoxelMeshImpl *voxelMesh : *_voxelMeshes) {
+                const std::uint32_t *offsets = voxelMesh->frameOffsets.get();
+                VoxelMeshImpl::VoxelMeshData data {voxelMesh->getFinalTransform(), {voxelMesh->frameBlend, 2.0f, 0.0f, 0.0f}};
+                rendering.applyShaderConstants(&data);
+                rendering.draw(voxelMesh->frames, offsets[voxelMesh->frameIndex], offsets[voxelMesh->frameIndex + 1] - offsets[voxelMesh->frameIndex]);
+                
+                // cross-fade: next frame shows exactly the voxels dissolved in the current one
+                if (voxelMesh->frameBlend > 0.0f) {
+                    data.frameBlend = {0.0f, voxelMesh->frameBlend, 0.0f, 0.0f};
+                    rendering.applyShaderConstants(&data);
+                    rendering.draw(voxelMesh->frames, offsets[voxelMesh->nextFrameIndex], offsets[voxelMesh->nextFrameIndex + 1] - offsets[voxelMesh->nextFrameIndex]);
+                }
             }
         });
         _rendering->forTarget(nullptr, nullptr, math::color{0.0, 0.0, 0.0, 0.0}, [&](foundation::RenderingInterface &rendering) {
@@ -975,7 +1005,7 @@ namespace core {
             rendering.draw();
         });
         _rendering->forTarget(nullptr, _gbuffer->getDepth(), std::nullopt, [&](foundation::RenderingInterface &rendering) {
-            for (const auto &customMesh : _customMeshes) {
+            for (const CustomMeshImpl *customMesh : *_customMeshes) {
                 if (customMesh->vcount && customMesh->drawIntoGBuffer == false) {
                     rendering.applyShader(customMesh->shader, foundation::RenderTopology::TRIANGLES, foundation::BlendType::MIXING, foundation::DepthBehavior::TEST_AND_WRITE);
                     if (customMesh->shaderConst.size()) {
@@ -987,7 +1017,7 @@ namespace core {
             }
 
             rendering.applyShader(_particlesShader, foundation::RenderTopology::TRIANGLESTRIP, foundation::BlendType::MIXING, foundation::DepthBehavior::TEST_ONLY);
-            for (const auto &emitter : _particleEmitters) {
+            for (ParticleEmitterImpl *emitter : *_particleEmitters) {
                 rendering.applyShaderConstants(emitter->getUpdatedConstants(_camera.forward, _camera.right));
                 rendering.applyTextures({
                     {emitter->map, foundation::SamplerType::NEAREST},
@@ -997,7 +1027,7 @@ namespace core {
             }
             if (_lineDrawingEnabled) {
                 rendering.applyShader(_arrowShader, foundation::RenderTopology::LINES, foundation::BlendType::MIXING, foundation::DepthBehavior::DISABLED);
-                for (const auto &set : _arrows) {
+                for (ArrowsImpl *set : *_arrows) {
                     for (const auto &arrow : set->arrows) {
                         set->fillShaderConstants(arrow);
                         rendering.applyShaderConstants(&set->shaderConstants);
@@ -1005,7 +1035,7 @@ namespace core {
                     }
                 }
                 rendering.applyShader(_lineShader, foundation::RenderTopology::LINES, foundation::BlendType::MIXING, foundation::DepthBehavior::DISABLED);
-                for (const auto &set : _lineSets) {
+                for (LineSetImpl *set : *_lineSets) {
                     for (auto &bucket : set->buckets) {
                         bucket.transform = set->transform;
                         rendering.applyShaderConstants(&bucket);
@@ -1013,12 +1043,12 @@ namespace core {
                     }
                 }
                 rendering.applyShader(_boundingBoxShader, foundation::RenderTopology::LINES, foundation::BlendType::MIXING, foundation::DepthBehavior::DISABLED);
-                for (const auto &bbox : _boundingBoxes) {
+                for (const BoundingBoxImpl *bbox : *_boundingBoxes) {
                     rendering.applyShaderConstants(&bbox->bboxData);
                     rendering.draw();
                 }
                 rendering.applyShader(_boundingSphereShader, foundation::RenderTopology::LINES, foundation::BlendType::MIXING, foundation::DepthBehavior::DISABLED);
-                for (const auto &bsphere : _boundingSpheres) {
+                for (const BoundingSphereImpl *bsphere : *_boundingSpheres) {
                     rendering.applyShaderConstants(&bsphere->bsphereData);
                     rendering.draw(3);
                 }
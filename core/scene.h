@@ -71,6 +71,11 @@ namespace core {
             virtual void setTransform(const math::transform3f &trfm) = 0;
             virtual void setPosition(const math::vector3f &pos) = 0;
             virtual void setFrame(std::uint32_t index) = 0;
+            
+            // Cross-fade between two frames (of the same or different animations)
+            // @blend - 0 shows 'index' frame only, 1 shows 'nextIndex' frame only. Voxels are dissolved one by one, so equal voxels stay still
+            //
+            virtual void setFrame(std::uint32_t index, std::uint32_t nextIndex, float blend) = 0;
             virtual auto getFrameCount() const -> std::uint32_t = 0;
             virtual auto getDescription() const -> const util::Description & = 0;
             virtual ~VoxelMesh() = default;
@@ -114,7 +119,12 @@ namespace core {
         virtual auto addLineSet() -> LineSetPtr = 0;
         virtual auto addBoundingSphere(const math::vector3f &position, float radius, const math::color &rgba) -> BoundingSpherePtr = 0;
         virtual auto addBoundingBox(const math::vector3f &position, const math::bound3f &bbox, const math::color &rgba) -> BoundingBoxPtr = 0;
-        virtual auto addVoxelMesh(const std::vector<foundation::RenderDataPtr> &frames, const util::Description &description) -> VoxelMeshPtr = 0; // TODO: description should not be here
+        
+        // @frames       - voxels of all frames in one buffer
+        // @frameOffsets - frame count + 1 entries. Frame i takes voxels [frameOffsets[i], frameOffsets[i + 1])
+        //
+        virtual auto addVoxelMesh(const foundation::RenderDataPtr &frames, const std::vector<std::uint32_t> &frameOffsets, const util::Description &description) -> VoxelMeshPtr = 0; // TODO: description should not be here
+        
         virtual auto addGroundMesh(const foundation::RenderDataPtr &mesh, const foundation::RenderTexturePtr &texture) -> GroundMeshPtr = 0;
         virtual auto addCustomMesh(const char *shaderName, const char *shaderSrc, const foundation::InputLayout &layout, bool drawIntoGBuffer = false) -> CustomMeshPtr = 0;
         virtual auto addParticles(const foundation::RenderTexturePtr &tx, const foundation::RenderTexturePtr &map, const ParticlesParams &params) -> ParticlesPtr = 0;
@@ -58,9 +58,7 @@ namespace core {
         
     public:
         ObstaclePolygonXZImpl(const core::SceneInterfacePtr &scene, std::vector<math::vector3f> &&points) : _src(std::move(points)) {
-            for (auto &point : _src) {
-                points.emplace_back(point);
-            }
+            this->points = _src;
             _visual = scene->addLineSet();
             SceneInterface::fillLineSetAsСlosedСircuit(_visual, _src, {0.0f, 1.0f, 1.0f, 0.7f});
         }
@@ -75,9 +73,8 @@ namespace core {
             const math::vector3f translation = math::vector3f(trfm.m41, trfm.m42, trfm.m43);
             const float yaw = std::atan2(trfm.m31, trfm.m33);
             _transform = math::transform3f({0, 1, 0}, -yaw).translated(translation);
-            for (auto &point : _src) {
-                points.emplace_back(point.transformed(_transform, true));
-            }
+            points.resize(_src.size());
+            math::transformPoints(_src.data(), points.data(), _src.size(), _transform);
             _visual->setTransform(_transform);
         }
         void setVelocity(const math::vector3f &v) override {}
@@ -171,11 +168,11 @@ namespace core {
             if (shapeType == core::SimulationInterface::ShapeType::CircleXZ) {
                 const float mass = desc.getNumber("mass", 0.0f);
                 const float radius = desc.getNumber("radius", 1.0f);
-                result = _circlesXZ.emplace_back(std::make_shared<CircleXZImpl>(_scene, mass, radius));
+                result = util::makeSlotShared(_circlesXZ, std::make_unique<CircleXZImpl>(_scene, mass, radius));
             }
             else if (shapeType == core::SimulationInterface::ShapeType::ObstaclePolygonXZ) {
                 std::vector<math::vector3f> points = desc.getVector3fs("points");
-                result = _obstaclesXZ.emplace_back(std::make_shared<ObstaclePolygonXZImpl>(_scene, std::move(points)));
+                result = util::makeSlotShared(_obstaclesXZ, std::make_unique<ObstaclePolygonXZImpl>(_scene, std::move(points)));
             }
             else {
                 _platform->logError("[SimulationInterfaceImpl::addBody] Unknown collision shape type");
@@ -183,23 +180,25 @@ namespace core {
             return result;
         }
         void update(float dtSec) override {
-            util::cleanupUnused(_circlesXZ);
-            util::cleanupUnused(_obstaclesXZ);
+            util::SlotMap<CircleXZImpl *> &circles = *_circlesXZ;
+            util::SlotMap<ObstaclePolygonXZImpl *> &obstacles = *_obstaclesXZ;
+            circles.compact();
+            obstacles.compact();
             
-            for (auto &obj : _circlesXZ) {
+            for (CircleXZImpl *obj : circles) {
                 obj->update(dtSec);
             }
             
             CollisionInfo info;
-            for (std::size_t i = 0; i < _circlesXZ.size(); i++) {
-                for (std::size_t c = i + 1; c < _circlesXZ.size(); c++) {
-                    if (checkCollisionCircleCircleXZ(*_circlesXZ[i], *_circlesXZ[c], info)) {
-                        resolveCollisionCircleCircleXZ(info, *_circlesXZ[i], *_circlesXZ[c]);
+            for (std::size_t i = 0; i < circles.size(); i++) {
+                for (std::size_t c = i + 1; c < circles.size(); c++) {
+                    if (checkCollisionCircleCircleXZ(*circles[i], *circles[c], info)) {
+                        resolveCollisionCircleCircleXZ(info, *circles[i], *circles[c]);
                     }
                 }
-                for (std::size_t c = 0; c < _obstaclesXZ.size(); c++) {
-                    if (checkCollisionCircleObstacleXZ(*_circlesXZ[i], *_obstaclesXZ[c], info)) {
-                        resolveCollisionCircleObstacleXZ(info, *_circlesXZ[i], *_obstaclesXZ[c]);
+                for (std::size_t c = 0; c < obstacles.size(); c++) {
+                    if (checkCollisionCircleObstacleXZ(*circles[i], *obstacles[c], info)) {
+                        resolveCollisionCircleObstacleXZ(info, *circles[i], *obstacles[c]);
                     }
                 }
             }
@@ -209,8 +208,8 @@ namespace core {
         const foundation::PlatformInterfacePtr _platform;
         const core::SceneInterfacePtr _scene;
         
-        std::vector<std::shared_ptr<CircleXZImpl>> _circlesXZ;
-        std::vector<std::shared_ptr<ObstaclePolygonXZImpl>> _obstaclesXZ;
+        const std::shared_ptr<util::SlotMap<CircleXZImpl *>> _circlesXZ = std::make_shared<util::SlotMap<CircleXZImpl *>>();
+        const std::shared_ptr<util::SlotMap<ObstaclePolygonXZImpl *>> _obstaclesXZ = std::make_shared<util::SlotMap<ObstaclePolygonXZImpl *>>();
     };
 }
 
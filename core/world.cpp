@@ -1,12 +1,655 @@
 
 #include "world.h"
+#include "foundation/jobs.h"
+#include "foundation/memory.h"
+
 #include <unordered_map>
+#include <string_view>
+#include <algorithm>
+#include <limits>
+#include <chrono>
+
+namespace {
+    const std::uint8_t MEMORY_TAG_OBJECTS = 1;
+    const std::uint8_t MEMORY_TAG_NODES = 2;
+    const std::size_t NODES_PER_BLOCK = 64;
+}
 
 namespace core {
     class ObjectImpl;
     class CollisionNode;
 }
 
+namespace core {
+    // Transforms of all object nodes in the world, stored contiguously
+    // Every object takes a range of indexes. Nodes in the range are sorted parent-before-child, so world transforms
+    // are recomputed in one pass, and only for ranges where some node was changed
+    // Different ranges can be updated from different threads
+    //
+    class TransformHierarchy {
+    public:
+        static constexpr std::uint32_t NO_PARENT = std::uint32_t(-1);
+        
+    public:
+        // @return index of the first node in range
+        //
+        auto allocate(std::uint32_t count) -> std::uint32_t;
+        void release(std::uint32_t first, std::uint32_t count);
+        
+        // @parent - index of node from the same range that is less than @index or NO_PARENT
+        //
+        void initialize(std::uint32_t index, std::uint32_t parent, const math::transform3f &local);
+        
+        // World transform of node without parent is changed immediately
+        //
+        void setLocal(std::uint32_t index, const math::transform3f &trfm);
+        
+        auto getLocal(std::uint32_t index) const -> const math::transform3f & { return _local[index]; }
+        auto getWorld(std::uint32_t index) const -> const math::transform3f & { return _world[index]; }
+        
+        // World transform was changed since the last clearMoved()
+        //
+        bool isMoved(std::uint32_t index) const { return _flags[index] & FLAG_MOVED; }
+        
+        // Recomputes world transforms of changed nodes in range and their descendants
+        // @return true if some node in range has moved
+        //
+        bool updateRange(std::uint32_t first, std::uint32_t count);
+        void clearMoved(std::uint32_t first, std::uint32_t count);
+        
+    private:
+        static constexpr std::uint8_t FLAG_DIRTY = 0x1;
+        static constexpr std::uint8_t FLAG_MOVED = 0x2;
+        static constexpr std::uint8_t FLAG_RANGE_DIRTY = 0x4; // set for the first node in range
+        static constexpr std::uint8_t FLAG_RANGE_MOVED = 0x8; // set for the first node in range
+        
+        std::vector<math::transform3f> _local;
+        std::vector<math::transform3f> _world;
+        std::vector<std::uint32_t> _parents;
+        std::vector<std::uint32_t> _rangeFirsts;
+        std::vector<std::uint8_t> _flags;
+        std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> _freeRanges;
+    };
+    
+    std::uint32_t TransformHierarchy::allocate(std::uint32_t count) {
+        std::uint32_t first = std::uint32_t(_local.size());
+        auto index = _freeRanges.find(count);
+        
+        if (index != _freeRanges.end() && index->second.size()) {
+            first = index->second.back();
+            index->second.pop_back();
+        }
+        else {
+            const std::size_t size = _local.size() + count;
+            _local.resize(size, math::transform3f::identity());
+            _world.resize(size, math::transform3f::identity());
+            _parents.resize(size, NO_PARENT);
+            _rangeFirsts.resize(size, first);
+            _flags.resize(size, 0);
+        }
+        
+        return first;
+    }
+    void TransformHierarchy::release(std::uint32_t first, std::uint32_t count) {
+        for (std::uint32_t i = first; i < first + count; i++) {
+            _parents[i] = NO_PARENT;
+            _flags[i] = 0;
+        }
+        _freeRanges[count].emplace_back(first);
+    }
+    void TransformHierarchy::initialize(std::uint32_t index, std::uint32_t parent, const math::transform3f &local) {
+        _local[index] = local;
+        _world[index] = parent != NO_PARENT ? local * _world[parent] : local;
+        _parents[index] = parent;
+        _flags[index] = (_flags[index] & (FLAG_RANGE_DIRTY | FLAG_RANGE_MOVED)) | FLAG_MOVED;
+        _flags[_rangeFirsts[index]] |= FLAG_RANGE_MOVED;
+    }
+    void TransformHierarchy::setLocal(std::uint32_t index, const math::transform3f &trfm) {
+        _local[index] = trfm;
+        
+        if (_parents[index] == NO_PARENT) {
+            _world[index] = trfm;
+        }
+        
+        _flags[index] |= FLAG_DIRTY;
+        _flags[_rangeFirsts[index]] |= FLAG_RANGE_DIRTY;
+    }
+    bool TransformHierarchy::updateRange(std::uint32_t first, std::uint32_t count) {
+        if (_flags[first] & FLAG_RANGE_DIRTY) {
+            _flags[first] &= ~FLAG_RANGE_DIRTY;
+            
+            for (std::uint32_t i = first; i < first + count; i++) {
+                const std::uint32_t parent = _parents[i];
+                
+                if ((_flags[i] & FLAG_DIRTY) || (parent != NO_PARENT && (_flags[parent] & FLAG_MOVED))) {
+                    _world[i] = parent != NO_PARENT ? _local[i] * _world[parent] : _local[i];
+                    _flags[i] = (_flags[i] & ~FLAG_DIRTY) | FLAG_MOVED;
+                    _flags[first] |= FLAG_RANGE_MOVED;
+                }
+            }
+        }
+        
+        return _flags[first] & FLAG_RANGE_MOVED;
+    }
+    void TransformHierarchy::clearMoved(std::uint32_t first, std::uint32_t count) {
+        if (_flags[first] & FLAG_RANGE_MOVED) {
+            for (std::uint32_t i = first; i < first + count; i++) {
+                _flags[i] &= ~FLAG_MOVED;
+            }
+            _flags[first] &= ~FLAG_RANGE_MOVED;
+        }
+    }
+}
+
+namespace core {
+    // Playing mesh clips of the whole world. Hot clip state is kept in parallel arrays and advanced in one pass
+    // without branches, so the loop is vectorized. Clip names are interned to ids shared by all meshes
+    // Completions are called in a batch after objects are committed
+    //
+    class AnimationSystem {
+    public:
+        static constexpr std::uint32_t NO_CLIP = std::uint32_t(-1);
+        static constexpr std::uint32_t NOT_PLAYING = std::uint32_t(-1);
+        
+    public:
+        auto internClipName(std::string_view name) -> std::uint32_t;
+        
+        // @return NO_CLIP if name was never interned
+        //
+        auto findClipName(std::string_view name) const -> std::uint32_t;
+        
+        // Starts clip or restarts the one already playing
+        // @playingIndex - owner's variable. Kept valid while clips are moved in arrays, set to NOT_PLAYING when clip is stopped
+        //
+        void play(std::uint32_t &playingIndex, float frameCount, float lengthSec, bool looped, util::callback<void()> &&completion);
+        void stop(std::uint32_t &playingIndex);
+        
+        // Fractional frame inside clip at time of the last advance()
+        //
+        auto getFrameOffset(std::uint32_t playingIndex) const -> float {
+            return std::min(_timeSec[playingIndex] * _framesPerSec[playingIndex], _lastFrame[playingIndex]);
+        }
+        
+        void advance(float dtSec);
+        
+        // Calls completions of clips that reached the end of cycle in the last advance(). Finished clips are stopped before
+        // Completions can play and stop clips
+        //
+        void fireCompletions();
+        
+    private:
+        struct Event {
+            std::uint32_t *owner;
+            std::uint32_t serial;
+            bool finished;
+        };
+        
+        util::StringMap<std::uint32_t> _clipIds;
+        
+        // advance() touches only these arrays. Less arrays means less aliasing checks for the vectorizer
+        std::vector<float> _timeSec;
+        std::vector<float> _lengthSec;
+        std::vector<float> _loopMask; // 1.0f for looped clip
+        std::vector<std::uint8_t> _cycled;
+        
+        std::vector<float> _framesPerSec;
+        std::vector<float> _lastFrame;
+        std::vector<std::uint32_t *> _owners;
+        std::vector<std::uint32_t> _serials; // new for every play(), so a completion doesn't fire for restarted clip
+        std::vector<util::callback<void()>> _completions;
+        std::vector<Event> _events;
+        std::uint32_t _nextSerial = 0;
+    };
+    
+    std::uint32_t AnimationSystem::internClipName(std::string_view name) {
+        const auto index = _clipIds.find(name);
+        if (index != _clipIds.end()) {
+            return index->second;
+        }
+        
+        const std::uint32_t id = std::uint32_t(_clipIds.size());
+        _clipIds.emplace(std::string(name), id);
+        return id;
+    }
+    std::uint32_t AnimationSystem::findClipName(std::string_view name) const {
+        const auto index = _clipIds.find(name);
+        return index != _clipIds.end() ? index->second : NO_CLIP;
+    }
+    void AnimationSystem::play(std::uint32_t &playingIndex, float frameCount, float lengthSec, bool looped, util::callback<void()> &&completion) {
+        if (playingIndex == NOT_PLAYING) {
+            playingIndex = std::uint32_t(_timeSec.size());
+            _timeSec.emplace_back();
+            _lengthSec.emplace_back();
+            _framesPerSec.emplace_back();
+            _lastFrame.emplace_back();
+            _loopMask.emplace_back();
+            _cycled.emplace_back();
+            _owners.emplace_back(&playingIndex);
+            _serials.emplace_back();
+            _completions.emplace_back();
+        }
+        
+        const std::uint32_t i = playingIndex;
+        _timeSec[i] = 0.0f;
+        _lengthSec[i] = std::max(lengthSec, std::numeric_limits<float>::min());
+        _framesPerSec[i] = frameCount / _lengthSec[i];
+        _lastFrame[i] = std::max(frameCount - 1.0f, 0.0f);
+        _loopMask[i] = looped ? 1.0f : 0.0f;
+        _cycled[i] = 0;
+        _serials[i] = _nextSerial++;
+        _completions[i] = std::move(completion);
+    }
+    void AnimationSystem::stop(std::uint32_t &playingIndex) {
+        if (playingIndex != NOT_PLAYING) {
+            const std::uint32_t i = playingIndex;
+            const std::uint32_t last = std::uint32_t(_timeSec.size() - 1);
+            
+            if (i != last) {
+                _timeSec[i] = _timeSec[last];
+                _lengthSec[i] = _lengthSec[last];
+                _framesPerSec[i] = _framesPerSec[last];
+                _lastFrame[i] = _lastFrame[last];
+                _loopMask[i] = _loopMask[last];
+                _cycled[i] = _cycled[last];
+                _owners[i] = _owners[last];
+                _serials[i] = _serials[last];
+                _completions[i] = std::move(_completions[last]);
+                *_owners[i] = i;
+            }
+            
+            _timeSec.pop_back();
+            _lengthSec.pop_back();
+            _framesPerSec.pop_back();
+            _lastFrame.pop_back();
+            _loopMask.pop_back();
+            _cycled.pop_back();
+            _owners.pop_back();
+            _serials.pop_back();
+            _completions.pop_back();
+            playingIndex = NOT_PLAYING;
+        }
+    }
+    void AnimationSystem::advance(float dtSec) {
+        const std::size_t count = _timeSec.size();
+        float *const time = _timeSec.data();
+        const float *const length = _lengthSec.data();
+        const float *const loopMask = _loopMask.data();
+        std::uint8_t *const cycled = _cycled.data();
+        
+        // Looped clip wraps around, other one stops at its length. Time is never negative, so truncation is floor
+        // No std::min here: it returns reference and breaks vectorization
+        for (std::size_t i = 0; i < count; i++) {
+            const float t = time[i] + dtSec;
+            const float cycles = float(int(t / length[i]));
+            const float wrapped = t - cycles * length[i] * loopMask[i];
+            
+            time[i] = wrapped < length[i] ? wrapped : length[i];
+            cycled[i] = cycles > 0.0f;
+        }
+    }
+    void AnimationSystem::fireCompletions() {
+        _events.clear();
+        
+        for (std::size_t i = 0; i < _cycled.size(); i++) {
+            if (_cycled[i]) {
+                _events.emplace_back(Event{_owners[i], _serials[i], _loopMask[i] == 0.0f});
+            }
+        }
+        for (const Event &event : _events) {
+            const std::uint32_t index = *event.owner;
+            
+            // clip could be stopped or restarted by previous completion
+            if (index != NOT_PLAYING && _serials[index] == event.serial) {
+                _cycled[index] = 0;
+                util::callback<void()> completion = std::move(_completions[index]);
+                
+                if (event.finished) {
+                    stop(*event.owner);
+                    completion();
+                }
+                else {
+                    completion();
+                    
+                    if (*event.owner != NOT_PLAYING && _serials[*event.owner] == event.serial) {
+                        _completions[*event.owner] = std::move(completion);
+                    }
+                }
+            }
+        }
+    }
+}
+
+namespace core {
+    // Sparse uniform grid of object positions. Cells are created on demand, so the world has no bounds
+    // Objects move between cells incrementally, when their root node moves
+    //
+    class SpatialGrid {
+    public:
+        static constexpr float CELL_SIZE = 16.0f;
+        
+        struct Location {
+            std::uint64_t cell = 0;
+            std::uint32_t index = std::uint32_t(-1);
+        };
+        struct Entry {
+            ObjectImpl *object;
+            math::vector3f position;
+            std::uint64_t typeMask;
+            Location *location; // owner's variable, kept up to date while entries are moved in cell
+        };
+        
+    public:
+        void insert(ObjectImpl *object, const math::vector3f &position, std::uint64_t typeMask, Location &location);
+        void move(const math::vector3f &position, Location &location);
+        void remove(Location &location);
+        
+        template<typename F> void forEachInBox(const math::bound3f &box, F &&visitor) const;
+        
+        // @planes - (normal, distance) of planes looking inside
+        //
+        template<typename F> void forEachInPlanes(const math::vector4f (&planes)[6], F &&visitor) const;
+        
+    private:
+        static const std::int32_t CELL_COORD_MAX = (1 << 20) - 1; // cell key has 21 bits per axis
+        
+        // Huge, infinite and NaN coordinates are clamped to the key range, so casting is defined and keys don't wrap
+        static auto _getCellCoord(float value) -> std::int32_t {
+            const float coord = std::floor(value / CELL_SIZE);
+            if (coord >= float(-CELL_COORD_MAX)) {
+                return coord <= float(CELL_COORD_MAX) ? std::int32_t(coord) : CELL_COORD_MAX;
+            }
+            return -CELL_COORD_MAX;
+        }
+        static auto _getCellKey(std::int32_t x, std::int32_t y, std::int32_t z) -> std::uint64_t {
+            const std::uint64_t mask = 0x1FFFFF; // 21 bits per axis
+            return (std::uint64_t(x) & mask) | ((std::uint64_t(y) & mask) << 21) | ((std::uint64_t(z) & mask) << 42);
+        }
+        static auto _getCellKey(const math::vector3f &position) -> std::uint64_t {
+            return _getCellKey(_getCellCoord(position.x), _getCellCoord(position.y), _getCellCoord(position.z));
+        }
+        
+        struct Cell {
+            std::int32_t x, y, z;
+            std::vector<Entry> entries;
+        };
+        struct CellBounds {
+            std::int32_t xmin = 0, ymin = 0, zmin = 0;
+            std::int32_t xmax = -1, ymax = -1, zmax = -1; // empty if no cells
+        };
+        
+        std::unordered_map<std::uint64_t, Cell> _cells;
+        CellBounds _occupied; // cells are never removed, so bounds only grow
+    };
+    
+    void SpatialGrid::insert(ObjectImpl *object, const math::vector3f &position, std::uint64_t typeMask, Location &location) {
+        const std::int32_t x = _getCellCoord(position.x);
+        const std::int32_t y = _getCellCoord(position.y);
+        const std::int32_t z = _getCellCoord(position.z);
+        
+        location.cell = _getCellKey(x, y, z);
+        Cell &cell = _cells[location.cell];
+        
+        if (cell.entries.empty()) {
+            cell.x = x;
+            cell.y = y;
+            cell.z = z;
+            
+            if (_occupied.xmin > _occupied.xmax) {
+                _occupied = CellBounds{x, y, z, x, y, z};
+            }
+            else {
+                _occupied.xmin = std::min(_occupied.xmin, x);
+                _occupied.ymin = std::min(_occupied.ymin, y);
+                _occupied.zmin = std::min(_occupied.zmin, z);
+                _occupied.xmax = std::max(_occupied.xmax, x);
+                _occupied.ymax = std::max(_occupied.ymax, y);
+                _occupied.zmax = std::max(_occupied.zmax, z);
+            }
+        }
+        
+        location.index = std::uint32_t(cell.entries.size());
+        cell.entries.emplace_back(Entry{object, position, typeMask, &location});
+    }
+    void SpatialGrid::move(const math::vector3f &position, Location &location) {
+        if (_getCellKey(position) == location.cell) {
+            _cells[location.cell].entries[location.index].position = position;
+        }
+        else {
+            const Entry entry = _cells[location.cell].entries[location.index];
+            remove(location);
+            insert(entry.object, position, entry.typeMask, location);
+        }
+    }
+    void SpatialGrid::remove(Location &location) {
+        const auto index = _cells.find(location.cell);
+        if (index != _cells.end() && location.index < index->second.entries.size()) {
+            std::vector<Entry> &entries = index->second.entries;
+            
+            if (location.index + 1 < entries.size()) {
+                entries[location.index] = entries.back();
+                entries[location.index].location->index = location.index;
+            }
+            
+            entries.pop_back();
+            location.index = std::uint32_t(-1);
+            
+            // empty cells are kept, objects tend to come back
+        }
+    }
+    template<typename F> void SpatialGrid::forEachInBox(const math::bound3f &box, F &&visitor) const {
+        // Unbounded box is cut to cells that have been occupied ever
+        const std::int32_t xmin = std::max(_getCellCoord(box.xmin), _occupied.xmin), xmax = std::min(_getCellCoord(box.xmax), _occupied.xmax);
+        const std::int32_t ymin = std::max(_getCellCoord(box.ymin), _occupied.ymin), ymax = std::min(_getCellCoord(box.ymax), _occupied.ymax);
+        const std::int32_t zmin = std::max(_getCellCoord(box.zmin), _occupied.zmin), zmax = std::min(_getCellCoord(box.zmax), _occupied.zmax);
+        
+        if (xmin > xmax || ymin > ymax || zmin > zmax) {
+            return;
+        }
+        
+        const std::uint64_t rangeCellCount = std::uint64_t(xmax - xmin + 1) * std::uint64_t(ymax - ymin + 1) * std::uint64_t(zmax - zmin + 1);
+        
+        auto visitCell = [&box, &visitor](const Cell &cell) {
+            for (const Entry &entry : cell.entries) {
+                const math::vector3f &p = entry.position;
+                if (p.x >= box.xmin && p.x <= box.xmax && p.y >= box.ymin && p.y <= box.ymax && p.z >= box.zmin && p.z <= box.zmax) {
+                    visitor(entry);
+                }
+            }
+        };
+        
+        // Large box covers more cells than there are, so existing cells are checked instead
+        if (rangeCellCount > _cells.size()) {
+            for (const auto &index : _cells) {
+                const Cell &cell = index.second;
+                if (cell.x >= xmin && cell.x <= xmax && cell.y >= ymin && cell.y <= ymax && cell.z >= zmin && cell.z <= zmax) {
+                    visitCell(cell);
+                }
+            }
+        }
+        else {
+            for (std::int32_t z = zmin; z <= zmax; z++) {
+                for (std::int32_t y = ymin; y <= ymax; y++) {
+                    for (std::int32_t x = xmin; x <= xmax; x++) {
+                        const auto index = _cells.find(_getCellKey(x, y, z));
+                        if (index != _cells.end()) {
+                            visitCell(index->second);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    template<typename F> void SpatialGrid::forEachInPlanes(const math::vector4f (&planes)[6], F &&visitor) const {
+        for (const auto &index : _cells) {
+            const Cell &cell = index.second;
+            const float xmin = float(cell.x) * CELL_SIZE, xmax = xmin + CELL_SIZE;
+            const float ymin = float(cell.y) * CELL_SIZE, ymax = ymin + CELL_SIZE;
+            const float zmin = float(cell.z) * CELL_SIZE, zmax = zmin + CELL_SIZE;
+            bool cellVisible = cell.entries.size() != 0;
+            
+            // cell is outside if its corner most inside is behind some plane
+            for (std::size_t i = 0; i < 6 && cellVisible; i++) {
+                const math::vector4f &plane = planes[i];
+                const float x = plane.x >= 0.0f ? xmax : xmin;
+                const float y = plane.y >= 0.0f ? ymax : ymin;
+                const float z = plane.z >= 0.0f ? zmax : zmin;
+                cellVisible = plane.x * x + plane.y * y + plane.z * z + plane.w >= 0.0f;
+            }
+            if (cellVisible) {
+                for (const Entry &entry : cell.entries) {
+                    const math::vector3f &p = entry.position;
+                    bool inside = true;
+                    
+                    for (std::size_t i = 0; i < 6 && inside; i++) {
+                        inside = planes[i].x * p.x + planes[i].y * p.y + planes[i].z * p.z + planes[i].w >= 0.0f;
+                    }
+                    if (inside) {
+                        visitor(entry);
+                    }
+                }
+            }
+        }
+    }
+}
+
+namespace core {
+    // Main thread part of resource loading: adding meshes to scene, shapes to raycast, bodies to simulation
+    // Works are done nearest first until the frame budget is spent, so mass spawning doesn't make hitches
+    //
+    class CompletionQueue {
+    public:
+        void push(float distanceSq, util::callback<void()> &&work);
+        void process(std::uint64_t budgetUs);
+        
+        auto getStats() const -> WorldInterface::LoadingStats {
+            WorldInterface::LoadingStats result = _stats;
+            result.queueLength = _items.size();
+            return result;
+        }
+        
+    private:
+        // Microseconds from an arbitrary monotonic origin
+        static auto _getTimeStamp() -> std::uint64_t {
+            return std::uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+        
+        struct Item {
+            float distanceSq;
+            std::uint64_t serial; // equal distances go in order of pushing
+            std::uint64_t pushTimeStamp;
+            util::callback<void()> work;
+        };
+        
+        // Heap with the nearest item on top
+        std::vector<Item> _items;
+        std::uint64_t _nextSerial = 0;
+        WorldInterface::LoadingStats _stats;
+    };
+    
+    void CompletionQueue::push(float distanceSq, util::callback<void()> &&work) {
+        _items.emplace_back(Item{distanceSq, _nextSerial++, _getTimeStamp(), std::move(work)});
+        std::push_heap(_items.begin(), _items.end(), [](const Item &a, const Item &b) {
+            return a.distanceSq > b.distanceSq || (a.distanceSq == b.distanceSq && a.serial > b.serial);
+        });
+    }
+    void CompletionQueue::process(std::uint64_t budgetUs) {
+        const std::uint64_t startTimeStamp = _getTimeStamp();
+        std::uint64_t currentTimeStamp = startTimeStamp;
+        std::uint64_t waitSumUs = 0;
+        std::uint64_t waitMaxUs = 0;
+        std::size_t count = 0;
+        
+        // At least one work is done every frame, even if budget is zero
+        while (_items.empty() == false && (count == 0 || currentTimeStamp - startTimeStamp < budgetUs)) {
+            std::pop_heap(_items.begin(), _items.end(), [](const Item &a, const Item &b) {
+                return a.distanceSq > b.distanceSq || (a.distanceSq == b.distanceSq && a.serial > b.serial);
+            });
+            
+            // Work can push new items
+            const util::callback<void()> work = std::move(_items.back().work);
+            const std::uint64_t waitUs = currentTimeStamp - _items.back().pushTimeStamp;
+            _items.pop_back();
+            
+            work();
+            
+            waitSumUs += waitUs;
+            waitMaxUs = std::max(waitMaxUs, waitUs);
+            currentTimeStamp = _getTimeStamp();
+            count++;
+        }
+        
+        _stats.completedCount = count;
+        _stats.averageWaitMs = count ? float(waitSumUs) / float(count) / 1000.0f : 0.0f;
+        _stats.maxWaitMs = float(waitMaxUs) / 1000.0f;
+        _stats.spentMs = float(currentTimeStamp - startTimeStamp) / 1000.0f;
+    }
+}
+
+namespace core {
+    static const math::transform3f g_identity = math::transform3f::identity();
+    class WorldImpl;
+
+    class ObjectNode {
+    public:
+        const WorldInterface::NodeType type;
+        std::uint32_t transformIndex = 0; // index in TransformHierarchy
+        bool animated = false;            // node needs step() and commit() every frame
+        const char *resourcePath = "";    // owned by PrefabTemplate
+        
+        ObjectNode(WorldInterface::NodeType type) : type(type) {}
+        virtual ~ObjectNode() = default;
+        virtual void loadResources(const std::shared_ptr<WorldImpl> &world, const std::weak_ptr<ObjectImpl> &objweak) = 0;
+        virtual void unloadResources() = 0;
+        virtual void play(std::uint32_t animationId, bool looped, util::callback<void()> &&completion) = 0;
+        
+        // Called from worker threads for animated nodes. Must touch only the node's own data
+        //
+        virtual void step(float dtSec) {}
+        
+        // Called from the main thread if node is animated or moved. Applies results to scene/raycast/simulation
+        // @moved - @worldTransform was changed since previous commit
+        //
+        virtual void commit(const math::transform3f &worldTransform, bool moved) = 0;
+    };
+    
+    // Nodes are placed in per-type pools of WorldImpl
+    //
+    struct NodeDeleter {
+        foundation::FixedSizePool *pool = nullptr;
+        
+        void operator()(ObjectNode *node) const {
+            node->~ObjectNode();
+            pool->free(node);
+        }
+    };
+    
+    using NodePtr = std::unique_ptr<ObjectNode, NodeDeleter>;
+    
+    // Prefab description compiled once to the form that is instantiated without lookups
+    //
+    struct PrefabTemplate {
+        static constexpr std::size_t NO_NODE = std::size_t(-1);
+        
+        struct Node {
+            WorldInterface::NodeType type;
+            std::uint32_t parent; // index of previous node or TransformHierarchy::NO_PARENT
+            math::transform3f localTransform;
+            std::string resourcePath;
+        };
+        
+        std::vector<Node> nodes;
+        util::StringMap<std::size_t> nameToNodeIndex;
+        std::size_t collisionIndex = NO_NODE;
+    };
+    
+    using PrefabTemplatePtr = std::shared_ptr<const PrefabTemplate>;
+
+    std::size_t getNextUniqueId() {
+        static std::size_t nextId = 1000000000;
+        return nextId++;
+    }
+}
+
 namespace core {
     class WorldImpl : public WorldInterface, public std::enable_shared_from_this<WorldImpl> {
     public:
@@ -21,6 +664,14 @@ namespace core {
         
     public:
         auto getObject(const char *name) -> ObjectPtr override;
+        auto getAnimationHandle(const char *animationName) -> AnimationHandle override;
+        auto queryRadius(const math::vector3f &center, float radius, std::uint64_t typeMask, ObjectPtr *output, std::size_t capacity) -> std::size_t override;
+        auto queryBox(const math::bound3f &box, std::uint64_t typeMask, ObjectPtr *output, std::size_t capacity) -> std::size_t override;
+        auto queryFrustum(const math::transform3f &viewProjection, std::uint64_t typeMask, ObjectPtr *output, std::size_t capacity) -> std::size_t override;
+        void setStreaming(std::uint64_t typeMask, float loadDistance, float unloadDistance) override;
+        void setStreamingFocus(const math::vector3f *points, std::size_t count) override;
+        void setLoadingBudget(float ms) override;
+        auto getLoadingStats() const -> LoadingStats override;
         auto createObject(const char *prefabPath, std::uint64_t typeMask, const char *name) -> ObjectPtr override;
         void removeObject(const char *name) override;
         void update(float dtSec) override;
@@ -30,6 +681,21 @@ namespace core {
         core::SceneInterface &getScene() const { return *_scene; }
         core::RaycastInterface &getRaycast() const { return *_raycast; }
         core::SimulationInterface &getSimulation() const { return *_simulation; }
+        TransformHierarchy &getTransforms() { return _transforms; }
+        AnimationSystem &getAnimations() { return _animations; }
+        SpatialGrid &getSpatialGrid() { return _spatialGrid; }
+        
+        auto createNode(WorldInterface::NodeType type) -> NodePtr;
+        void removeStreamed(ObjectImpl &object);
+        
+        // Resource callbacks pass their main thread work here. Work is prioritized by distance from @position to camera
+        //
+        void deferCompletion(const math::vector3f &position, util::callback<void()> &&work);
+        
+    private:
+        template<typename T> void _registerNode(WorldInterface::NodeType type);
+        auto _getPrefabTemplate(const char *prefabPath) -> PrefabTemplatePtr;
+        void _updateStreaming();
         
     public:
         const foundation::PlatformInterfacePtr _platform;
@@ -38,43 +704,52 @@ namespace core {
         const core::RaycastInterfacePtr _raycast;
         const core::SimulationInterfacePtr _simulation;
         
-        std::unordered_map<std::string, std::shared_ptr<ObjectImpl>> _namedObjects;
-        std::unordered_map<std::uint64_t, std::shared_ptr<ObjectImpl>> _unnamedObjects;
-    };
-}
-
-namespace core {
-    static math::transform3f g_identity;
-
-    class ObjectNode {
-    public:
-        const WorldInterface::NodeType type;
-        const ObjectNode *parent = nullptr;
-        math::transform3f localTransform;
-        math::transform3f worldTransform;
-        std::string resourcePath;
+        TransformHierarchy _transforms;
+        AnimationSystem _animations;
+        SpatialGrid _spatialGrid;
+        CompletionQueue _completions;
         
-        ObjectNode(WorldInterface::NodeType type) : type(type) {}
-        virtual ~ObjectNode() = default;
-        virtual void loadResources(const std::shared_ptr<WorldImpl> &world, const std::weak_ptr<ObjectImpl> &objweak) = 0;
-        virtual void unloadResources() = 0;
-        virtual void play(const char *animName, bool looped, util::callback<void()> &&completion) = 0;
-        virtual void update(float dtSec) = 0;
+        static constexpr float DEFAULT_LOADING_BUDGET_MS = 2.0f;
+        std::uint64_t _loadingBudgetUs = std::uint64_t(DEFAULT_LOADING_BUDGET_MS * 1000.0f);
+        math::vector3f _cameraPosition = {0, 0, 0};
+        
+        struct NodeFactory {
+            std::unique_ptr<foundation::FixedSizePool> pool;
+            ObjectNode *(*construct)(void *memory, WorldInterface::NodeType type) = nullptr;
+        };
+        
+        NodeFactory _nodeFactories[int(WorldInterface::NodeType::_count)];
+        std::uint32_t _prefabsVersion = 0;
+        util::StringMap<PrefabTemplatePtr> _prefabTemplates;
+        
+        // Every object of the world is in _objects. Unnamed objects die when the world keeps the last reference
+        // Objects are updated by chunks of OBJECTS_PER_CHUNK in parallel
+        static const std::size_t OBJECTS_PER_CHUNK = 64;
+        std::vector<std::shared_ptr<ObjectImpl>> _objects;
+        util::StringMap<std::shared_ptr<ObjectImpl>> _namedObjects;
+        
+        // Streamed objects are loaded nearest first, not more than STREAMING_LOADS_PER_UPDATE per update
+        // Loaded ones are kept in _streamedObjects, so only they are checked for unloading
+        static const std::size_t STREAMING_LOADS_PER_UPDATE = 16;
+        std::uint64_t _streamingTypeMask = 0;
+        float _streamingLoadDistance = 0.0f;
+        float _streamingUnloadDistance = 0.0f;
+        std::vector<math::vector3f> _streamingFocus;
+        std::vector<ObjectImpl *> _streamedObjects;
+        std::vector<std::pair<float, ObjectImpl *>> _streamingCandidates;
     };
-
-    std::unique_ptr<ObjectNode> (*g_nodeConstructors[int(WorldInterface::NodeType::_count)])() = {};
-    std::size_t getNextUniqueId() {
-        static std::size_t nextId = 1000000000;
-        return nextId++;
-    }
 }
 
 namespace core {
     class ObjectImpl : public WorldInterface::Object, public std::enable_shared_from_this<ObjectImpl> {
     public:
-        ObjectImpl(std::shared_ptr<WorldImpl> &&owner,  std::uint64_t id, const util::Description &objDesc, std::size_t mask);
+        ObjectImpl(std::shared_ptr<WorldImpl> &&owner,  std::uint64_t id, const PrefabTemplatePtr &prefab, std::size_t mask);
+        static constexpr std::uint32_t NOT_STREAMED = std::uint32_t(-1);
+        
         ~ObjectImpl() override {
-            
+            _owner->removeStreamed(*this);
+            _owner->getSpatialGrid().remove(_gridLocation);
+            _owner->getTransforms().release(_transformFirst, _transformCount);
         }
         
         std::uint64_t getId() const override {
@@ -87,45 +762,94 @@ namespace core {
             return _loading == 0;
         }
         
+        bool isResident() const {
+            return _resident;
+        }
+        
+        // Loading that is in progress is not restarted. Unloading during loading is done when loading ends
+        //
         void loadResources(util::callback<void()> &&completion) override {
             _loadingCompletion = std::move(completion);
-            _loading = int(_nodes.size());
-            const std::weak_ptr<ObjectImpl> weakself = weak_from_this();
-            for (std::unique_ptr<ObjectNode> &node : _nodes) {
-                node->loadResources(_owner, weakself);
+            _resident = true;
+            
+            if (_loading == 0) {
+                _loading = int(_nodes.size());
+                const std::weak_ptr<ObjectImpl> weakself = weak_from_this();
+                for (NodePtr &node : _nodes) {
+                    node->loadResources(_owner, weakself);
+                }
             }
         }
         void unloadResources() override {
-            for (std::unique_ptr<ObjectNode> &node : _nodes) {
-                node->unloadResources();
+            _resident = false;
+            
+            if (_loading == 0) {
+                for (NodePtr &node : _nodes) {
+                    node->unloadResources();
+                }
             }
         }
         void nodeLoadingComplete() {
             if (--_loading == 0) {
-                _loadingCompletion.callAndReset();
+                if (_resident) {
+                    _loadingCompletion.callAndReset();
+                }
+                else {
+                    _loadingCompletion = {};
+                    unloadResources();
+                }
             }
         }
         
+        // Index in WorldImpl::_streamedObjects or NOT_STREAMED
+        //
+        std::uint32_t streamedIndex = NOT_STREAMED;
+        
         void setPosition(const math::vector3f &pos) override;
         void setTransform(const math::transform3f &trfm) override;
+        auto findNode(const char *nodeName) const -> WorldInterface::NodeHandle override;
         void setLocalTransform(const char *nodeName, const math::transform3f &trfm) override;
+        void setLocalTransform(WorldInterface::NodeHandle node, const math::transform3f &trfm) override;
         auto getLocalTransform(const char *nodeName) const -> const math::transform3f & override;
+        auto getLocalTransform(WorldInterface::NodeHandle node) const -> const math::transform3f & override;
         auto getWorldTransform(const char *nodeName) const -> const math::transform3f & override;
+        auto getWorldTransform(WorldInterface::NodeHandle node) const -> const math::transform3f & override;
         auto getWorldTransform() const -> const math::transform3f & override;
         auto getWorldPosition() const -> const math::vector3f override;
         void setVelocity(const math::vector3f &v) override;
         void play(const char *name, bool looped, util::callback<void()> &&completion) override;
-        void update(float dtSec);
+        void play(WorldInterface::NodeHandle node, WorldInterface::AnimationHandle animation, bool looped, util::callback<void()> &&completion) override;
+        
+        // Parallel phase: takes transform from simulation, recomputes world transforms and steps animations
+        //
+        void step(float dtSec);
+        
+        // Serial phase: nodes apply their changes and call completions
+        //
+        void commit();
+        
+        void markRemoved() {
+            _removed = true;
+        }
+        bool isRemoved() const {
+            return _removed;
+        }
         
     private:
         std::size_t _id;
         std::size_t _typeMask;
         std::shared_ptr<WorldImpl> _owner;
-        std::vector<std::unique_ptr<ObjectNode>> _nodes;
-        std::unordered_map<std::string, std::size_t> _nameToNodeIndex;
+        const PrefabTemplatePtr _prefab;
+        std::vector<NodePtr, foundation::PoolAllocator<NodePtr, foundation::MemoryPoolId::WORLD, MEMORY_TAG_OBJECTS>> _nodes;
+        std::uint32_t _transformFirst = 0;
+        std::uint32_t _transformCount = 0;
         util::callback<void()> _loadingCompletion;
         int _loading = 0;
+        bool _resident = false;
+        bool _moved = false;
+        bool _removed = false;
         CollisionNode *_collisionNode = nullptr;
+        SpatialGrid::Location _gridLocation;
     };
 }
 
@@ -133,114 +857,191 @@ namespace core {
     class VoxelMeshNode : public ObjectNode {
     public:
         VoxelMeshNode(WorldInterface::NodeType type) : ObjectNode(type) {}
+        ~VoxelMeshNode() override {
+            unloadResources();
+        }
         
         void loadResources(const std::shared_ptr<WorldImpl> &world, const std::weak_ptr<ObjectImpl> &objweak) override {
             resource::ResourceProvider &res = world->getResources();
-            res.getOrLoadVoxelMesh(resourcePath.c_str(), [world, this, objweak](const std::vector<foundation::RenderDataPtr> &data, const util::Description& desc) {
+            res.getOrLoadVoxelMesh(resourcePath, [world, this, objweak](const foundation::RenderDataPtr &data, const std::vector<std::uint32_t> &frameOffsets, const util::Description& desc) {
                 if (auto object = objweak.lock()) {
-                    if (data.size()) {
-                        _mesh = world->getScene().addVoxelMesh(data, desc);
-                        _mesh->setTransform(worldTransform);
-                        
-                        if (const util::Description *anims = desc.getDescription("animations")) {
-                            _animations.clear();
-                            for (const auto &anim : anims->getVector3is()) {
-                                _animations.emplace(anim.first, Animation { anim.second.x, float(anim.second.y - anim.second.x + 1), anim.second.z / 1000.0f });
-                            }
+                    world->deferCompletion(object->getWorldPosition(), [world, this, objweak, data, frameOffsets, desc]() {
+                        if (auto object = objweak.lock()) {
+                            _addMesh(*world, data, frameOffsets, desc);
+                            object->nodeLoadingComplete();
                         }
-                    }
-                    object->nodeLoadingComplete();
+                    });
                 }
             });
         }
         void unloadResources() override {
+            if (_animationSystem) {
+                _animationSystem->stop(_playingIndex);
+            }
             _mesh = nullptr;
-            _animations.clear();
-            _currentAnimation = nullptr;
-            _animComplete = {};
-            _animTimeSec = 0.0f;
-        }
-        void play(const char *animName, bool looped, util::callback<void()> &&completion) override {
-            _animTimeSec = 0.0f;
-            const auto index = _animations.find(animName);
-            if (index != _animations.end()) {
-                _currentAnimation = &index->second;
-                _animComplete = std::move(completion);
-                _isLooped = looped;
+            _clips.clear();
+            _currentClip = nullptr;
+            _fadeLeftSec = 0.0f;
+            _currentFrame = 0;
+            _pendingFrame = -1;
+            animated = false;
+        }
+        void play(std::uint32_t animationId, bool looped, util::callback<void()> &&completion) override {
+            const Clip *clip = nullptr;
+            for (const Clip &item : _clips) {
+                if (item.id == animationId) {
+                    clip = &item;
+                    break;
+                }
+            }
+            if (clip) {
+                // switching clips cross-fades from the frame shown now
+                _fadeFromFrame = _currentFrame;
+                _fadeLeftSec = _playingIndex != AnimationSystem::NOT_PLAYING ? _crossFadeSec : 0.0f;
+                _currentClip = clip;
+                _currentLooped = looped;
+                _animationSystem->play(_playingIndex, clip->frameCount, clip->timeLenSec, looped, std::move(completion));
+                animated = true;
             }
             else {
-                _currentAnimation = nullptr;
+                if (_animationSystem) {
+                    _animationSystem->stop(_playingIndex);
+                }
+                _currentClip = nullptr;
+                animated = false;
                 completion();
             }
         }
-        void update(float dtSec) override {
+        void step(float dtSec) override {
+            if (_playingIndex == AnimationSystem::NOT_PLAYING) {
+                // clip is over, its last frame is already shown
+                animated = false;
+            }
+            else if (_mesh && _currentClip) {
+                const float frameOffset = _animationSystem->getFrameOffset(_playingIndex);
+                const int frame = int(frameOffset);
+                const int lastFrame = int(_currentClip->frameCount) - 1;
+                
+                _currentFrame = _currentClip->startFrame + frame;
+                
+                if (_fadeLeftSec > 0.0f) {
+                    _pendingFrame = _fadeFromFrame;
+                    _pendingNextFrame = _currentFrame;
+                    _pendingBlend = 1.0f - _fadeLeftSec / _crossFadeSec;
+                    _fadeLeftSec -= dtSec;
+                }
+                else {
+                    _pendingFrame = _currentFrame;
+                    // looped clip blends its last frame into the first one
+                    _pendingNextFrame = _currentClip->startFrame + (frame < lastFrame ? frame + 1 : (_currentLooped ? 0 : frame));
+                    _pendingBlend = frameOffset - float(frame);
+                }
+            }
+        }
+        void commit(const math::transform3f &worldTransform, bool moved) override {
             if (_mesh) {
-                _mesh->setTransform(worldTransform);
-
-                if (_currentAnimation) {
-                    float frameOffset = std::max(0.0f, _currentAnimation->frameCount * _animTimeSec * _currentAnimation->timeLenSec);
-                    if (frameOffset < _currentAnimation->frameCount) {
-                        _mesh->setFrame(_currentAnimation->startFrame + int(frameOffset));
-                    }
-                    else if (_isLooped) {
-                        _animComplete();
-                        _animTimeSec -= _currentAnimation->timeLenSec;
-                    }
-                    else {
-                        _animComplete.callAndReset();
+                if (moved) {
+                    _mesh->setTransform(worldTransform);
+                }
+                if (_pendingFrame >= 0) {
+                    _mesh->setFrame(_pendingFrame, _pendingNextFrame, _pendingBlend);
+                    _pendingFrame = -1;
+                }
+            }
+        }
+        
+    private:
+        void _addMesh(WorldImpl &world, const foundation::RenderDataPtr &data, const std::vector<std::uint32_t> &frameOffsets, const util::Description &desc) {
+            if (data && (_mesh = world.getScene().addVoxelMesh(data, frameOffsets, desc))) {
+                _mesh->setTransform(world.getTransforms().getWorld(transformIndex));
+                _animationSystem = &world.getAnimations();
+                _animationSystem->stop(_playingIndex);
+                _currentClip = nullptr;
+                _crossFadeSec = float(desc.getNumber("crossfade", DEFAULT_CROSSFADE_MS)) / 1000.0f;
+                _clips.clear();
+                
+                if (const util::Description *anims = desc.getDescription("animations")) {
+                    for (const auto &anim : anims->getVector3is()) {
+                        const std::uint32_t id = _animationSystem->internClipName(anim.first);
+                        _clips.emplace_back(Clip { id, anim.second.x, float(anim.second.y - anim.second.x + 1), anim.second.z / 1000.0f });
                     }
-                    _animTimeSec += dtSec;
                 }
             }
         }
         
     private:
-        struct Animation {
+        static constexpr double DEFAULT_CROSSFADE_MS = 100.0;
+        
+        struct Clip {
+            std::uint32_t id;
             int startFrame;
             float frameCount;
             float timeLenSec;
         };
-        std::unordered_map<std::string, Animation> _animations;
+        
+        // Few clips per mesh, linear search by id is faster than hashing
+        std::vector<Clip> _clips;
         core::SceneInterface::VoxelMeshPtr _mesh;
-        const Animation *_currentAnimation = nullptr;
-        float _animTimeSec = 0.0f;
-        util::callback<void()> _animComplete;
-        bool _isLooped = false;
+        AnimationSystem *_animationSystem = nullptr;
+        const Clip *_currentClip = nullptr;
+        bool _currentLooped = false;
+        std::uint32_t _playingIndex = AnimationSystem::NOT_PLAYING;
+        float _crossFadeSec = 0.0f;
+        float _fadeLeftSec = 0.0f;
+        int _fadeFromFrame = 0;
+        int _currentFrame = 0;
+        int _pendingFrame = -1;
+        int _pendingNextFrame = -1;
+        float _pendingBlend = 0.0f;
     };
 }
 
 namespace core {
     struct ParticlesNode : public ObjectNode {
         float t = 0;
+        float frameTime = 0;
         core::SceneInterface::ParticlesPtr particles;
 
         ParticlesNode(WorldInterface::NodeType type) : ObjectNode(type) {}
         
         void loadResources(const std::shared_ptr<WorldImpl> &world, const std::weak_ptr<ObjectImpl> &objweak) override {
             resource::ResourceProvider &res = world->getResources();
-            res.getOrLoadEmitter(resourcePath.c_str(), [world, this, objweak](const util::Description &desc, const foundation::RenderTexturePtr &m, const foundation::RenderTexturePtr &t) {
+            res.getOrLoadEmitter(resourcePath, [world, this, objweak](const util::Description &desc, const foundation::RenderTexturePtr &m, const foundation::RenderTexturePtr &t) {
                 if (auto object = objweak.lock()) {
-                    if (m && desc.empty() == false) {
-                        const core::ParticlesParams parameters (desc);
-                        particles = world->getScene().addParticles(t, m, parameters);
-                        particles->setTransform(worldTransform);
-                    }
-                    object->nodeLoadingComplete();
+                    const bool valid = m && desc.empty() == false;
+                    const core::ParticlesParams parameters = valid ? core::ParticlesParams(desc) : core::ParticlesParams{};
+                    
+                    world->deferCompletion(object->getWorldPosition(), [world, this, objweak, valid, parameters, t, m]() {
+                        if (auto object = objweak.lock()) {
+                            if (valid) {
+                                particles = world->getScene().addParticles(t, m, parameters);
+                                particles->setTransform(world->getTransforms().getWorld(transformIndex));
+                                animated = true;
+                            }
+                            object->nodeLoadingComplete();
+                        }
+                    });
                 }
             });
 
         }
         void unloadResources() override {
             particles = nullptr;
+            animated = false;
         }
-        void play(const char *animName, bool looped, util::callback<void()> &&completion) override {
+        void play(std::uint32_t animationId, bool looped, util::callback<void()> &&completion) override {
             
         }
-        void update(float dtSec) override {
+        void step(float dtSec) override {
+            frameTime = t;
+            t += dtSec;
+        }
+        void commit(const math::transform3f &worldTransform, bool moved) override {
             if (particles) {
-                particles->setTransform(worldTransform);
-                particles->setTime(t, 0.0f);
-                t += dtSec;
+                if (moved) {
+                    particles->setTransform(worldTransform);
+                }
+                particles->setTime(frameTime, 0.0f);
             }
         }
     };
@@ -254,24 +1055,28 @@ namespace core {
 
         void loadResources(const std::shared_ptr<WorldImpl> &world, const std::weak_ptr<ObjectImpl> &objweak) override {
             resource::ResourceProvider &res = world->getResources();
-            res.getOrLoadDescription(resourcePath.c_str(), [world, this, objweak](const util::Description &desc) {
+            res.getOrLoadDescription(resourcePath, [world, this, objweak](const util::Description &desc) {
                 if (auto object = objweak.lock()) {
-                    if (desc.empty() == false) {
-                        shape = world->getRaycast().addShape(desc, object->getId(), object->getTypeMask());
-                        shape->setTransform(worldTransform);
-                    }
-                    object->nodeLoadingComplete();
+                    world->deferCompletion(object->getWorldPosition(), [world, this, objweak, desc]() {
+                        if (auto object = objweak.lock()) {
+                            if (desc.empty() == false) {
+                                shape = world->getRaycast().addShape(desc, object->getId(), object->getTypeMask());
+                                shape->setTransform(world->getTransforms().getWorld(transformIndex));
+                            }
+                            object->nodeLoadingComplete();
+                        }
+                    });
                 }
             });
         }
         void unloadResources() override {
             shape = nullptr;
         }
-        void play(const char *animName, bool looped, util::callback<void()> &&completion) override {
+        void play(std::uint32_t animationId, bool looped, util::callback<void()> &&completion) override {
             completion();
         }
-        void update(float dtSec) override {
-            if (shape) {
+        void commit(const math::transform3f &worldTransform, bool moved) override {
+            if (shape && moved) {
                 shape->setTransform(worldTransform);
             }
         }
@@ -286,98 +1091,136 @@ namespace core {
 
         void loadResources(const std::shared_ptr<WorldImpl> &world, const std::weak_ptr<ObjectImpl> &objweak) override {
             resource::ResourceProvider &res = world->getResources();
-            res.getOrLoadDescription(resourcePath.c_str(), [world, this, objweak](const util::Description &desc) {
+            res.getOrLoadDescription(resourcePath, [world, this, objweak](const util::Description &desc) {
                 if (auto object = objweak.lock()) {
-                    if (desc.empty() == false) {
-                        body = world->getSimulation().addBody(desc);
-                        body->setTransform(worldTransform);
-                    }
-                    object->nodeLoadingComplete();
+                    world->deferCompletion(object->getWorldPosition(), [world, this, objweak, desc]() {
+                        if (auto object = objweak.lock()) {
+                            if (desc.empty() == false) {
+                                body = world->getSimulation().addBody(desc);
+                                body->setTransform(world->getTransforms().getWorld(transformIndex));
+                            }
+                            object->nodeLoadingComplete();
+                        }
+                    });
                 }
             });
         }
         void unloadResources() override {
             body = nullptr;
         }
-        void play(const char *animName, bool looped, util::callback<void()> &&completion) override {
+        void play(std::uint32_t animationId, bool looped, util::callback<void()> &&completion) override {
             completion();
         }
-        void update(float dtSec) override {
-            if (body) {
-                worldTransform = body->getTransform();
-            }
-        }
+        void commit(const math::transform3f &worldTransform, bool moved) override {}
     };
 
 }
 
 namespace core {
-    ObjectImpl::ObjectImpl(std::shared_ptr<WorldImpl> &&owner,  std::uint64_t id, const util::Description &objDesc, std::size_t mask) : _id(id), _typeMask(mask), _owner(std::move(owner)) {
-        const std::map<std::string, const util::Description *> descs = objDesc.getDescriptions();
+    ObjectImpl::ObjectImpl(std::shared_ptr<WorldImpl> &&owner,  std::uint64_t id, const PrefabTemplatePtr &prefab, std::size_t mask) : _id(id), _typeMask(mask), _owner(std::move(owner)), _prefab(prefab) {
+        TransformHierarchy &transforms = _owner->getTransforms();
         
-        for (const auto &nodeDesc : descs) {
-            if (const std::int64_t *type = nodeDesc.second->getInteger("type")) {
-                if (g_nodeConstructors[*type]) {
-                    _nameToNodeIndex.emplace(nodeDesc.first, _nodes.size());
-                    _nodes.emplace_back(g_nodeConstructors[*type]());
-                    _nodes.back()->localTransform = math::transform3f::identity().translated(nodeDesc.second->getVector3f("position", {}));
-                    if (const std::string *resourcePath = nodeDesc.second->getString("resourcePath")) {
-                        _nodes.back()->resourcePath = *resourcePath;
-                    }
-                    else {
-                        owner->getPlatform().logError("[ObjectImpl::ObjectImpl] Invalid resource path for = %s", nodeDesc.first.data());
-                    }
-                    if (const std::int64_t *parentIndex = nodeDesc.second->getInteger("parentIndex")) {
-                        _nodes.back()->parent = _nodes[*parentIndex].get();
-                        _nodes.back()->worldTransform = _nodes.back()->localTransform * _nodes[*parentIndex]->worldTransform;
-                    }
-                    else {
-                        _nodes.back()->worldTransform = _nodes.back()->localTransform;
-                    }
-                    if (*type == std::int64_t(WorldInterface::NodeType::COLLISION)) {
-                        if (_collisionNode == nullptr) {
-                            _collisionNode = static_cast<CollisionNode *>(_nodes.back().get());
-                        }
-                        else {
-                            owner->getPlatform().logError("[ObjectImpl::ObjectImpl] There can be only one collision node at the root");
-                        }
-                    }
-                }
-                else {
-                    owner->getPlatform().logError("[ObjectImpl::ObjectImpl] Unknown object type = %d", int(*type));
-                    break;
-                }
-            }
+        _transformCount = std::uint32_t(_prefab->nodes.size());
+        _transformFirst = transforms.allocate(_transformCount);
+        _nodes.reserve(_prefab->nodes.size());
+        
+        for (std::uint32_t i = 0; i < _transformCount; i++) {
+            const PrefabTemplate::Node &src = _prefab->nodes[i];
+            const std::uint32_t parent = src.parent != TransformHierarchy::NO_PARENT ? _transformFirst + src.parent : TransformHierarchy::NO_PARENT;
+            
+            _nodes.emplace_back(_owner->createNode(src.type));
+            _nodes.back()->transformIndex = _transformFirst + i;
+            _nodes.back()->resourcePath = src.resourcePath.c_str();
+            transforms.initialize(_transformFirst + i, parent, src.localTransform);
         }
+        
+        if (_prefab->collisionIndex != PrefabTemplate::NO_NODE) {
+            _collisionNode = static_cast<CollisionNode *>(_nodes[_prefab->collisionIndex].get());
+        }
+        
+        _owner->getSpatialGrid().insert(this, getWorldPosition(), _typeMask, _gridLocation);
     }
     void ObjectImpl::setPosition(const math::vector3f &pos) {
-        _nodes[0]->worldTransform.rv3 = pos.atv4start(1.0f).block;
+        TransformHierarchy &transforms = _owner->getTransforms();
+        math::transform3f trfm = transforms.getLocal(_nodes[0]->transformIndex);
+        trfm.rv3 = pos.atv4start(1.0f).block;
+        transforms.setLocal(_nodes[0]->transformIndex, trfm);
+        
         if (_collisionNode && _collisionNode->body) {
-            _collisionNode->body->setTransform(_nodes[0]->worldTransform);
+            _collisionNode->body->setTransform(transforms.getWorld(_nodes[0]->transformIndex));
             _collisionNode->body->setVelocity({0, 0, 0});
         }
     }
     void ObjectImpl::setTransform(const math::transform3f &trfm) {
-        _nodes[0]->worldTransform = trfm;
+        TransformHierarchy &transforms = _owner->getTransforms();
+        transforms.setLocal(_nodes[0]->transformIndex, trfm);
+        
         if (_collisionNode && _collisionNode->body) {
-            _collisionNode->body->setTransform(_nodes[0]->worldTransform);
+            _collisionNode->body->setTransform(transforms.getWorld(_nodes[0]->transformIndex));
             _collisionNode->body->setVelocity({0, 0, 0});
         }
     }
+    WorldInterface::NodeHandle ObjectImpl::findNode(const char *nodeName) const {
+        const auto index = _prefab->nameToNodeIndex.find(std::string_view(nodeName));
+        if (index != _prefab->nameToNodeIndex.end()) {
+            return WorldInterface::NodeHandle{std::uint32_t(index->second)};
+        }
+        return WorldInterface::NodeHandle{};
+    }
     void ObjectImpl::setLocalTransform(const char *nodeName, const math::transform3f &trfm) {
-        
+        if (const WorldInterface::NodeHandle node = findNode(nodeName)) {
+            setLocalTransform(node, trfm);
+        }
+        else {
+            _owner->getPlatform().logError("[ObjectImpl::setLocalTransform] Node '%s' not found", nodeName);
+        }
+    }
+    void ObjectImpl::setLocalTransform(WorldInterface::NodeHandle node, const math::transform3f &trfm) {
+        if (node.index < _nodes.size()) {
+            TransformHierarchy &transforms = _owner->getTransforms();
+            transforms.setLocal(_nodes[node.index]->transformIndex, trfm);
+            
+            if (_nodes[node.index].get() == _collisionNode && _collisionNode->body) {
+                _collisionNode->body->setTransform(trfm);
+            }
+        }
     }
     const math::transform3f &ObjectImpl::getLocalTransform(const char *nodeName) const {
+        if (const WorldInterface::NodeHandle node = findNode(nodeName)) {
+            return getLocalTransform(node);
+        }
+        
+        _owner->getPlatform().logError("[ObjectImpl::getLocalTransform] Node '%s' not found", nodeName);
+        return g_identity;
+    }
+    const math::transform3f &ObjectImpl::getLocalTransform(WorldInterface::NodeHandle node) const {
+        if (node.index < _nodes.size()) {
+            return _owner->getTransforms().getLocal(_nodes[node.index]->transformIndex);
+        }
         return g_identity;
     }
     const math::transform3f &ObjectImpl::getWorldTransform(const char *nodeName) const {
+        if (const WorldInterface::NodeHandle node = findNode(nodeName)) {
+            return getWorldTransform(node);
+        }
+        
+        _owner->getPlatform().logError("[ObjectImpl::getWorldTransform] Node '%s' not found", nodeName);
+        return g_identity;
+    }
+    const math::transform3f &ObjectImpl::getWorldTransform(WorldInterface::NodeHandle node) const {
+        if (node.index < _nodes.size()) {
+            TransformHierarchy &transforms = _owner->getTransforms();
+            transforms.updateRange(_transformFirst, _transformCount);
+            return transforms.getWorld(_nodes[node.index]->transformIndex);
+        }
         return g_identity;
     }
     const math::transform3f &ObjectImpl::getWorldTransform() const {
-        return _nodes[0]->worldTransform;
+        return _owner->getTransforms().getWorld(_nodes[0]->transformIndex);
     }
     const math::vector3f ObjectImpl::getWorldPosition() const {
-        return math::vector3f(_nodes[0]->worldTransform.m41, _nodes[0]->worldTransform.m42, _nodes[0]->worldTransform.m43);
+        const math::transform3f &trfm = getWorldTransform();
+        return math::vector3f(trfm.m41, trfm.m42, trfm.m43);
     }
     void ObjectImpl::setVelocity(const math::vector3f &v) {
         if (_collisionNode && _collisionNode->body) {
@@ -385,19 +1228,61 @@ namespace core {
         }
     }
     void ObjectImpl::play(const char *name, bool looped, util::callback<void()> &&completion) {
-        const std::string src = name;
+        const std::string_view src = name;
         const auto colonPos = src.find(':');
-        const std::string nodeName = src.substr(0, colonPos);
-        const std::string animName = colonPos != std::string::npos ? src.substr(colonPos + 1, std::string::npos) : std::string();
-        const auto index = _nameToNodeIndex.find(nodeName);
-        if (index != _nameToNodeIndex.end()) {
-            _nodes[index->second]->play(animName.data(), looped, std::move(completion));
+        const std::string_view nodeName = src.substr(0, colonPos);
+        const char *animName = colonPos != std::string_view::npos ? name + colonPos + 1 : "";
+        const auto index = _prefab->nameToNodeIndex.find(nodeName);
+        if (index != _prefab->nameToNodeIndex.end()) {
+            _nodes[index->second]->play(_owner->getAnimations().findClipName(animName), looped, std::move(completion));
+        }
+    }
+    void ObjectImpl::play(WorldInterface::NodeHandle node, WorldInterface::AnimationHandle animation, bool looped, util::callback<void()> &&completion) {
+        if (node.index < _nodes.size()) {
+            _nodes[node.index]->play(animation.id, looped, std::move(completion));
+        }
+        else {
+            completion();
+        }
+    }
+    void ObjectImpl::step(float dtSec) {
+        TransformHierarchy &transforms = _owner->getTransforms();
+        
+        if (_collisionNode && _collisionNode->body) {
+            const math::transform3f trfm = _collisionNode->body->getTransform();
+            const math::transform3f &current = transforms.getLocal(_collisionNode->transformIndex);
+            
+            if (std::equal(std::begin(trfm.flat), std::end(trfm.flat), std::begin(current.flat)) == false) {
+                transforms.setLocal(_collisionNode->transformIndex, trfm);
+            }
+        }
+        
+        _moved = transforms.updateRange(_transformFirst, _transformCount);
+        
+        for (NodePtr &node : _nodes) {
+            if (node->animated) {
+                node->step(dtSec);
+            }
         }
     }
-    void ObjectImpl::update(float dtSec) {
-        for (std::unique_ptr<ObjectNode> &node : _nodes) {
-            node->worldTransform = node->parent ? node->localTransform * node->parent->worldTransform : node->worldTransform;
-            node->update(dtSec);
+    void ObjectImpl::commit() {
+        TransformHierarchy &transforms = _owner->getTransforms();
+        
+        for (std::size_t i = 0; i < _nodes.size(); i++) {
+            ObjectNode &node = *_nodes[i];
+            const bool moved = _moved && transforms.isMoved(node.transformIndex);
+            
+            if (moved || node.animated) {
+                node.commit(transforms.getWorld(node.transformIndex), moved);
+            }
+        }
+        if (_moved) {
+            if (transforms.isMoved(_transformFirst)) {
+                _owner->getSpatialGrid().move(getWorldPosition(), _gridLocation);
+            }
+            
+            transforms.clearMoved(_transformFirst, _transformCount);
+            _moved = false;
         }
     }
 }
@@ -416,43 +1301,271 @@ namespace core {
     , _raycast(raycast)
     , _simulation(simulation)
     {
-        g_nodeConstructors[int(WorldInterface::NodeType::VOXEL)] = []() -> std::unique_ptr<ObjectNode> {
-            return std::make_unique<VoxelMeshNode>(WorldInterface::NodeType::VOXEL);
-        };
-        g_nodeConstructors[int(WorldInterface::NodeType::PARTICLES)] = []() -> std::unique_ptr<ObjectNode> {
-            return std::make_unique<ParticlesNode>(WorldInterface::NodeType::PARTICLES);
-        };
-        g_nodeConstructors[int(WorldInterface::NodeType::RAYCAST)] = []() -> std::unique_ptr<ObjectNode> {
-            return std::make_unique<RaycastNode>(WorldInterface::NodeType::RAYCAST);
-        };
-        g_nodeConstructors[int(WorldInterface::NodeType::COLLISION)] = []() -> std::unique_ptr<ObjectNode> {
-            return std::make_unique<CollisionNode>(WorldInterface::NodeType::COLLISION);
-        };
+        _registerNode<VoxelMeshNode>(WorldInterface::NodeType::VOXEL);
+        _registerNode<ParticlesNode>(WorldInterface::NodeType::PARTICLES);
+        _registerNode<RaycastNode>(WorldInterface::NodeType::RAYCAST);
+        _registerNode<CollisionNode>(WorldInterface::NodeType::COLLISION);
     }
     WorldImpl::~WorldImpl() {
     
+    }
+    template<typename T> void WorldImpl::_registerNode(WorldInterface::NodeType type) {
+        static_assert(alignof(T) <= foundation::MemoryPool::ALIGNMENT, "node is overaligned for its pool");
+        NodeFactory &factory = _nodeFactories[int(type)];
+        factory.pool = std::make_unique<foundation::FixedSizePool>(foundation::MemoryPoolId::WORLD, sizeof(T), NODES_PER_BLOCK, MEMORY_TAG_NODES);
+        factory.construct = [](void *memory, WorldInterface::NodeType type) -> ObjectNode * {
+            return new (memory) T (type);
+        };
+    }
+    NodePtr WorldImpl::createNode(WorldInterface::NodeType type) {
+        NodeFactory &factory = _nodeFactories[int(type)];
+        return NodePtr(factory.construct(factory.pool->allocate(), type), NodeDeleter{factory.pool.get()});
+    }
+    PrefabTemplatePtr WorldImpl::_getPrefabTemplate(const char *prefabPath) {
+        if (_prefabsVersion != _resourceProvider->getPrefabsVersion()) {
+            _prefabsVersion = _resourceProvider->getPrefabsVersion();
+            _prefabTemplates.clear();
+        }
+        
+        const auto index = _prefabTemplates.find(std::string_view(prefabPath));
+        if (index != _prefabTemplates.end()) {
+            return index->second;
+        }
+        
+        std::shared_ptr<PrefabTemplate> result = std::make_shared<PrefabTemplate>();
+        const std::map<std::string, const util::Description *> descs = _resourceProvider->getPrefab(prefabPath).getDescriptions();
+        
+        for (const auto &nodeDesc : descs) {
+            if (const std::int64_t *type = nodeDesc.second->getInteger("type")) {
+                if (*type >= 0 && *type < std::int64_t(WorldInterface::NodeType::_count) && _nodeFactories[*type].construct) {
+                    PrefabTemplate::Node &node = result->nodes.emplace_back();
+                    node.type = WorldInterface::NodeType(*type);
+                    node.parent = TransformHierarchy::NO_PARENT;
+                    node.localTransform = math::transform3f::identity().translated(nodeDesc.second->getVector3f("position", {}));
+                    result->nameToNodeIndex.emplace(nodeDesc.first, result->nodes.size() - 1);
+                    
+                    if (const std::string *resourcePath = nodeDesc.second->getString("resourcePath")) {
+                        node.resourcePath = *resourcePath;
+                    }
+                    else {
+                        _platform->logError("[WorldImpl::_getPrefabTemplate] Invalid resource path for = %s", nodeDesc.first.data());
+                    }
+                    
+                    // Collision node takes its world transform from simulation, so it has no parent
+                    const std::int64_t *parentIndex = nodeDesc.second->getInteger("parentIndex");
+                    if (parentIndex && node.type != WorldInterface::NodeType::COLLISION) {
+                        if (*parentIndex >= 0 && std::size_t(*parentIndex) + 1 < result->nodes.size()) {
+                            node.parent = std::uint32_t(*parentIndex);
+                        }
+                        else {
+                            _platform->logError("[WorldImpl::_getPrefabTemplate] Parent of '%s' must be defined before it", nodeDesc.first.data());
+                        }
+                    }
+                    
+                    if (node.type == WorldInterface::NodeType::COLLISION) {
+                        if (result->collisionIndex == PrefabTemplate::NO_NODE) {
+                            result->collisionIndex = result->nodes.size() - 1;
+                        }
+                        else {
+                            _platform->logError("[WorldImpl::_getPrefabTemplate] There can be only one collision node at the root");
+                        }
+                    }
+                }
+                else {
+                    _platform->logError("[WorldImpl::_getPrefabTemplate] Unknown object type = %d", int(*type));
+                    break;
+                }
+            }
+        }
+        
+        if (result->nodes.empty()) {
+            result = nullptr;
+        }
+        
+        return _prefabTemplates.emplace(std::string(prefabPath), std::move(result)).first->second;
     }
     WorldInterface::ObjectPtr WorldImpl::getObject(const char *name) {
-        auto index = _namedObjects.find(name);
+        auto index = _namedObjects.find(std::string_view(name));
         if (index != _namedObjects.end()) {
             return index->second;
         }
         return nullptr;
     }
+    WorldInterface::AnimationHandle WorldImpl::getAnimationHandle(const char *animationName) {
+        return WorldInterface::AnimationHandle{_animations.internClipName(animationName)};
+    }
+    std::size_t WorldImpl::queryRadius(const math::vector3f &center, float radius, std::uint64_t typeMask, ObjectPtr *output, std::size_t capacity) {
+        const math::bound3f box = {center.x - radius, center.y - radius, center.z - radius, center.x + radius, center.y + radius, center.z + radius};
+        std::size_t count = 0;
+        
+        _spatialGrid.forEachInBox(box, [&](const SpatialGrid::Entry &entry) {
+            const math::vector3f offset = {entry.position.x - center.x, entry.position.y - center.y, entry.position.z - center.z};
+            if ((entry.typeMask & typeMask) && entry.object->isRemoved() == false && offset.lengthSq() <= radius * radius) {
+                if (count < capacity) {
+                    output[count] = entry.object->shared_from_this();
+                }
+                count++;
+            }
+        });
+        
+        return count;
+    }
+    std::size_t WorldImpl::queryBox(const math::bound3f &box, std::uint64_t typeMask, ObjectPtr *output, std::size_t capacity) {
+        std::size_t count = 0;
+        
+        _spatialGrid.forEachInBox(box, [&](const SpatialGrid::Entry &entry) {
+            if ((entry.typeMask & typeMask) && entry.object->isRemoved() == false) {
+                if (count < capacity) {
+                    output[count] = entry.object->shared_from_this();
+                }
+                count++;
+            }
+        });
+        
+        return count;
+    }
+    std::size_t WorldImpl::queryFrustum(const math::transform3f &viewProjection, std::uint64_t typeMask, ObjectPtr *output, std::size_t capacity) {
+        const math::transform3f &m = viewProjection;
+        
+        // Row vectors are transformed, so clip coordinates are dot products with columns: -w <= x, y <= w, 0 <= z <= w
+        const math::vector4f planes[6] = {
+            {m.m14 + m.m11, m.m24 + m.m21, m.m34 + m.m31, m.m44 + m.m41},
+            {m.m14 - m.m11, m.m24 - m.m21, m.m34 - m.m31, m.m44 - m.m41},
+            {m.m14 + m.m12, m.m24 + m.m22, m.m34 + m.m32, m.m44 + m.m42},
+            {m.m14 - m.m12, m.m24 - m.m22, m.m34 - m.m32, m.m44 - m.m42},
+            {m.m13, m.m23, m.m33, m.m43},
+            {m.m14 - m.m13, m.m24 - m.m23, m.m34 - m.m33, m.m44 - m.m43},
+        };
+        std::size_t count = 0;
+        
+        _spatialGrid.forEachInPlanes(planes, [&](const SpatialGrid::Entry &entry) {
+            if ((entry.typeMask & typeMask) && entry.object->isRemoved() == false) {
+                if (count < capacity) {
+                    output[count] = entry.object->shared_from_this();
+                }
+                count++;
+            }
+        });
+        
+        return count;
+    }
+    void WorldImpl::setStreaming(std::uint64_t typeMask, float loadDistance, float unloadDistance) {
+        if (unloadDistance < loadDistance) {
+            _platform->logError("[WorldImpl::setStreaming] Unload distance is less than load distance");
+            unloadDistance = loadDistance;
+        }
+        
+        _streamingTypeMask = typeMask;
+        _streamingLoadDistance = loadDistance;
+        _streamingUnloadDistance = unloadDistance;
+    }
+    void WorldImpl::setStreamingFocus(const math::vector3f *points, std::size_t count) {
+        _streamingFocus.assign(points, points + count);
+    }
+    void WorldImpl::setLoadingBudget(float ms) {
+        _loadingBudgetUs = std::uint64_t(std::max(ms, 0.0f) * 1000.0f);
+    }
+    WorldInterface::LoadingStats WorldImpl::getLoadingStats() const {
+        return _completions.getStats();
+    }
+    void WorldImpl::deferCompletion(const math::vector3f &position, util::callback<void()> &&work) {
+        const math::vector3f offset = {position.x - _cameraPosition.x, position.y - _cameraPosition.y, position.z - _cameraPosition.z};
+        _completions.push(offset.lengthSq(), std::move(work));
+    }
+    void WorldImpl::removeStreamed(ObjectImpl &object) {
+        if (object.streamedIndex != ObjectImpl::NOT_STREAMED) {
+            if (object.streamedIndex + 1 < _streamedObjects.size()) {
+                _streamedObjects[object.streamedIndex] = _streamedObjects.back();
+                _streamedObjects[object.streamedIndex]->streamedIndex = object.streamedIndex;
+            }
+            
+            _streamedObjects.pop_back();
+            object.streamedIndex = ObjectImpl::NOT_STREAMED;
+        }
+    }
+    void WorldImpl::_updateStreaming() {
+        const float unloadDistanceSq = _streamingUnloadDistance * _streamingUnloadDistance;
+        const float loadDistanceSq = _streamingLoadDistance * _streamingLoadDistance;
+        
+        // Object is kept while it is closer than unload distance to some focus point
+        for (std::size_t i = 0; i < _streamedObjects.size(); ) {
+            ObjectImpl &object = *_streamedObjects[i];
+            const math::vector3f position = object.getWorldPosition();
+            bool keep = (object.getTypeMask() & _streamingTypeMask) != 0 && object.isResident();
+            
+            if (keep) {
+                keep = false;
+                for (const math::vector3f &focus : _streamingFocus) {
+                    const math::vector3f offset = {position.x - focus.x, position.y - focus.y, position.z - focus.z};
+                    keep = keep || offset.lengthSq() <= unloadDistanceSq;
+                }
+                if (keep == false) {
+                    object.unloadResources();
+                }
+            }
+            if (keep) {
+                i++;
+            }
+            else {
+                removeStreamed(object);
+            }
+        }
+        
+        _streamingCandidates.clear();
+        
+        for (const math::vector3f &focus : _streamingFocus) {
+            const float d = _streamingLoadDistance;
+            const math::bound3f box = {focus.x - d, focus.y - d, focus.z - d, focus.x + d, focus.y + d, focus.z + d};
+            
+            _spatialGrid.forEachInBox(box, [&](const SpatialGrid::Entry &entry) {
+                if ((entry.typeMask & _streamingTypeMask) && entry.object->streamedIndex == ObjectImpl::NOT_STREAMED && entry.object->isRemoved() == false) {
+                    const math::vector3f offset = {entry.position.x - focus.x, entry.position.y - focus.y, entry.position.z - focus.z};
+                    const float distanceSq = offset.lengthSq();
+                    
+                    if (distanceSq <= loadDistanceSq) {
+                        _streamingCandidates.emplace_back(distanceSq, entry.object);
+                    }
+                }
+            });
+        }
+        
+        // Object found from several focus points goes by its nearest distance, later duplicates are skipped
+        std::sort(_streamingCandidates.begin(), _streamingCandidates.end(), [](const auto &a, const auto &b) {
+            return a.first < b.first;
+        });
+        
+        std::size_t loadsLeft = STREAMING_LOADS_PER_UPDATE;
+        for (std::size_t i = 0; i < _streamingCandidates.size() && loadsLeft > 0; i++) {
+            ObjectImpl &object = *_streamingCandidates[i].second;
+            
+            if (object.streamedIndex == ObjectImpl::NOT_STREAMED) {
+                object.streamedIndex = std::uint32_t(_streamedObjects.size());
+                _streamedObjects.emplace_back(&object);
+                
+                // Objects loaded by game code are just taken under control
+                if (object.isResident() == false) {
+                    object.loadResources({});
+                    loadsLeft--;
+                }
+            }
+        }
+    }
     WorldInterface::ObjectPtr WorldImpl::createObject(const char *prefabPath, std::uint64_t typeMask, const char *name) {
+        using ObjectAllocator = foundation::PoolAllocator<ObjectImpl, foundation::MemoryPoolId::WORLD, MEMORY_TAG_OBJECTS>;
         const std::uint64_t newId = getNextUniqueId();
-        const util::Description desc = _resourceProvider->getPrefab(prefabPath);
-        if (desc.empty() == false) {
+        const PrefabTemplatePtr prefab = _getPrefabTemplate(prefabPath);
+        if (prefab) {
             if (name) {
-                if (_namedObjects.find(name) == _namedObjects.end()) {
-                    return _namedObjects.emplace(std::string(name), std::make_shared<ObjectImpl>(shared_from_this(), newId, desc, typeMask)).first->second;
+                if (_namedObjects.find(std::string_view(name)) == _namedObjects.end()) {
+                    _objects.emplace_back(std::allocate_shared<ObjectImpl>(ObjectAllocator(), shared_from_this(), newId, prefab, typeMask));
+                    return _namedObjects.emplace(std::string(name), _objects.back()).first->second;
                 }
                 else {
                     _platform->logError("[WorldImpl::createObject] Object with name '%s' already exists in the world", name);
                 }
             }
             else {
-                return _unnamedObjects.emplace(newId, std::make_shared<ObjectImpl>(shared_from_this(), newId, desc, typeMask)).first->second;
+                return _objects.emplace_back(std::allocate_shared<ObjectImpl>(ObjectAllocator(), shared_from_this(), newId, prefab, typeMask));
             }
         }
         else {
@@ -461,20 +1574,50 @@ namespace core {
         return nullptr;
     }
     void WorldImpl::removeObject(const char *name) {
-        _namedObjects.erase(name);
+        auto index = _namedObjects.find(std::string_view(name));
+        if (index != _namedObjects.end()) {
+            index->second->markRemoved();
+            _namedObjects.erase(index);
+        }
     }
     void WorldImpl::update(float dtSec) {
-        for (auto &item : _namedObjects) {
-            item.second->update(dtSec);
-        }
-        for (auto index = _unnamedObjects.begin(); index != _unnamedObjects.end(); ) {
-            if (index->second.use_count() > 1) {
-                index->second->update(dtSec);
-                ++index;
+        for (std::size_t i = 0; i < _objects.size(); ) {
+            if (_objects[i].use_count() > 1 && _objects[i]->isRemoved() == false) {
+                i++;
             }
             else {
-                index = _unnamedObjects.erase(index);
+                if (i + 1 < _objects.size()) {
+                    _objects[i] = std::move(_objects.back());
+                }
+                _objects.pop_back();
+            }
+        }
+        
+        if (_scene) {
+            _cameraPosition = _scene->getCameraPosition();
+        }
+        
+        _completions.process(_loadingBudgetUs);
+        _animations.advance(dtSec);
+        
+        // Objects touch only their own data and transform ranges here
+        const std::size_t count = _objects.size();
+        foundation::JobSystem::parallelFor((count + OBJECTS_PER_CHUNK - 1) / OBJECTS_PER_CHUNK, [this, count, dtSec](std::size_t chunk) {
+            const std::size_t end = std::min(count, (chunk + 1) * OBJECTS_PER_CHUNK);
+            for (std::size_t i = chunk * OBJECTS_PER_CHUNK; i < end; i++) {
+                _objects[i]->step(dtSec);
             }
+        });
+        
+        // Completions can create objects, so new ones are committed next frame
+        for (std::size_t i = 0; i < count; i++) {
+            _objects[i]->commit();
+        }
+        
+        _animations.fireCompletions();
+        
+        if (_streamingTypeMask) {
+            _updateStreaming();
         }
     }
 }
@@ -46,6 +46,32 @@ namespace core {
         struct Object;
         using ObjectPtr = std::shared_ptr<Object>;
         
+        // Resolved node name. Valid for every object created from the same prefab
+        //
+        struct NodeHandle {
+            std::uint32_t index = std::uint32_t(-1);
+            
+            explicit operator bool() const { return index != std::uint32_t(-1); }
+        };
+        
+        // Interned animation name. Valid for every mesh of the world, even for meshes loaded later
+        //
+        struct AnimationHandle {
+            std::uint32_t id = std::uint32_t(-1);
+            
+            explicit operator bool() const { return id != std::uint32_t(-1); }
+        };
+        
+        // Loaded resources are added to the world by update() nearest to camera first, within time budget
+        //
+        struct LoadingStats {
+            std::size_t queueLength = 0;    // loaded resources waiting to be added
+            std::size_t completedCount = 0; // resources added by the last update
+            float averageWaitMs = 0.0f;     // time between loading and adding of resources added by the last update
+            float maxWaitMs = 0.0f;
+            float spentMs = 0.0f;           // time of adding in the last update
+        };
+        
         struct Object {
             virtual auto getId() const -> std::uint64_t = 0;
             virtual auto getTypeMask() const -> std::uint64_t = 0;
@@ -56,9 +82,20 @@ namespace core {
             
             virtual void setPosition(const math::vector3f &pos) = 0;
             virtual void setTransform(const math::transform3f &trfm) = 0;
+            
+            // Returns handle of the node with full name like 'root.weapon' or invalid handle if there is no such node
+            //
+            virtual auto findNode(const char *nodeName) const -> NodeHandle = 0;
+            
+            // Node transforms. Local transform is relative to the parent node
+            // World transform of a node is recomputed on request if some node above it was changed
+            //
             virtual void setLocalTransform(const char *nodeName, const math::transform3f &trfm) = 0;
+            virtual void setLocalTransform(NodeHandle node, const math::transform3f &trfm) = 0;
             virtual auto getLocalTransform(const char *nodeName) const -> const math::transform3f & = 0;
+            virtual auto getLocalTransform(NodeHandle node) const -> const math::transform3f & = 0;
             virtual auto getWorldTransform(const char *nodeName) const -> const math::transform3f & = 0;
+            virtual auto getWorldTransform(NodeHandle node) const -> const math::transform3f & = 0;
             virtual auto getWorldTransform() const -> const math::transform3f & = 0;
             virtual auto getWorldPosition() const -> const math::vector3f = 0;
             virtual void setVelocity(const math::vector3f &v) = 0;
@@ -73,11 +110,49 @@ namespace core {
             //
             virtual void play(const char *name, bool looped, util::callback<void()> &&completion = {}) = 0;
             
+            // Play mesh animation without string lookups
+            // @node      - voxel mesh node
+            // @animation - handle from WorldInterface::getAnimationHandle()
+            //
+            virtual void play(NodeHandle node, AnimationHandle animation, bool looped, util::callback<void()> &&completion = {}) = 0;
+            
             virtual ~Object() = default;
         };
         
     public:
         virtual auto getObject(const char *name) -> ObjectPtr = 0;
+        
+        // @animationName - name of the mesh animation without node name
+        //
+        virtual auto getAnimationHandle(const char *animationName) -> AnimationHandle = 0;
+        
+        // Spatial queries by positions of objects as they were at the last update()
+        // @typeMask - object is found if its type mask has common bits with @typeMask
+        // @output   - caller's buffer, filled up to @capacity
+        // @return   - number of all found objects, can be more than @capacity
+        //
+        virtual auto queryRadius(const math::vector3f &center, float radius, std::uint64_t typeMask, ObjectPtr *output, std::size_t capacity) -> std::size_t = 0;
+        virtual auto queryBox(const math::bound3f &box, std::uint64_t typeMask, ObjectPtr *output, std::size_t capacity) -> std::size_t = 0;
+        
+        // @viewProjection - matrix to clip space with z-range [0..1]
+        //
+        virtual auto queryFrustum(const math::transform3f &viewProjection, std::uint64_t typeMask, ObjectPtr *output, std::size_t capacity) -> std::size_t = 0;
+        
+        // Streaming. Objects of @typeMask types load resources by themselves when they are closer than @loadDistance to any focus point
+        // and unload them when they are farther than @unloadDistance from all focus points. Nearest objects are loaded first
+        // @unloadDistance - should be greater than @loadDistance, so objects at the border are not reloaded every frame
+        // @typeMask       - zero disables streaming, loaded objects stay loaded
+        //
+        virtual void setStreaming(std::uint64_t typeMask, float loadDistance, float unloadDistance) = 0;
+        
+        // @points - camera, player and so on. Can be changed every frame
+        //
+        virtual void setStreamingFocus(const math::vector3f *points, std::size_t count) = 0;
+        
+        // @ms - time per update for adding loaded resources to scene, raycast and simulation. At least one resource is added every update
+        //
+        virtual void setLoadingBudget(float ms) = 0;
+        virtual auto getLoadingStats() const -> LoadingStats = 0;
 
         // Create game object
         // @prefabPath - name of the prefab
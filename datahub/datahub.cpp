@@ -1,7 +1,11 @@
 
 #include "datahub.h"
 #include "foundation/util.h"
+#include "foundation/memory.h"
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
 #include <memory>
 #include <variant>
 #include <string>
@@ -9,8 +13,6 @@
 #include <queue>
 #include <unordered_map>
 
-// TODO: tests
-
 namespace {
     using ElementIndex = std::uint8_t;
     using TemplateIndex = std::uint8_t;
@@ -18,23 +20,26 @@ namespace {
     static const std::size_t MAX_STRING_LENGTH = 1024;
     static const std::size_t MAX_ELEMENTS_PER_SCOPE = 254;
     static const std::size_t MAX_SCOPE_TEMPLATES = 254;
+    static const ElementIndex INVALID_ELEMENT_INDEX = 0xff;
+    static const std::uint32_t SNAPSHOT_MAGIC = 0x31534844; // 'DHS1'
+    static const std::uint32_t DELTA_MAGIC = 0x31444844;    // 'DHD1'
+    static const dh::ScopeId ITEM_ID_BASE = 0x800000;      // root ids are below
     
     std::uint8_t g_stringBuffer[MAX_STRING_LENGTH + sizeof(std::uint16_t)];
-    dh::EventToken g_nextEventToken = 0x10;
-    dh::ScopeId g_nextScopeId = 0x800000;
     
     template<typename T> T g_dummy;
     
-    dh::EventToken getNextEventToken() {
-        return g_nextEventToken++;
-    }
-
-    dh::ScopeId getNextScopeId() {
-        return g_nextScopeId = (g_nextScopeId + 1) & 0xffffff;
+    std::uint32_t getNameHash(const char *name) {
+        std::uint32_t result = 2166136261u;
+        while (*name) {
+            result = (result ^ std::uint8_t(*name++)) * 16777619u;
+        }
+        return result;
     }
 
+    // Microseconds from an arbitrary monotonic origin
     std::uint64_t getCurrentTimeStamp() {
-        return 0;
+        return std::uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
     }
 
     struct Location {
@@ -48,21 +53,82 @@ namespace {
         Location location;
     };
     
+    template<typename T> void writeData(std::vector<std::uint8_t> &output, const T &value) {
+        const std::uint8_t *bytes = reinterpret_cast<const std::uint8_t *>(&value);
+        output.insert(output.end(), bytes, bytes + sizeof(T));
+    }
+    
+    // Bounds-checked reading of snapshot and delta data. Values may be unaligned, so they're copied out
+    //
+    class ByteReader {
+    public:
+        ByteReader(const std::uint8_t *data, std::size_t length) : _current(data), _end(data + length) {}
+        
+        template<typename T> bool read(T &value) {
+            if (std::size_t(_end - _current) >= sizeof(T)) {
+                memcpy(&value, _current, sizeof(T));
+                _current += sizeof(T);
+                return true;
+            }
+            
+            _current = _end;
+            return false;
+        }
+        
+        const std::uint8_t *skip(std::size_t length) {
+            if (std::size_t(_end - _current) >= length) {
+                const std::uint8_t *result = _current;
+                _current += length;
+                return result;
+            }
+            
+            _current = _end;
+            return nullptr;
+        }
+        
+        const std::uint8_t *current() const { return _current; }
+        bool isEof() const { return _current >= _end; }
+        
+    private:
+        const std::uint8_t *_current;
+        const std::uint8_t *_end;
+    };
+    
+    // Snapshot values are unaligned. Vectors are assigned from scalar copies as they aren't trivially copyable
+    //
+    template<typename T> void readUnaligned(const std::uint8_t *data, T &value) {
+        memcpy(&value, data, sizeof(T));
+    }
+    void readUnaligned(const std::uint8_t *data, math::vector2f &value) {
+        math::scalar xy[2];
+        memcpy(xy, data, sizeof(xy));
+        value = math::vector2f(xy);
+    }
+    void readUnaligned(const std::uint8_t *data, math::vector3f &value) {
+        math::scalar xyz[3];
+        memcpy(xyz, data, sizeof(xyz));
+        value = math::vector3f(xyz);
+    }
+    
     class MemoryQueue {
         struct Msg {
             MsgHeader header;
-            std::unique_ptr<std::uint8_t[]> data;
+            foundation::PoolBytes data;
             std::size_t length;
         };
     
     public:
         void enqueue( const MsgHeader &header, const void *data, std::size_t length ) {
-            std::unique_ptr<std::uint8_t[]> m = std::make_unique<std::uint8_t[]>(length);
+            foundation::PoolBytes m = foundation::makePoolBytes(foundation::MemoryPoolId::DATAHUB, length);
             memcpy(m.get(), data, length);
             _queue.emplace(Msg{header, std::move(m), length});
         }
         
-        bool dequeue( MsgHeader &header, std::unique_ptr<std::uint8_t[]> &data, std::size_t &length ) {
+        std::size_t size() const {
+            return _queue.size();
+        }
+        
+        bool dequeue( MsgHeader &header, foundation::PoolBytes &data, std::size_t &length ) {
             if (_queue.empty() == false) {
                 header = _queue.front().header;
                 data = std::move(_queue.front().data);
@@ -87,9 +153,142 @@ namespace dh {
     const std::uint8_t MSG_TYPE_ITEM_ADDED = 0x2;
     const std::uint8_t MSG_TYPE_ITEM_REMOVED = 0x3;
     
+    // Event token layout: | table : 1 | generation : 7 | slot : 16 | element index : 8 |
+    // Table bit distinguishes onItemAdded and onItemRemoved handlers of the same array
+    //
+    const std::uint32_t TOKEN_REMOVED_TABLE_BIT = 0x80000000;
+    
+    // Handlers are kept densely for dispatch. Slots map tokens to dense positions, so removal is O(1)
+    // Adding or removing while handlers are being called is deferred until the dispatch ends
+    //
+    template<typename Signature> class HandlerTable {
+    public:
+        HandlerTable() = default;
+        HandlerTable(HandlerTable &&) = default;
+        HandlerTable(const HandlerTable &) {} // handlers aren't copied with a scope template
+        HandlerTable &operator =(const HandlerTable &) = delete;
+        
+        // @return handle or 0 if table is full
+        std::uint32_t add(util::callback<Signature> &&handler) {
+            std::uint32_t slot = 0;
+            
+            if (_freeSlots.empty() == false) {
+                slot = _freeSlots.back();
+                _freeSlots.pop_back();
+            }
+            else if (_slots.size() < MAX_SLOTS) {
+                slot = std::uint32_t(_slots.size());
+                _slots.emplace_back(Slot{});
+            }
+            else {
+                return 0;
+            }
+            
+            if (_dispatching) {
+                _slots[slot].index = std::uint32_t(_added.size());
+                _slots[slot].isAdded = true;
+                _added.emplace_back(Entry{std::move(handler), slot});
+            }
+            else {
+                _slots[slot].index = std::uint32_t(_entries.size());
+                _slots[slot].isAdded = false;
+                _entries.emplace_back(Entry{std::move(handler), slot});
+            }
+            
+            return std::uint32_t(_slots[slot].generation) << 16 | slot;
+        }
+        
+        bool remove(std::uint32_t handle) {
+            const std::uint32_t slot = handle & 0xffff;
+            
+            if (slot < _slots.size() && _slots[slot].generation == (handle >> 16) && _slots[slot].index != INVALID_INDEX) {
+                Slot &target = _slots[slot];
+                
+                if (target.isAdded) {
+                    _added[target.index].slot = INVALID_INDEX;
+                }
+                else if (_dispatching) {
+                    _entries[target.index].slot = INVALID_INDEX;
+                    _hasRemoved = true;
+                }
+                else {
+                    _erase(target.index);
+                }
+                
+                target.index = INVALID_INDEX;
+                target.generation = target.generation % MAX_GENERATION + 1;
+                _freeSlots.emplace_back(slot);
+                return true;
+            }
+            
+            return false;
+        }
+        
+        template<typename... Args> void call(const Args &... args) {
+            _dispatching++;
+            
+            for (std::size_t i = 0, count = _entries.size(); i < count; i++) {
+                if (_entries[i].slot != INVALID_INDEX) {
+                    _entries[i].handler(args...);
+                }
+            }
+            
+            if (--_dispatching == 0) {
+                _flush();
+            }
+        }
+        
+    private:
+        static const std::uint32_t MAX_SLOTS = 0x10000;
+        static const std::uint8_t MAX_GENERATION = 0x7f;
+        static const std::uint32_t INVALID_INDEX = std::uint32_t(-1);
+        
+        struct Entry {
+            util::callback<Signature> handler;
+            std::uint32_t slot;
+        };
+        struct Slot {
+            std::uint32_t index = INVALID_INDEX;
+            std::uint8_t generation = 1;
+            bool isAdded = false;
+        };
+        
+        void _erase(std::uint32_t index) {
+            if (index + 1 != _entries.size()) {
+                _entries[index] = std::move(_entries.back());
+                _slots[_entries[index].slot].index = index;
+            }
+            _entries.pop_back();
+        }
+        
+        void _flush() {
+            if (_hasRemoved) {
+                for (std::uint32_t i = 0; i < _entries.size(); ) {
+                    _entries[i].slot == INVALID_INDEX ? _erase(i) : (void)i++;
+                }
+                _hasRemoved = false;
+            }
+            for (Entry &entry : _added) {
+                if (entry.slot != INVALID_INDEX) {
+                    _slots[entry.slot].index = std::uint32_t(_entries.size());
+                    _slots[entry.slot].isAdded = false;
+                    _entries.emplace_back(std::move(entry));
+                }
+            }
+            _added.clear();
+        }
+        
+        std::vector<Entry> _entries;
+        std::vector<Entry> _added;
+        std::vector<Slot> _slots;
+        std::vector<std::uint32_t> _freeSlots;
+        std::uint32_t _dispatching = 0;
+        bool _hasRemoved = false;
+    };
+    
     template<typename Type> struct Value {
         Type value;
-        std::vector<std::pair<EventToken, std::function<void(const Type &)>>> onChangedHandlers;
+        HandlerTable<void(const Type &)> onChangedHandlers;
     };
     
     struct Array {
@@ -97,8 +296,8 @@ namespace dh {
         
         const TemplateIndex scopeTemplateIndex;
         std::unordered_map<ScopeId, std::shared_ptr<ScopeImpl>> items;
-        std::vector<std::pair<EventToken, std::function<void(const ScopePtr &)>>> onAddedHandlers;
-        std::vector<std::pair<EventToken, std::function<void(ScopeId)>>> onRemoveHandlers;
+        HandlerTable<void(const ScopePtr &)> onAddedHandlers;
+        HandlerTable<void(ScopeId)> onRemoveHandlers;
     };
     
     struct Element {
@@ -130,158 +329,247 @@ namespace dh {
             struct ElementVisitor : Ls... { using Ls::operator()...; };
             std::visit(ElementVisitor{ls...}, element->data);
         }
+        template<typename... Ls> static void visit(const Element *element, Ls&&... ls) {
+            struct ElementVisitor : Ls... { using Ls::operator()...; };
+            std::visit(ElementVisitor{ls...}, element->data);
+        }
     };
+    
+    using ScopeMap = std::unordered_map<ScopeId, std::shared_ptr<ScopeImpl>>;
 
-    using ScopeTemplate = std::vector<std::pair<std::string, Element>>;
+    struct ScopeTemplate {
+        std::vector<std::pair<std::string, Element>> elements;
+        std::vector<std::uint32_t> hashes;
+        std::vector<ElementIndex> table;
+        
+        // Open addressing table with linear probing. Built once after parsing, so lookups never allocate
+        //
+        void buildKeyTable() {
+            std::size_t capacity = 4;
+            while (capacity < elements.size() * 2) {
+                capacity *= 2;
+            }
+            
+            hashes.resize(elements.size());
+            table.assign(capacity, INVALID_ELEMENT_INDEX);
+            
+            for (ElementIndex i = 0; i < elements.size(); i++) {
+                hashes[i] = getNameHash(elements[i].first.data());
+                std::size_t slot = hashes[i] & (capacity - 1);
+                while (table[slot] != INVALID_ELEMENT_INDEX) {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                table[slot] = i;
+            }
+        }
+        
+        ElementIndex findElement(const char *name) const {
+            if (table.empty() == false) {
+                const std::uint32_t hash = getNameHash(name);
+                std::size_t slot = hash & (table.size() - 1);
+                
+                while (table[slot] != INVALID_ELEMENT_INDEX) {
+                    const ElementIndex index = table[slot];
+                    if (hashes[index] == hash && elements[index].first == name) {
+                        return index;
+                    }
+                    slot = (slot + 1) & (table.size() - 1);
+                }
+            }
+            
+            return INVALID_ELEMENT_INDEX;
+        }
+    };
+    
     using TemplateArray = std::vector<std::pair<std::string, ScopeTemplate>>;
 }
 
 namespace dh {
     class ScopeImpl : public Scope {
     public:
-        ScopeImpl(foundation::LoggerInterface &logger, ScopeId scopeId, TemplateIndex templateIndex, const TemplateArray &scopeTemplates, MemoryQueue &queue);
+        ScopeImpl(foundation::LoggerInterface &logger, ScopeId scopeId, TemplateIndex templateIndex, const TemplateArray &scopeTemplates, ScopeMap &scopes, ScopeId &lastItemId, MemoryQueue &queue);
         ~ScopeImpl() = default;
         
         auto getId() const -> ScopeId override { return _id; }
+        auto key(const char *name) const -> Key override;
+        
+        void setBool(const char *name, bool value) override { _setValue(_findElement(name, "setValue"), value); }
+        void setNumber(const char *name, double value) override { _setValue(_findElement(name, "setValue"), value); }
+        void setInteger(const char *name, int value) override { _setValue(_findElement(name, "setValue"), value); }
+        void setString(const char *name, const std::string &value) override { _setValue(_findElement(name, "setValue"), value); }
+        void setVector2f(const char *name, const math::vector2f &value) override { _setValue(_findElement(name, "setValue"), value); }
+        void setVector3f(const char *name, const math::vector3f &value) override { _setValue(_findElement(name, "setValue"), value); }
+        
+        void setBool(Key key, bool value) override { _setValue(_checkKey(key, "setValue"), value); }
+        void setNumber(Key key, double value) override { _setValue(_checkKey(key, "setValue"), value); }
+        void setInteger(Key key, int value) override { _setValue(_checkKey(key, "setValue"), value); }
+        void setString(Key key, const std::string &value) override { _setValue(_checkKey(key, "setValue"), value); }
+        void setVector2f(Key key, const math::vector2f &value) override { _setValue(_checkKey(key, "setValue"), value); }
+        void setVector3f(Key key, const math::vector3f &value) override { _setValue(_checkKey(key, "setValue"), value); }
+        
+        auto getBool(const char *name) const -> bool override { return _getValue<bool>(_findElement(name, "getValue")); }
+        auto getInteger(const char *name) const -> int override { return _getValue<int>(_findElement(name, "getValue")); }
+        auto getNumber(const char *name) const -> double override { return _getValue<double>(_findElement(name, "getValue")); }
+        auto getString(const char *name) const -> const std::string & override { return _getValue<std::string>(_findElement(name, "getValue")); }
+        auto getVector2f(const char *name) const -> const math::vector2f & override { return _getValue<math::vector2f>(_findElement(name, "getValue")); }
+        auto getVector3f(const char *name) const -> const math::vector3f & override { return _getValue<math::vector3f>(_findElement(name, "getValue")); }
+        
+        auto getBool(Key key) const -> bool override { return _getValue<bool>(_checkKey(key, "getValue")); }
+        auto getInteger(Key key) const -> int override { return _getValue<int>(_checkKey(key, "getValue")); }
+        auto getNumber(Key key) const -> double override { return _getValue<double>(_checkKey(key, "getValue")); }
+        auto getString(Key key) const -> const std::string & override { return _getValue<std::string>(_checkKey(key, "getValue")); }
+        auto getVector2f(Key key) const -> const math::vector2f & override { return _getValue<math::vector2f>(_checkKey(key, "getValue")); }
+        auto getVector3f(Key key) const -> const math::vector3f & override { return _getValue<math::vector3f>(_checkKey(key, "getValue")); }
         
-        void setBool(const char *name, bool value) override { _setValue(name, value); }
-        void setNumber(const char *name, double value) override { _setValue(name, value); }
-        void setInteger(const char *name, int value) override { _setValue(name, value); }
-        void setString(const char *name, const std::string &value) override { _setValue(name, value); }
-        void setVector2f(const char *name, const math::vector2f &value) override { _setValue(name, value); }
-        void setVector3f(const char *name, const math::vector3f &value) override { _setValue(name, value); }
-        
-        auto getBool(const char *name) const -> bool override { return _getValue<bool>(name); }
-        auto getInteger(const char *name) const -> int override { return _getValue<int>(name); }
-        auto getNumber(const char *name) const -> double override { return _getValue<double>(name); }
-        auto getString(const char *name) const -> const std::string & override { return _getValue<std::string>(name); }
-        auto getVector2f(const char *name) const -> const math::vector2f & override { return _getValue<math::vector2f>(name); }
-        auto getVector3f(const char *name) const -> const math::vector3f & override { return _getValue<math::vector3f>(name); }
-        
-        void onBoolChanged(EventToken &h, const char *name, std::function<void(const bool &)> &&f) override { _setOnChangedHandler(h, name, std::move(f)); }
-        void onIntegerChanged(EventToken &h, const char *name, std::function<void(const int &)> &&f) override { _setOnChangedHandler(h, name, std::move(f)); }
-        void onNumberChanged(EventToken &h, const char *name, std::function<void(const double &)> &&f) override { _setOnChangedHandler(h, name, std::move(f)); }
-        void onStringChanged(EventToken &h, const char *name, std::function<void(const std::string &)> &&f) override { _setOnChangedHandler(h, name, std::move(f)); }
-        void onVector2fChanged(EventToken &h, const char *name, std::function<void(const math::vector2f &)> &&f) override { _setOnChangedHandler(h, name, std::move(f)); }
-        void onVector3fChanged(EventToken &h, const char *name, std::function<void(const math::vector3f &)> &&f) override { _setOnChangedHandler(h, name, std::move(f)); }
-        
-        void onItemAdded(EventToken &handler, const char *arrayName, std::function<void(const ScopePtr &)> &&f) override;
-        void onItemRemoved(EventToken &handler, const char *arrayName, std::function<void(ScopeId)> &&f) override;
-        
-        void removeOnChangedHandler(const char *name, EventToken handler);
-        void removeOnItemAddedHandler(const char *arrayName, EventToken handler);
-        void removeOnItemRemovedHandler(const char *arrayName, EventToken handler);
-        
-        auto addItem(const char *arrayName, std::function<void(WriteAccessor&)> &&initializer) -> ScopePtr override;
+        void onBoolChanged(EventToken &h, const char *name, util::callback<void(const bool &)> &&f) override { _setOnChangedHandler(h, name, std::move(f)); }
+        void onIntegerChanged(EventToken &h, const char *name, util::callback<void(const int &)> &&f) override { _setOnChangedHandler(h, name, std::move(f)); }
+        void onNumberChanged(EventToken &h, const char *name, util::callback<void(const double &)> &&f) override { _setOnChangedHandler(h, name, std::move(f)); }
+        void onStringChanged(EventToken &h, const char *name, util::callback<void(const std::string &)> &&f) override { _setOnChangedHandler(h, name, std::move(f)); }
+        void onVector2fChanged(EventToken &h, const char *name, util::callback<void(const math::vector2f &)> &&f) override { _setOnChangedHandler(h, name, std::move(f)); }
+        void onVector3fChanged(EventToken &h, const char *name, util::callback<void(const math::vector3f &)> &&f) override { _setOnChangedHandler(h, name, std::move(f)); }
+        
+        void onItemAdded(EventToken &handler, const char *arrayName, util::callback<void(const ScopePtr &)> &&f) override;
+        void onItemRemoved(EventToken &handler, const char *arrayName, util::callback<void(ScopeId)> &&f) override;
+        
+        void removeHandler(EventToken handler) override;
+        
+        auto addItem(const char *arrayName, util::callback<void(WriteAccessor&)> &&initializer) -> ScopePtr override;
         void removeItem(const char *arrayName, const ScopePtr &scope) override;
         
         TemplateIndex getTemplateIndex() const { return _scopeTemplateIndex; }
-        Element *getElementAt(ElementIndex index) { return index < _elements.size() ? &_elements[index].second : nullptr; }
+        Element *getElementAt(ElementIndex index) { return index < _elements.size() ? &_elements[index] : nullptr; }
+        const Element *getElementAt(ElementIndex index) const { return index < _elements.size() ? &_elements[index] : nullptr; }
+        std::size_t getElementCount() const { return _elements.size(); }
         void applyChanges(const std::uint8_t *data, std::size_t length);
         
     private:
-        template<typename T> void _setOnChangedHandler(EventToken &handler, const char *name, std::function<void(const T &)> &&f);
-        template<typename T> void _setValue(const char *name, const T &value);
-        template<typename T> const T &_getValue(const char *name) const;
-        void _setValue(const char *name, const std::string &value);
+        ElementIndex _findElement(const char *name, const char *method) const;
+        ElementIndex _checkKey(Key key, const char *method) const;
+        const char *_getElementName(ElementIndex index) const { return _scopeTemplates[_scopeTemplateIndex].second.elements[index].first.data(); }
+        
+        template<typename T> void _setOnChangedHandler(EventToken &handler, const char *name, util::callback<void(const T &)> &&f);
+        template<typename T> void _setValue(ElementIndex index, const T &value);
+        template<typename T> const T &_getValue(ElementIndex index) const;
+        void _setValue(ElementIndex index, const std::string &value);
         
         const ScopeId _id;
         const TemplateIndex _scopeTemplateIndex;
         const TemplateArray &_scopeTemplates;
         
         foundation::LoggerInterface &_logger;
+        ScopeMap &_scopes;
+        ScopeId &_lastItemId;
         MemoryQueue &_queue;
-        std::vector<std::pair<std::string, Element>> _elements;
+        std::vector<Element> _elements;
     };
 }
 
 namespace dh {
-    ScopeImpl::ScopeImpl(foundation::LoggerInterface &logger, ScopeId scopeId, TemplateIndex templateIndex, const TemplateArray &scopeTemplates, MemoryQueue &queue)
+    ScopeImpl::ScopeImpl(foundation::LoggerInterface &logger, ScopeId scopeId, TemplateIndex templateIndex, const TemplateArray &scopeTemplates, ScopeMap &scopes, ScopeId &lastItemId, MemoryQueue &queue)
     : _logger(logger)
     , _id(scopeId)
     , _scopeTemplateIndex(templateIndex)
     , _scopeTemplates(scopeTemplates)
+    , _scopes(scopes)
+    , _lastItemId(lastItemId)
     , _queue(queue)
-    , _elements(scopeTemplates[templateIndex].second)
-    {}
-    
-    void ScopeImpl::onItemAdded(EventToken &handler, const char *arrayName, std::function<void(const ScopePtr &)> &&f) {
-        for (auto &element : _elements) {
-            if (element.first == arrayName) {
-                if (Array *array = std::get_if<Array>(&element.second.data)) {
-                    handler = getNextEventToken();
-                    array->onAddedHandlers.emplace_back(std::make_pair(handler, std::move(f)));
-                }
-                else {
-                    _logger.logError("[ScopeImpl::onItemAdded] '%s' is not an array\n", arrayName);
-                }
-                
-                return;
-            }
+    {
+        const ScopeTemplate &scopeTemplate = scopeTemplates[templateIndex].second;
+        _elements.reserve(scopeTemplate.elements.size());
+        
+        for (const auto &element : scopeTemplate.elements) {
+            _elements.emplace_back(element.second);
+        }
+    }
+    
+    Key ScopeImpl::key(const char *name) const {
+        const ElementIndex index = _scopeTemplates[_scopeTemplateIndex].second.findElement(name);
+        if (index == INVALID_ELEMENT_INDEX) {
+            _logger.logError("[ScopeImpl::key] Element '%s' not found\n", name);
+            return Key{};
         }
         
-        _logger.logError("[ScopeImpl::onItemAdded] Array '%s' not found\n", arrayName);
+        return Key{_scopeTemplateIndex, index};
     }
     
-    void ScopeImpl::onItemRemoved(EventToken &handler, const char *arrayName, std::function<void(ScopeId)> &&f) {
-        for (auto &element : _elements) {
-            if (element.first == arrayName) {
-                if (Array *array = std::get_if<Array>(&element.second.data)) {
-                    handler = getNextEventToken();
-                    array->onRemoveHandlers.emplace_back(std::make_pair(handler, std::move(f)));
-                }
-                else {
-                    _logger.logError("[ScopeImpl::onItemRemoved] '%s' is not an array\n", arrayName);
-                }
-                
-                return;
+    void ScopeImpl::onItemAdded(EventToken &handler, const char *arrayName, util::callback<void(const ScopePtr &)> &&f) {
+        const ElementIndex index = _findElement(arrayName, "onItemAdded");
+        if (index != INVALID_ELEMENT_INDEX) {
+            if (Array *array = std::get_if<Array>(&_elements[index].data)) {
+                const std::uint32_t handle = array->onAddedHandlers.add(std::move(f));
+                handler = handle ? handle << 8 | index : INVALID_EVENT_TOKEN;
+            }
+            else {
+                _logger.logError("[ScopeImpl::onItemAdded] '%s' is not an array\n", arrayName);
             }
         }
-        
-        _logger.logError("[ScopeImpl::onItemRemoved] Array '%s' not found\n", arrayName);
     }
     
-    ScopePtr ScopeImpl::addItem(const char *arrayName, std::function<void(WriteAccessor&)> &&initializer) {
-        for (ElementIndex i = 0; i <_elements.size(); i++) {
-            if (_elements[i].first == arrayName) {
-                std::shared_ptr<ScopeImpl> result = nullptr;
-                
-                if (Array *array = std::get_if<Array>(&_elements[i].second.data)) {
-                    ScopeId newId = getNextScopeId();
-                    // posibly error: _scopeTemplateIndex, should be index from array TODO: unittests
-                    result = std::make_shared<ScopeImpl>(_logger, newId, _scopeTemplateIndex, _scopeTemplates, _queue);
-                    initializer(*result);
-                    array->items.emplace(newId, result);
-                    _queue.enqueue(MsgHeader{MSG_TYPE_ITEM_ADDED, getCurrentTimeStamp(), Location{i, _id}}, &newId, sizeof(newId));
-                }
-                else {
-                    _logger.logError("[ScopeImpl::addItem] '%s' is not an array\n", arrayName);
+    void ScopeImpl::onItemRemoved(EventToken &handler, const char *arrayName, util::callback<void(ScopeId)> &&f) {
+        const ElementIndex index = _findElement(arrayName, "onItemRemoved");
+        if (index != INVALID_ELEMENT_INDEX) {
+            if (Array *array = std::get_if<Array>(&_elements[index].data)) {
+                const std::uint32_t handle = array->onRemoveHandlers.add(std::move(f));
+                handler = handle ? handle << 8 | index | TOKEN_REMOVED_TABLE_BIT : INVALID_EVENT_TOKEN;
+            }
+            else {
+                _logger.logError("[ScopeImpl::onItemRemoved] '%s' is not an array\n", arrayName);
+            }
+        }
+    }
+    
+    void ScopeImpl::removeHandler(EventToken handler) {
+        const ElementIndex index = ElementIndex(handler & 0xff);
+        const std::uint32_t handle = (handler & ~TOKEN_REMOVED_TABLE_BIT) >> 8;
+        bool removed = false;
+        
+        if (index < _elements.size()) {
+            Element::visit(&_elements[index],
+                [handle, &removed](auto &v) {
+                    removed = v.onChangedHandlers.remove(handle);
+                },
+                [handler, handle, &removed](Array &array) {
+                    removed = handler & TOKEN_REMOVED_TABLE_BIT ? array.onRemoveHandlers.remove(handle) : array.onAddedHandlers.remove(handle);
                 }
-                
-                return result;
+            );
+        }
+        if (removed == false) {
+            _logger.logError("[ScopeImpl::removeHandler] Invalid token = %u\n", handler);
+        }
+    }
+    
+    ScopePtr ScopeImpl::addItem(const char *arrayName, util::callback<void(WriteAccessor&)> &&initializer) {
+        const ElementIndex index = _findElement(arrayName, "addItem");
+        std::shared_ptr<ScopeImpl> result = nullptr;
+        
+        if (index != INVALID_ELEMENT_INDEX) {
+            if (Array *array = std::get_if<Array>(&_elements[index].data)) {
+                ScopeId newId = _lastItemId = (_lastItemId + 1) & 0xffffff;
+                result = std::make_shared<ScopeImpl>(_logger, newId, array->scopeTemplateIndex, _scopeTemplates, _scopes, _lastItemId, _queue);
+                _scopes.emplace(newId, result);
+                initializer(*result);
+                array->items.emplace(newId, result);
+                _queue.enqueue(MsgHeader{MSG_TYPE_ITEM_ADDED, getCurrentTimeStamp(), Location{index, _id}}, &newId, sizeof(newId));
+            }
+            else {
+                _logger.logError("[ScopeImpl::addItem] '%s' is not an array\n", arrayName);
             }
         }
         
-        _logger.logError("[ScopeImpl::addItem] Array '%s' not found\n", arrayName);
-        return nullptr;
+        return result;
     }
     
     void ScopeImpl::removeItem(const char *arrayName, const ScopePtr &scope) {
-        for (ElementIndex i = 0; i <_elements.size(); i++) {
-            if (_elements[i].first == arrayName) {
-                if (const Array *array = std::get_if<Array>(&_elements[i].second.data)) {
-                    ScopeId id = scope->getId();
-                    _queue.enqueue(MsgHeader{MSG_TYPE_ITEM_REMOVED, getCurrentTimeStamp(), Location{i, _id}}, &id, sizeof(id));
-                }
-                else {
-                    _logger.logError("[ScopeImpl::removeItem] '%s' is not an array\n", arrayName);
-                }
-                
-                return;
+        const ElementIndex index = _findElement(arrayName, "removeItem");
+        if (index != INVALID_ELEMENT_INDEX) {
+            if (std::holds_alternative<Array>(_elements[index].data)) {
+                ScopeId id = scope->getId();
+                _queue.enqueue(MsgHeader{MSG_TYPE_ITEM_REMOVED, getCurrentTimeStamp(), Location{index, _id}}, &id, sizeof(id));
+            }
+            else {
+                _logger.logError("[ScopeImpl::removeItem] '%s' is not an array\n", arrayName);
             }
         }
-        
-        _logger.logError("[ScopeImpl::removeItem] Array '%s' not found\n", arrayName);
     }
     
     void ScopeImpl::applyChanges(const std::uint8_t *data, std::size_t length) {
@@ -292,7 +580,7 @@ namespace dh {
             const std::uint8_t *valueptr = data + offset + sizeof(ElementIndex);
             offset += sizeof(ElementIndex);
             
-            Element::visit(&_elements[index].second,
+            Element::visit(&_elements[index],
                 [valueptr, &offset](auto &v) {
                     v.value = *(decltype(v.value) *)(valueptr);
                     offset += sizeof(v.value);
@@ -311,74 +599,70 @@ namespace dh {
         }
     }
     
-    template<typename T> void ScopeImpl::_setOnChangedHandler(EventToken &handler, const char *name, std::function<void(const T &)> &&f) {
-        for (auto &element : _elements) {
-            if (element.first == name) {
-                if (Value<T> *ptr = std::get_if<Value<T>>(&element.second.data)) {
-                    handler = getNextEventToken();
-                    ptr->onChangedHandlers.emplace_back(std::make_pair(handler, std::move(f)));
-                }
-                else {
-                    _logger.logError("[ScopeImpl::setOnChangedHandler] '%s' is not a value\n", name);
-                }
-                
-                return;
+    ElementIndex ScopeImpl::_findElement(const char *name, const char *method) const {
+        const ElementIndex index = _scopeTemplates[_scopeTemplateIndex].second.findElement(name);
+        if (index == INVALID_ELEMENT_INDEX) {
+            _logger.logError("[ScopeImpl::%s] Element '%s' not found\n", method, name);
+        }
+        return index;
+    }
+    
+    ElementIndex ScopeImpl::_checkKey(Key key, const char *method) const {
+        if (key.templateIndex != _scopeTemplateIndex || key.elementIndex >= _elements.size()) {
+            _logger.logError("[ScopeImpl::%s] Key {%d, %d} doesn't belong to scope template '%s'\n", method, int(key.templateIndex), int(key.elementIndex), _scopeTemplates[_scopeTemplateIndex].first.data());
+            return INVALID_ELEMENT_INDEX;
+        }
+        return key.elementIndex;
+    }
+    
+    template<typename T> void ScopeImpl::_setOnChangedHandler(EventToken &handler, const char *name, util::callback<void(const T &)> &&f) {
+        const ElementIndex index = _findElement(name, "setOnChangedHandler");
+        if (index != INVALID_ELEMENT_INDEX) {
+            if (Value<T> *ptr = std::get_if<Value<T>>(&_elements[index].data)) {
+                const std::uint32_t handle = ptr->onChangedHandlers.add(std::move(f));
+                handler = handle ? handle << 8 | index : INVALID_EVENT_TOKEN;
+            }
+            else {
+                _logger.logError("[ScopeImpl::setOnChangedHandler] '%s' is not a value\n", name);
             }
         }
-        
-        _logger.logError("[ScopeImpl::setOnChangedHandler] Value '%s' not found\n", name);
     }
     
-    template<typename T> void ScopeImpl::_setValue(const char *name, const T &value) {
-        for (ElementIndex i = 0; i <_elements.size(); i++) {
-            if (_elements[i].first == name) {
-                if (std::holds_alternative<Value<T>>(_elements[i].second.data)) {
-                    _queue.enqueue(MsgHeader{MSG_TYPE_VALUE_CHANGED, getCurrentTimeStamp(), Location{i, _id}}, &value, sizeof(T));
-                }
-                else {
-                    _logger.logError("[ScopeImpl::setValue] '%s' is not a value\n", name);
-                }
-                
-                return;
+    template<typename T> void ScopeImpl::_setValue(ElementIndex index, const T &value) {
+        if (index != INVALID_ELEMENT_INDEX) {
+            if (std::holds_alternative<Value<T>>(_elements[index].data)) {
+                _queue.enqueue(MsgHeader{MSG_TYPE_VALUE_CHANGED, getCurrentTimeStamp(), Location{index, _id}}, &value, sizeof(T));
+            }
+            else {
+                _logger.logError("[ScopeImpl::setValue] '%s' is not a value\n", _getElementName(index));
             }
         }
-
-        _logger.logError("[ScopeImpl::setValue] Value '%s' not found\n", name);
     }
 
-    void ScopeImpl::_setValue(const char *name, const std::string &value) {
-        for (ElementIndex i = 0; i <_elements.size(); i++) {
-            if (_elements[i].first == name) {
-                if (std::holds_alternative<Value<std::string>>(_elements[i].second.data)) {
-                    *(std::uint16_t *)(g_stringBuffer) = value.length();
-                    memcpy(g_stringBuffer + sizeof(std::uint16_t), value.data(), std::min(value.length(), MAX_STRING_LENGTH));
-                    _queue.enqueue(MsgHeader{MSG_TYPE_VALUE_CHANGED, getCurrentTimeStamp(), Location{i, _id}}, g_stringBuffer, sizeof(std::uint16_t) + value.length());
-                }
-                else {
-                    _logger.logError("[ScopeImpl::setValue] '%s' is not a value\n", name);
-                }
-                
-                return;
+    void ScopeImpl::_setValue(ElementIndex index, const std::string &value) {
+        if (index != INVALID_ELEMENT_INDEX) {
+            if (std::holds_alternative<Value<std::string>>(_elements[index].data)) {
+                const std::size_t length = std::min(value.length(), MAX_STRING_LENGTH);
+                *(std::uint16_t *)(g_stringBuffer) = std::uint16_t(length);
+                memcpy(g_stringBuffer + sizeof(std::uint16_t), value.data(), length);
+                _queue.enqueue(MsgHeader{MSG_TYPE_VALUE_CHANGED, getCurrentTimeStamp(), Location{index, _id}}, g_stringBuffer, sizeof(std::uint16_t) + length);
+            }
+            else {
+                _logger.logError("[ScopeImpl::setValue] '%s' is not a value\n", _getElementName(index));
             }
         }
-        
-        _logger.logError("[ScopeImpl::setValue] Value '%s' not found\n", name);
     }
 
-    template<typename T> const T &ScopeImpl::_getValue(const char *name) const {
-        for (auto &element : _elements) {
-            if (element.first == name) {
-                if (const Value<T> *ptr = std::get_if<Value<T>>(&element.second.data)) {
-                    return ptr->value;
-                }
-                else {
-                    _logger.logError("[ScopeImpl::getValue] '%s' is not a value\n", name);
-                    return g_dummy<T>;
-                }
+    template<typename T> const T &ScopeImpl::_getValue(ElementIndex index) const {
+        if (index != INVALID_ELEMENT_INDEX) {
+            if (const Value<T> *ptr = std::get_if<Value<T>>(&_elements[index].data)) {
+                return ptr->value;
+            }
+            else {
+                _logger.logError("[ScopeImpl::getValue] '%s' is not a value\n", _getElementName(index));
             }
         }
         
-        _logger.logError("[ScopeImpl::getValue] Value '%s' not found\n", name);
         return g_dummy<T>;
     }
 
@@ -396,12 +680,40 @@ namespace dh {
         std::shared_ptr<Scope> getScope(ScopeId id) override;
         std::shared_ptr<Scope> getRootScope(const char *rootScopeName) override;
         
+        auto makeSnapshot() const -> std::vector<std::uint8_t> override;
+        auto makeDelta(const std::uint8_t *base, std::size_t length) const -> std::vector<std::uint8_t> override;
+        bool applyDelta(const std::uint8_t *data, std::size_t length) override;
+        bool restoreSnapshot(const std::uint8_t *data, std::size_t length) override;
+        
     private:
+        struct SnapshotRecord {
+            TemplateIndex templateIndex;
+            const std::uint8_t *begin;     // scope id
+            const std::uint8_t *values;    // element values in template order
+            const std::uint8_t *end;       // end of the scope with all nested items
+        };
+        
+        using SnapshotRecords = std::unordered_map<ScopeId, SnapshotRecord>;
+        
+        void _writeScope(std::vector<std::uint8_t> &output, const ScopeImpl &scope) const;
+        bool _readElement(ByteReader &reader, const Element &element, const std::uint8_t *&value, std::vector<ScopeId> &items) const;
+        bool _parseScope(ByteReader &reader, SnapshotRecords &records) const;
+        bool _parseSnapshot(const std::uint8_t *data, std::size_t length, std::uint64_t &timestamp, std::vector<ScopeId> &roots, SnapshotRecords &records) const;
+        void _diffScope(std::vector<std::uint8_t> &output, ScopeId id, const SnapshotRecords &from, const SnapshotRecords &to) const;
+        auto _makeDelta(const std::uint8_t *from, std::size_t fromLength, const std::uint8_t *to, std::size_t toLength) const -> std::vector<std::uint8_t>;
+        auto _createScope(ByteReader &reader, std::vector<std::shared_ptr<ScopeImpl>> &created) -> std::shared_ptr<ScopeImpl>;
+        void _registerScope(const std::shared_ptr<ScopeImpl> &scope);
+        void _unregisterScope(const ScopeImpl &scope);
+        
         const foundation::LoggerInterfacePtr _logger;
         std::vector<std::pair<std::string, ScopeTemplate>> _scopeTemplates;
         std::unordered_map<ScopeId, std::shared_ptr<ScopeImpl>> _scopes;
+        std::unordered_map<ScopeId, std::shared_ptr<ScopeImpl>> _pendingItems; // items from applyDelta, inserted on update
         std::unordered_map<std::string, std::shared_ptr<ScopeImpl>> _roots;
+        std::uint32_t _layoutHash = 0;
         
+        // Item ids are counted per datahub, so equal sequences of changes give equal ids in every instance
+        ScopeId _lastItemId = ITEM_ID_BASE;
         MemoryQueue _queue;
     };
     
@@ -431,31 +743,31 @@ namespace dh {
                     math::scalar valueFloat[3] = {};
                     int valueInt = 0;
                     
-                    if (result.size() < MAX_ELEMENTS_PER_SCOPE) {
+                    if (result.elements.size() < MAX_ELEMENTS_PER_SCOPE) {
                         if (input >> util::sequence(":") >> type) {
                             if (type == "array" && input >> util::braced(valueString, '{', '}')) {
                                 if (parseScope(logger, name + "." + elementName, valueString, templates)) {
                                     TemplateIndex scopeTemplateIndex = static_cast<TemplateIndex>(templates.size() - 1);
-                                    result.emplace_back(std::make_pair(elementName, Element(Array(scopeTemplateIndex))));
+                                    result.elements.emplace_back(std::make_pair(elementName, Element(Array(scopeTemplateIndex))));
                                 }
                             }
                             else if (type == "string" && input >> util::sequence("=") >> util::braced(valueString, '"', '"')) {
-                                result.emplace_back(std::make_pair(elementName, Element(valueString.data())));
+                                result.elements.emplace_back(std::make_pair(elementName, Element(valueString.data())));
                             }
                             else if (type == "integer" && input >> util::sequence("=") >> valueInt) {
-                                result.emplace_back(std::make_pair(elementName, Element(valueInt)));
+                                result.elements.emplace_back(std::make_pair(elementName, Element(valueInt)));
                             }
                             else if (type == "number" && input >> util::sequence("=") >> valueFloat[0]) {
-                                result.emplace_back(std::make_pair(elementName, Element(valueFloat[0])));
+                                result.elements.emplace_back(std::make_pair(elementName, Element(valueFloat[0])));
                             }
                             else if (type == "vector2f" && input >> util::sequence("=") >> valueFloat[0] >> valueFloat[1]) {
-                                result.emplace_back(std::make_pair(elementName, Element(math::vector2f(valueFloat[0], valueFloat[1]))));
+                                result.elements.emplace_back(std::make_pair(elementName, Element(math::vector2f(valueFloat[0], valueFloat[1]))));
                             }
                             else if (type == "vector3f" && input >> util::sequence("=") >> valueFloat[0] >> valueFloat[1] >> valueFloat[2]) {
-                                result.emplace_back(std::make_pair(elementName, Element(math::vector3f(valueFloat[0], valueFloat[1], valueFloat[2]))));
+                                result.elements.emplace_back(std::make_pair(elementName, Element(math::vector3f(valueFloat[0], valueFloat[1], valueFloat[2]))));
                             }
                             else if (type == "bool" && input >> util::sequence("=") >> valueString) {
-                                result.emplace_back(std::make_pair(elementName, Element(valueString == "true")));
+                                result.elements.emplace_back(std::make_pair(elementName, Element(valueString == "true")));
                             }
                             else {
                                 logger.logError("[DataHubImpl::initialize] Invalid initialisation for '%s' in '%s'\n", elementName.data(), name.data());
@@ -478,6 +790,7 @@ namespace dh {
                     return false;
                 }
 
+                result.buildKeyTable();
                 templates.emplace_back(name, std::move(result));
                 return true;
             }
@@ -487,6 +800,8 @@ namespace dh {
         std::string scopeText;
 
         while (input >> name) {
+            scopeText.clear();
+            
             if (input >> util::braced(scopeText, '{', '}')) {
                 if (fn::parseScope(*_logger, name, scopeText, _scopeTemplates) == false) {
                     _scopeTemplates.clear();
@@ -499,10 +814,20 @@ namespace dh {
             }
         }
         
+        _layoutHash = getNameHash("");
+        
         for (TemplateIndex i = 0; i < _scopeTemplates.size(); i++) {
+            _layoutHash = (_layoutHash ^ getNameHash(_scopeTemplates[i].first.data())) * 16777619u;
+            
+            for (const auto &element : _scopeTemplates[i].second.elements) {
+                _layoutHash = (_layoutHash ^ getNameHash(element.first.data())) * 16777619u;
+                _layoutHash = (_layoutHash ^ std::uint32_t(element.second.data.index())) * 16777619u;
+            }
+            
+            // Root ids depend only on description, so snapshots are portable between datahub instances
             if (_scopeTemplates[i].first.find('.') == std::string::npos) {
-                ScopeId id = getNextScopeId();
-                std::shared_ptr<ScopeImpl> scope = std::make_shared<ScopeImpl>(*_logger, id, i, _scopeTemplates, _queue);
+                ScopeId id = ScopeId(i) + 1;
+                std::shared_ptr<ScopeImpl> scope = std::make_shared<ScopeImpl>(*_logger, id, i, _scopeTemplates, _scopes, _lastItemId, _queue);
                 _scopes.emplace(id, scope);
                 _roots.emplace(_scopeTemplates[i].first, scope);
             }
@@ -515,10 +840,11 @@ namespace dh {
     
     void DataHubImpl::update(float dtSec) {
         MsgHeader header {0};
-        std::unique_ptr<std::uint8_t[]> data = nullptr;
+        foundation::PoolBytes data = nullptr;
         std::size_t length = 0;
         
-        if (_queue.dequeue(header, data, length)) {
+        // Messages enqueued by handlers are left for the next update
+        for (std::size_t pending = _queue.size(); pending && _queue.dequeue(header, data, length); pending--) {
             auto scope = _scopes.find(header.location.scopeId);
             if (scope != _scopes.end()) {
                 if (Element *element = scope->second->getElementAt(header.location.index)) {
@@ -526,17 +852,13 @@ namespace dh {
                         Element::visit(element,
                             [&data](auto &v) {
                                 v.value = *(decltype(v.value) *)data.get();
-                                for (auto &handler : v.onChangedHandlers) {
-                                    handler.second(v.value);
-                                }
+                                v.onChangedHandlers.call(v.value);
                             },
                             [&data](Value<std::string> &v) {
                                 std::size_t length = *(std::uint16_t *)data.get();
                                 const char *str = (const char *)(data.get() + sizeof(std::uint16_t));
                                 v.value = std::string(str, length);
-                                for (auto &handler : v.onChangedHandlers) {
-                                    handler.second(v.value);
-                                }
+                                v.onChangedHandlers.call(v.value);
                             },
                             [this](Array &) {
                                 _logger->logError("[DataHubImpl::update] Received MSG_TYPE_VALUE_CHANGED for array\n");
@@ -546,12 +868,17 @@ namespace dh {
                     else if (header.cmd == MSG_TYPE_ITEM_ADDED) {
                         if (Array *array = std::get_if<Array>(&element->data)) {
                             const ScopeId itemId = *reinterpret_cast<ScopeId *>(data.get());
-                            const auto &index = _scopes.find(itemId);
+                            const auto pending = _pendingItems.find(itemId);
                             
+                            if (pending != _pendingItems.end()) {
+                                array->items.emplace(itemId, pending->second);
+                                _registerScope(pending->second);
+                                _pendingItems.erase(pending);
+                            }
+                            
+                            const auto &index = _scopes.find(itemId);
                             if (index != _scopes.end()) {
-                                for (auto &handler : array->onAddedHandlers) {
-                                    handler.second(index->second);
-                                }
+                                array->onAddedHandlers.call(ScopePtr(index->second));
                             }
                             else {
                                 _logger->logError("[DataHubImpl::update] Received MSG_TYPE_ITEM_ADDED for unknown item with id = %d\n", int(itemId));
@@ -564,10 +891,13 @@ namespace dh {
                     else if (header.cmd == MSG_TYPE_ITEM_REMOVED) {
                         if (Array *array = std::get_if<Array>(&element->data)) {
                             ScopeId itemId = *reinterpret_cast<ScopeId *>(data.get());
-                            if (array->items.erase(itemId) == 1) {
-                                for (auto &handler : array->onRemoveHandlers) {
-                                    handler.second(itemId);
-                                }
+                            auto item = array->items.find(itemId);
+                            
+                            if (item != array->items.end()) {
+                                _unregisterScope(*item->second);
+                                array->items.erase(item);
+                                
+                                array->onRemoveHandlers.call(itemId);
                             }
                             else {
                                 _logger->logError("[DataHubImpl::update] Received MSG_TYPE_ITEM_REMOVED for unknown item with id = %d\n", int(itemId));
@@ -609,7 +939,522 @@ namespace dh {
         return nullptr;
     }
 
+    std::vector<std::uint8_t> DataHubImpl::makeSnapshot() const {
+        std::vector<std::uint8_t> result;
+        writeData(result, SNAPSHOT_MAGIC);
+        writeData(result, _layoutHash);
+        writeData(result, getCurrentTimeStamp());
+        
+        for (const auto &scopeTemplate : _scopeTemplates) {
+            auto index = _roots.find(scopeTemplate.first);
+            if (index != _roots.end()) {
+                _writeScope(result, *index->second);
+            }
+        }
+        
+        return result;
+    }
+    
+    std::vector<std::uint8_t> DataHubImpl::makeDelta(const std::uint8_t *base, std::size_t length) const {
+        const std::vector<std::uint8_t> current = makeSnapshot();
+        return _makeDelta(base, length, current.data(), current.size());
+    }
+    
+    bool DataHubImpl::applyDelta(const std::uint8_t *data, std::size_t length) {
+        struct Change {
+            MsgHeader header;
+            const std::uint8_t *data;
+            std::size_t length;
+            std::shared_ptr<ScopeImpl> item;
+        };
+        
+        ByteReader reader(data, length);
+        std::uint32_t magic = 0, layoutHash = 0;
+        std::uint64_t timestamp = 0;
+        std::vector<Change> changes;
+        std::vector<std::shared_ptr<ScopeImpl>> created;
+        std::vector<ScopeId> items;
+        
+        if (reader.read(magic) == false || reader.read(layoutHash) == false || reader.read(timestamp) == false || magic != DELTA_MAGIC || layoutHash != _layoutHash) {
+            _logger->logError("[DataHubImpl::applyDelta] Delta is corrupted or made by another datahub\n");
+            return false;
+        }
+        
+        // All changes are validated before anything is applied
+        while (reader.isEof() == false) {
+            Change change {};
+            bool success = reader.read(change.header.cmd) && reader.read(change.header.location);
+            change.header.timestamp = timestamp;
+            change.data = reader.current();
+            
+            if (success) {
+                auto scope = _scopes.find(change.header.location.scopeId);
+                const Element *element = nullptr;
+                
+                if (scope != _scopes.end() && (element = scope->second->getElementAt(change.header.location.index)) != nullptr) {
+                    const bool isArray = std::holds_alternative<Array>(element->data);
+                    const std::uint8_t *value = nullptr;
+                    ScopeId itemId = 0;
+                    
+                    if (change.header.cmd == MSG_TYPE_VALUE_CHANGED && isArray == false) {
+                        success = _readElement(reader, *element, value, items);
+                    }
+                    else if (change.header.cmd == MSG_TYPE_ITEM_ADDED && isArray) {
+                        success = (change.item = _createScope(reader, created)) != nullptr;
+                    }
+                    else if (change.header.cmd == MSG_TYPE_ITEM_REMOVED && isArray) {
+                        success = reader.read(itemId);
+                    }
+                    else {
+                        success = false;
+                    }
+                }
+                else {
+                    success = false;
+                }
+            }
+            if (success == false) {
+                _logger->logError("[DataHubImpl::applyDelta] Delta is corrupted\n");
+                return false;
+            }
+            
+            change.length = reader.current() - change.data;
+            changes.emplace_back(std::move(change));
+        }
+        
+        for (const auto &scope : created) {
+            _lastItemId = std::max(_lastItemId, scope->getId());
+        }
+        for (const Change &change : changes) {
+            if (change.item) {
+                const ScopeId itemId = change.item->getId();
+                _pendingItems.emplace(itemId, change.item);
+                _queue.enqueue(change.header, &itemId, sizeof(itemId));
+            }
+            else {
+                _queue.enqueue(change.header, change.data, change.length);
+            }
+        }
+        
+        return true;
+    }
+    
+    bool DataHubImpl::restoreSnapshot(const std::uint8_t *data, std::size_t length) {
+        const std::vector<std::uint8_t> current = makeSnapshot();
+        const std::vector<std::uint8_t> delta = _makeDelta(current.data(), current.size(), data, length);
+        return delta.empty() == false && applyDelta(delta.data(), delta.size());
+    }
+    
+    // Scope layout: id, template index, element values in template order, then nested items of every array element
+    // Value layout is the same as in MSG_TYPE_VALUE_CHANGED. Array is stored as count and sorted item ids
+    //
+    void DataHubImpl::_writeScope(std::vector<std::uint8_t> &output, const ScopeImpl &scope) const {
+        std::vector<std::vector<std::shared_ptr<ScopeImpl>>> nested;
+        writeData(output, scope.getId());
+        writeData(output, scope.getTemplateIndex());
+        
+        for (ElementIndex i = 0; i < scope.getElementCount(); i++) {
+            Element::visit(scope.getElementAt(i),
+                [&output](const auto &v) {
+                    writeData(output, v.value);
+                },
+                [&output](const Value<std::string> &v) {
+                    const std::uint16_t length = std::uint16_t(std::min(v.value.length(), MAX_STRING_LENGTH));
+                    writeData(output, length);
+                    output.insert(output.end(), v.value.begin(), v.value.begin() + length);
+                },
+                [&output, &nested](const Array &array) {
+                    std::vector<std::shared_ptr<ScopeImpl>> &items = nested.emplace_back();
+                    for (const auto &item : array.items) {
+                        items.emplace_back(item.second);
+                    }
+                    std::sort(items.begin(), items.end(), [](const auto &left, const auto &right) {
+                        return left->getId() < right->getId();
+                    });
+                    
+                    writeData(output, std::uint32_t(items.size()));
+                    for (const auto &item : items) {
+                        writeData(output, item->getId());
+                    }
+                }
+            );
+        }
+        for (const auto &items : nested) {
+            for (const auto &item : items) {
+                _writeScope(output, *item);
+            }
+        }
+    }
+    
+    bool DataHubImpl::_readElement(ByteReader &reader, const Element &element, const std::uint8_t *&value, std::vector<ScopeId> &items) const {
+        bool result = false;
+        value = reader.current();
+        items.clear();
+        
+        Element::visit(&element,
+            [&reader, &result](const auto &v) {
+                result = reader.skip(sizeof(v.value)) != nullptr;
+            },
+            [&reader, &result](const Value<std::string> &) {
+                std::uint16_t length = 0;
+                result = reader.read(length) && length <= MAX_STRING_LENGTH && reader.skip(length) != nullptr;
+            },
+            [&reader, &result, &items](const Array &) {
+                std::uint32_t count = 0;
+                result = reader.read(count);
+                
+                for (std::uint32_t i = 0; result && i < count; i++) {
+                    result = reader.read(items.emplace_back());
+                }
+            }
+        );
+        
+        return result;
+    }
+    
+    bool DataHubImpl::_parseScope(ByteReader &reader, SnapshotRecords &records) const {
+        SnapshotRecord record {0, reader.current()};
+        ScopeId id = 0;
+        std::vector<ScopeId> items, nested;
+        const std::uint8_t *value = nullptr;
+        
+        if (reader.read(id) == false || reader.read(record.templateIndex) == false || record.templateIndex >= _scopeTemplates.size()) {
+            return false;
+        }
+        
+        record.values = reader.current();
+        
+        for (const auto &element : _scopeTemplates[record.templateIndex].second.elements) {
+            if (_readElement(reader, element.second, value, items) == false) {
+                return false;
+            }
+            nested.insert(nested.end(), items.begin(), items.end());
+        }
+        for (ScopeId itemId : nested) {
+            ScopeId nestedId = 0;
+            if (ByteReader(reader).read(nestedId) == false || nestedId != itemId || _parseScope(reader, records) == false) {
+                return false;
+            }
+        }
+        
+        record.end = reader.current();
+        return records.emplace(id, record).second;
+    }
+    
+    bool DataHubImpl::_parseSnapshot(const std::uint8_t *data, std::size_t length, std::uint64_t &timestamp, std::vector<ScopeId> &roots, SnapshotRecords &records) const {
+        ByteReader reader(data, length);
+        std::uint32_t magic = 0, layoutHash = 0;
+        
+        if (reader.read(magic) && reader.read(layoutHash) && reader.read(timestamp) && magic == SNAPSHOT_MAGIC && layoutHash == _layoutHash) {
+            while (reader.isEof() == false) {
+                ScopeId id = 0;
+                if (ByteReader(reader).read(id) == false || _parseScope(reader, records) == false) {
+                    return false;
+                }
+                roots.emplace_back(id);
+            }
+            
+            return true;
+        }
+        
+        return false;
+    }
+    
+    void DataHubImpl::_diffScope(std::vector<std::uint8_t> &output, ScopeId id, const SnapshotRecords &from, const SnapshotRecords &to) const {
+        const SnapshotRecord &toRecord = to.at(id);
+        auto fromRecord = from.find(id);
+        
+        if (fromRecord == from.end() || fromRecord->second.templateIndex != toRecord.templateIndex) {
+            _logger->logError("[DataHubImpl::makeDelta] Scope with id = %d doesn't match\n", int(id));
+            return;
+        }
+        
+        const ScopeTemplate &scopeTemplate = _scopeTemplates[toRecord.templateIndex].second;
+        ByteReader fromReader(fromRecord->second.values, fromRecord->second.end - fromRecord->second.values);
+        ByteReader toReader(toRecord.values, toRecord.end - toRecord.values);
+        std::vector<ScopeId> fromItems, toItems;
+        std::vector<ScopeId> nested;
+        
+        for (ElementIndex i = 0; i < scopeTemplate.elements.size(); i++) {
+            const std::uint8_t *fromValue = nullptr;
+            const std::uint8_t *toValue = nullptr;
+            
+            _readElement(fromReader, scopeTemplate.elements[i].second, fromValue, fromItems);
+            _readElement(toReader, scopeTemplate.elements[i].second, toValue, toItems);
+            
+            const std::size_t fromLength = fromReader.current() - fromValue;
+            const std::size_t toLength = toReader.current() - toValue;
+            const Location location {i, id};
+            
+            if (std::holds_alternative<Array>(scopeTemplate.elements[i].second.data)) {
+                for (ScopeId itemId : fromItems) {
+                    if (std::binary_search(toItems.begin(), toItems.end(), itemId) == false) {
+                        writeData(output, MSG_TYPE_ITEM_REMOVED);
+                        writeData(output, location);
+                        writeData(output, itemId);
+                    }
+                }
+                for (ScopeId itemId : toItems) {
+                    if (std::binary_search(fromItems.begin(), fromItems.end(), itemId)) {
+                        nested.emplace_back(itemId);
+                    }
+                    else {
+                        const SnapshotRecord &item = to.at(itemId);
+                        writeData(output, MSG_TYPE_ITEM_ADDED);
+                        writeData(output, location);
+                        output.insert(output.end(), item.begin, item.end);
+                    }
+                }
+            }
+            else if (fromLength != toLength || memcmp(fromValue, toValue, toLength) != 0) {
+                writeData(output, MSG_TYPE_VALUE_CHANGED);
+                writeData(output, location);
+                output.insert(output.end(), toValue, toValue + toLength);
+            }
+        }
+        for (ScopeId itemId : nested) {
+            _diffScope(output, itemId, from, to);
+        }
+    }
+    
+    // Delta layout: header, then messages of MsgHeader scheme: command, location and payload
+    // Timestamp is stored once per delta. Payload length follows from command and element type
+    //
+    std::vector<std::uint8_t> DataHubImpl::_makeDelta(const std::uint8_t *from, std::size_t fromLength, const std::uint8_t *to, std::size_t toLength) const {
+        std::vector<std::uint8_t> result;
+        std::vector<ScopeId> fromRoots, toRoots;
+        SnapshotRecords fromRecords, toRecords;
+        std::uint64_t fromTimestamp = 0, toTimestamp = 0;
+        
+        if (_parseSnapshot(from, fromLength, fromTimestamp, fromRoots, fromRecords) && _parseSnapshot(to, toLength, toTimestamp, toRoots, toRecords)) {
+            writeData(result, DELTA_MAGIC);
+            writeData(result, _layoutHash);
+            writeData(result, toTimestamp);
+            
+            for (ScopeId id : toRoots) {
+                _diffScope(result, id, fromRecords, toRecords);
+            }
+        }
+        else {
+            _logger->logError("[DataHubImpl::makeDelta] Snapshot is corrupted or made by another datahub\n");
+        }
+        
+        return result;
+    }
+    
+    std::shared_ptr<ScopeImpl> DataHubImpl::_createScope(ByteReader &reader, std::vector<std::shared_ptr<ScopeImpl>> &created) {
+        ScopeId id = 0;
+        TemplateIndex templateIndex = 0;
+        std::vector<ScopeId> items;
+        const std::uint8_t *value = nullptr;
+        
+        if (reader.read(id) == false || reader.read(templateIndex) == false || templateIndex >= _scopeTemplates.size() || _scopes.find(id) != _scopes.end() || _pendingItems.find(id) != _pendingItems.end()) {
+            return nullptr;
+        }
+        
+        std::shared_ptr<ScopeImpl> result = std::make_shared<ScopeImpl>(*_logger, id, templateIndex, _scopeTemplates, _scopes, _lastItemId, _queue);
+        std::vector<Array *> arrays;
+        std::vector<std::vector<ScopeId>> nested;
+        created.emplace_back(result);
+        
+        for (ElementIndex i = 0; i < result->getElementCount(); i++) {
+            Element *element = result->getElementAt(i);
+            if (_readElement(reader, *element, value, items) == false) {
+                return nullptr;
+            }
+            
+            Element::visit(element,
+                [value](auto &v) {
+                    readUnaligned(value, v.value);
+                },
+                [value](Value<std::string> &v) {
+                    std::uint16_t length = 0;
+                    memcpy(&length, value, sizeof(length));
+                    v.value.assign((const char *)value + sizeof(length), length);
+                },
+                [&arrays, &nested, &items](Array &array) {
+                    arrays.emplace_back(&array);
+                    nested.emplace_back(std::move(items));
+                }
+            );
+        }
+        for (std::size_t i = 0; i < arrays.size(); i++) {
+            for (ScopeId itemId : nested[i]) {
+                std::shared_ptr<ScopeImpl> item = _createScope(reader, created);
+                if (item == nullptr || item->getId() != itemId) {
+                    return nullptr;
+                }
+                arrays[i]->items.emplace(itemId, item);
+            }
+        }
+        
+        return result;
+    }
+    
+    void DataHubImpl::_registerScope(const std::shared_ptr<ScopeImpl> &scope) {
+        for (ElementIndex i = 0; i < scope->getElementCount(); i++) {
+            if (const Array *array = std::get_if<Array>(&scope->getElementAt(i)->data)) {
+                for (const auto &item : array->items) {
+                    _registerScope(item.second);
+                }
+            }
+        }
+        
+        _scopes.emplace(scope->getId(), scope);
+    }
+    
+    void DataHubImpl::_unregisterScope(const ScopeImpl &scope) {
+        for (ElementIndex i = 0; i < scope.getElementCount(); i++) {
+            if (const Array *array = std::get_if<Array>(&scope.getElementAt(i)->data)) {
+                for (const auto &item : array->items) {
+                    _unregisterScope(*item.second);
+                }
+            }
+        }
+        
+        _scopes.erase(scope.getId());
+    }
+
     void testDataHub() {
+        struct TestLogger : public foundation::LoggerInterface {
+            void logMsg(const char *fmt, ...) override {}
+            void logError(const char *fmt, ...) override { errors++; }
+            int errors = 0;
+        };
+        
+        std::shared_ptr<TestLogger> logger = std::make_shared<TestLogger>();
+        std::shared_ptr<DataHub> hub = DataHub::instance(logger, R"(
+            player {
+                health : integer = 100
+                name : string = "hero"
+                alive : bool = true
+                position : vector3f = 1.0 2.0 3.0
+            }
+        )");
+        
+        ScopePtr player = hub->getRootScope("player");
+        assert(player);
+        
+        const Key health = player->key("health");
+        const Key position = player->key("position");
+        assert(health && position);
+        assert(player->getInteger(health) == 100);
+        assert(player->getVector3f(position).z == 3.0f);
+        assert(player->getString("name") == "hero");
+        assert(player->getBool("alive"));
+        
+        player->setInteger(health, 50);
+        hub->update(0.0f);
+        assert(player->getInteger("health") == 50);
+        assert(logger->errors == 0);
+        
+        int healthCalls = 0;
+        EventToken first = INVALID_EVENT_TOKEN, second = INVALID_EVENT_TOKEN;
+        player->onIntegerChanged(first, "health", [&](const int &) {
+            healthCalls++;
+            player->removeHandler(first);
+        });
+        player->onIntegerChanged(second, "health", [&healthCalls](const int &) {
+            healthCalls++;
+        });
+        player->setInteger(health, 40);
+        player->setInteger(health, 30);
+        hub->update(0.0f);
+        assert(healthCalls == 3);
+        player->removeHandler(second);
+        player->setInteger(health, 20);
+        hub->update(0.0f);
+        assert(healthCalls == 3);
+        assert(logger->errors == 0);
+        
+        assert(!player->key("unknown"));
+        assert(logger->errors == 1);
+        player->getBool(health);
+        assert(logger->errors == 2);
+        logger->errors = 0;
+        
+        const char *inventoryDesc = R"(
+            inventory {
+                gold : integer = 0
+                items : array {
+                    title : string = ""
+                    count : integer = 1
+                }
+            }
+        )";
+        
+        std::shared_ptr<DataHub> source = DataHub::instance(logger, inventoryDesc);
+        std::shared_ptr<DataHub> replica = DataHub::instance(logger, inventoryDesc);
+        ScopePtr inventory = source->getRootScope("inventory");
+        
+        const std::vector<std::uint8_t> empty = source->makeSnapshot();
+        inventory->setInteger("gold", 10);
+        ScopePtr sword = inventory->addItem("items", [](WriteAccessor &item) {
+            item.setString(item.key("title"), "sword");
+        });
+        inventory->addItem("items", [](WriteAccessor &item) {
+            item.setString("title", "shield");
+            item.setInteger("count", 2);
+        });
+        source->update(0.0f);
+        assert(sword->getString("title") == "sword");
+        
+        const std::vector<std::uint8_t> full = source->makeSnapshot();
+        const std::vector<std::uint8_t> delta = source->makeDelta(empty.data(), empty.size());
+        assert(delta.size() < full.size());
+        
+        int addedCount = 0;
+        EventToken token;
+        replica->getRootScope("inventory")->onItemAdded(token, "items", [&addedCount](const ScopePtr &) { addedCount++; });
+        assert(replica->applyDelta(delta.data(), delta.size()));
+        assert(replica->getScope(sword->getId()) == nullptr);
+        assert(replica->makeDelta(empty.data(), empty.size()).size() == sizeof(std::uint32_t) * 2 + sizeof(std::uint64_t));
+        replica->update(0.0f);
+        assert(addedCount == 2);
+        assert(replica->getRootScope("inventory")->getInteger("gold") == 10);
+        assert(replica->getScope(sword->getId())->getString("title") == "sword");
+        
+        sword->setInteger("count", 5);
+        inventory->removeItem("items", sword);
+        source->update(0.0f);
+        assert(source->getScope(sword->getId()) == nullptr);
+        
+        const std::vector<std::uint8_t> nextDelta = source->makeDelta(full.data(), full.size());
+        assert(nextDelta.size() < delta.size());
+        assert(replica->applyDelta(nextDelta.data(), nextDelta.size()));
+        replica->update(0.0f);
+        assert(replica->getScope(sword->getId()) == nullptr);
+        
+        assert(source->restoreSnapshot(empty.data(), empty.size()));
+        source->update(0.0f);
+        assert(inventory->getInteger("gold") == 0);
+        assert(source->makeDelta(empty.data(), empty.size()).size() == sizeof(std::uint32_t) * 2 + sizeof(std::uint64_t));
+        assert(logger->errors == 0);
+        
+        assert(replica->applyDelta(full.data(), full.size()) == false);
+        assert(logger->errors == 1);
+        logger->errors = 0;
+        
+        // Hubs with the same history give the same item ids, so deltas of one are valid for another
+        std::shared_ptr<DataHub> left = DataHub::instance(logger, inventoryDesc);
+        std::shared_ptr<DataHub> right = DataHub::instance(logger, inventoryDesc);
+        ScopePtr leftBow = left->getRootScope("inventory")->addItem("items", [](WriteAccessor &item) {
+            item.setString("title", "bow");
+        });
+        ScopePtr rightBow = right->getRootScope("inventory")->addItem("items", [](WriteAccessor &item) {
+            item.setString("title", "bow");
+        });
+        left->update(0.0f);
+        right->update(0.0f);
+        assert(leftBow->getId() == rightBow->getId());
         
+        const std::vector<std::uint8_t> bowAdded = left->makeSnapshot();
+        leftBow->setInteger("count", 3);
+        left->update(0.0f);
+        const std::vector<std::uint8_t> bowDelta = left->makeDelta(bowAdded.data(), bowAdded.size());
+        assert(right->applyDelta(bowDelta.data(), bowDelta.size()));
+        right->update(0.0f);
+        assert(rightBow->getInteger("count") == 3);
+        assert(logger->errors == 0);
     }
 }
@@ -4,6 +4,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <vector>
 
 #include "foundation/math.h"
 #include "foundation/platform.h"
@@ -14,8 +15,23 @@ namespace dh {
     using ScopeId = std::uint32_t;
     using EventToken = std::uint32_t;
     
+    const EventToken INVALID_EVENT_TOKEN = 0;
+    
+    // Interned element name. Resolved once by Scope::key() and valid for every scope created from the same template
+    //
+    struct Key {
+        std::uint8_t templateIndex = 0xff;
+        std::uint8_t elementIndex = 0xff;
+        
+        explicit operator bool() const { return elementIndex != 0xff; }
+    };
+    
     class WriteAccessor {
     public:
+        // Returns key of element with @name or invalid key if there is no such element
+        //
+        virtual auto key(const char *name) const -> Key = 0;
+        
         virtual void setBool(const char *name, bool value) = 0;
         virtual void setNumber(const char *name, double value) = 0;
         virtual void setInteger(const char *name, int value) = 0;
@@ -23,6 +39,13 @@ namespace dh {
         virtual void setVector2f(const char *name, const math::vector2f &value) = 0;
         virtual void setVector3f(const char *name, const math::vector3f &value) = 0;
         
+        virtual void setBool(Key key, bool value) = 0;
+        virtual void setNumber(Key key, double value) = 0;
+        virtual void setInteger(Key key, int value) = 0;
+        virtual void setString(Key key, const std::string &value) = 0;
+        virtual void setVector2f(Key key, const math::vector2f &value) = 0;
+        virtual void setVector3f(Key key, const math::vector3f &value) = 0;
+        
     public:
         virtual ~WriteAccessor() = default;
     };
@@ -37,16 +60,27 @@ namespace dh {
         virtual auto getVector2f(const char *name) const -> const math::vector2f & = 0;
         virtual auto getVector3f(const char *name) const -> const math::vector3f & = 0;
         
-        virtual void onBoolChanged(EventToken &handler, const char *name, std::function<void(const bool &)> &&f) = 0;
-        virtual void onIntegerChanged(EventToken &handler, const char *name, std::function<void(const int &)> &&f) = 0;
-        virtual void onNumberChanged(EventToken &handler, const char *name, std::function<void(const double &)> &&f) = 0;
-        virtual void onStringChanged(EventToken &handler, const char *name, std::function<void(const std::string &)> &&f) = 0;
-        virtual void onVector2fChanged(EventToken &handler, const char *name, std::function<void(const math::vector2f &)> &&f) = 0;
-        virtual void onVector3fChanged(EventToken &handler, const char *name, std::function<void(const math::vector3f &)> &&f) = 0;
-        virtual void onItemAdded(EventToken &handler, const char *arrayName, std::function<void(const ScopePtr &)> &&f) = 0;
-        virtual void onItemRemoved(EventToken &handler, const char *arrayName, std::function<void(ScopeId)> &&f) = 0;
+        virtual auto getBool(Key key) const -> bool = 0;
+        virtual auto getInteger(Key key) const -> int = 0;
+        virtual auto getNumber(Key key) const -> double = 0;
+        virtual auto getString(Key key) const -> const std::string & = 0;
+        virtual auto getVector2f(Key key) const -> const math::vector2f & = 0;
+        virtual auto getVector3f(Key key) const -> const math::vector3f & = 0;
+        
+        virtual void onBoolChanged(EventToken &handler, const char *name, util::callback<void(const bool &)> &&f) = 0;
+        virtual void onIntegerChanged(EventToken &handler, const char *name, util::callback<void(const int &)> &&f) = 0;
+        virtual void onNumberChanged(EventToken &handler, const char *name, util::callback<void(const double &)> &&f) = 0;
+        virtual void onStringChanged(EventToken &handler, const char *name, util::callback<void(const std::string &)> &&f) = 0;
+        virtual void onVector2fChanged(EventToken &handler, const char *name, util::callback<void(const math::vector2f &)> &&f) = 0;
+        virtual void onVector3fChanged(EventToken &handler, const char *name, util::callback<void(const math::vector3f &)> &&f) = 0;
+        virtual void onItemAdded(EventToken &handler, const char *arrayName, util::callback<void(const ScopePtr &)> &&f) = 0;
+        virtual void onItemRemoved(EventToken &handler, const char *arrayName, util::callback<void(ScopeId)> &&f) = 0;
     
-        virtual auto addItem(const char *arrayName, std::function<void(WriteAccessor&)> &&initializer) -> ScopePtr = 0;
+        // Removes handler set by any of on*Changed/onItemAdded/onItemRemoved
+        //
+        virtual void removeHandler(EventToken handler) = 0;
+        
+        virtual auto addItem(const char *arrayName, util::callback<void(WriteAccessor&)> &&initializer) -> ScopePtr = 0;
         virtual void removeItem(const char *arrayName, const ScopePtr &scope) = 0;
         
     public:
@@ -87,6 +121,24 @@ namespace dh {
         virtual std::shared_ptr<Scope> getScope(ScopeId token) = 0;
         virtual std::shared_ptr<Scope> getRootScope(const char *rootScopeName) = 0;
         
+        // Serializes all scopes and array items to compact binary form. Snapshot is valid only for datahub with the same description
+        //
+        virtual auto makeSnapshot() const -> std::vector<std::uint8_t> = 0;
+        
+        // Encodes changes made since @base snapshot was taken: changed values, added and removed items
+        // @return   - empty vector if @base is corrupted
+        //
+        virtual auto makeDelta(const std::uint8_t *base, std::size_t length) const -> std::vector<std::uint8_t> = 0;
+        
+        // Applies delta produced by makeDelta(). Values and items change and handlers fire on the next update() as if they were set locally
+        // @return   - false if data is corrupted or made by datahub with another description. Nothing is applied in that case
+        //
+        virtual bool applyDelta(const std::uint8_t *data, std::size_t length) = 0;
+        
+        // Brings state to @snapshot. Only differing values and items are changed, so handlers fire for real changes only
+        //
+        virtual bool restoreSnapshot(const std::uint8_t *data, std::size_t length) = 0;
+        
     public:
         virtual ~DataHub() = default;
     };
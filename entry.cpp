@@ -1,6 +1,7 @@
 
 #include "foundation/platform.h"
 #include "foundation/rendering.h"
+#include "foundation/memory.h"
 #include "providers/resource_provider.h"
 #include "providers/fontatlas_provider.h"
 #include "core/scene.h"
@@ -26,6 +27,11 @@ game::StateManagerPtr stateManager;
 dh::DataHubPtr datahub;
 
 extern "C" void initialize() {
+    // Subsystems allocating every frame get own heaps, others stay on system malloc
+    foundation::MemoryPool::enableTLSF(foundation::MemoryPoolId::WORLD, 1024 * 1024);
+    foundation::MemoryPool::enableTLSF(foundation::MemoryPoolId::UI, 256 * 1024);
+    foundation::MemoryPool::enableTLSF(foundation::MemoryPoolId::DATAHUB, 256 * 1024);
+    
     platform = foundation::PlatformInterface::instance();
     platform->loadFile(resource::PREFAB_BIN, [](std::unique_ptr<std::uint8_t []> &&prefabsData, std::size_t prefabsSize) {
         platform->loadFile("arial.ttf", [prefabsData = std::move(prefabsData), prefabsSize](std::unique_ptr<std::uint8_t []> &&fontData, std::size_t fontSize) {
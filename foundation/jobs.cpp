@@ -0,0 +1,145 @@
+
+#include "jobs.h"
+
+#if !defined(PLATFORM_WASM)
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+    class WorkerPool {
+    public:
+        WorkerPool() {
+            const std::size_t workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+            for (std::size_t i = 0; i < workerCount; i++) {
+                _threads.emplace_back(&WorkerPool::_workerLoop, this);
+            }
+        }
+        ~WorkerPool() {
+            {
+                std::lock_guard<std::mutex> guard(_mutex);
+                _exit = true;
+            }
+            _wakeUp.notify_all();
+            for (std::thread &thread : _threads) {
+                thread.join();
+            }
+        }
+        
+        std::size_t getThreadCount() const {
+            return _threads.size() + 1;
+        }
+        
+        void run(std::size_t count, const util::callback<void(std::size_t)> &job) {
+            std::lock_guard<std::mutex> runGuard(_runMutex);
+            {
+                std::lock_guard<std::mutex> guard(_mutex);
+                _job = &job;
+                _count = count;
+                _next = 0;
+                _done = 0;
+                _generation++;
+            }
+            _wakeUp.notify_all();
+            _process();
+            
+            std::unique_lock<std::mutex> guard(_mutex);
+            _finished.wait(guard, [this] { return _done == _count && _active == 0; });
+            _job = nullptr;
+        }
+        
+    private:
+        void _workerLoop() {
+            std::uint64_t generation = 0;
+            
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> guard(_mutex);
+                    _wakeUp.wait(guard, [&] { return _exit || (_job && _generation != generation); });
+                    
+                    if (_exit) {
+                        break;
+                    }
+                    
+                    generation = _generation;
+                    _active++;
+                }
+                
+                _process();
+                
+                {
+                    std::lock_guard<std::mutex> guard(_mutex);
+                    _active--;
+                }
+                _finished.notify_all();
+            }
+        }
+        
+        void _process() {
+            std::size_t processed = 0;
+            
+            for (std::size_t index = _next++; index < _count; index = _next++) {
+                (*_job)(index);
+                processed++;
+            }
+            if (processed) {
+                std::lock_guard<std::mutex> guard(_mutex);
+                _done += processed;
+            }
+        }
+        
+    private:
+        std::vector<std::thread> _threads;
+        std::mutex _runMutex;
+        std::mutex _mutex;
+        std::condition_variable _wakeUp;
+        std::condition_variable _finished;
+        
+        const util::callback<void(std::size_t)> *_job = nullptr;
+        std::size_t _count = 0;
+        std::atomic<std::size_t> _next = 0;
+        std::size_t _done = 0;
+        std::size_t _active = 0;
+        std::uint64_t _generation = 0;
+        bool _exit = false;
+    };
+    
+    WorkerPool &getWorkerPool() {
+        static WorkerPool pool;
+        return pool;
+    }
+}
+
+namespace foundation {
+    std::size_t JobSystem::getThreadCount() {
+        return getWorkerPool().getThreadCount();
+    }
+    void JobSystem::parallelFor(std::size_t count, util::callback<void(std::size_t index)> &&job) {
+        if (count > 1 && getWorkerPool().getThreadCount() > 1) {
+            getWorkerPool().run(count, job);
+        }
+        else {
+            for (std::size_t i = 0; i < count; i++) {
+                job(i);
+            }
+        }
+    }
+}
+
+#else
+
+namespace foundation {
+    std::size_t JobSystem::getThreadCount() {
+        return 1;
+    }
+    void JobSystem::parallelFor(std::size_t count, util::callback<void(std::size_t index)> &&job) {
+        for (std::size_t i = 0; i < count; i++) {
+            job(i);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,23 @@
+
+#pragma once
+
+#include "util.h"
+
+#include <cstddef>
+
+namespace foundation {
+    // Worker threads for data-parallel work inside a frame
+    // Workers are started on first use. Platforms without threads (wasm) run all jobs on the calling thread
+    //
+    class JobSystem {
+    public:
+        // Number of threads taking part in parallelFor, including the calling one
+        //
+        static auto getThreadCount() -> std::size_t;
+        
+        // Calls @job for every index in [0, @count) from worker threads and the calling thread
+        // Returns when all calls are finished. @job must not call parallelFor
+        //
+        static void parallelFor(std::size_t count, util::callback<void(std::size_t index)> &&job);
+    };
+}
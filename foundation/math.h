@@ -10,12 +10,74 @@
 #pragma once
 #include <limits>
 #include <cmath>
+#include <cstddef>
 #include <algorithm>
 
+// SIMD backend for transform3f and batch functions. Define MATH_NO_SIMD to use scalar code only
+// NEON and wasm simd128 are used through compiler vector extensions (clang and gcc), SSE through intrinsics
+//
+#if !defined(MATH_NO_SIMD)
+#if defined(__ARM_NEON) || defined(__wasm_simd128__)
+#define MATH_SIMD_VECTOR_EXT 1
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MATH_SIMD_SSE 1
+#endif
+#endif
+
+#if defined(MATH_SIMD_VECTOR_EXT) || defined(MATH_SIMD_SSE)
+#define MATH_SIMD 1
+#endif
+
 namespace math {
     using scalar = float;
     using integer = int;
     
+#if defined(MATH_SIMD)
+    namespace simd {
+#if defined(MATH_SIMD_SSE)
+        using f4 = __m128;
+        
+        inline f4 load(const scalar *p) { return _mm_loadu_ps(p); }
+        inline void store(scalar *p, f4 v) { _mm_storeu_ps(p, v); }
+        inline f4 splat(scalar s) { return _mm_set1_ps(s); }
+        inline f4 set(scalar x, scalar y, scalar z, scalar w) { return _mm_setr_ps(x, y, z, w); }
+        inline f4 add(f4 a, f4 b) { return _mm_add_ps(a, b); }
+        inline f4 sub(f4 a, f4 b) { return _mm_sub_ps(a, b); }
+        inline f4 mul(f4 a, f4 b) { return _mm_mul_ps(a, b); }
+        inline f4 div(f4 a, f4 b) { return _mm_div_ps(a, b); }
+        
+        // (a[X], a[Y], b[Z], b[W])
+        template<int X, int Y, int Z, int W> inline f4 shuffle(f4 a, f4 b) { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(W, Z, Y, X)); }
+#else
+        typedef scalar f4 __attribute__((vector_size(16)));
+        
+        inline f4 load(const scalar *p) { f4 r; __builtin_memcpy(&r, p, sizeof(f4)); return r; }
+        inline void store(scalar *p, f4 v) { __builtin_memcpy(p, &v, sizeof(f4)); }
+        inline f4 splat(scalar s) { return f4{s, s, s, s}; }
+        inline f4 set(scalar x, scalar y, scalar z, scalar w) { return f4{x, y, z, w}; }
+        inline f4 add(f4 a, f4 b) { return a + b; }
+        inline f4 sub(f4 a, f4 b) { return a - b; }
+        inline f4 mul(f4 a, f4 b) { return a * b; }
+        inline f4 div(f4 a, f4 b) { return a / b; }
+        
+        // (a[X], a[Y], b[Z], b[W])
+        template<int X, int Y, int Z, int W> inline f4 shuffle(f4 a, f4 b) { return __builtin_shufflevector(a, b, X, Y, Z + 4, W + 4); }
+#endif
+        template<int X, int Y, int Z, int W> inline f4 swizzle(f4 v) { return shuffle<X, Y, Z, W>(v, v); }
+        
+        // x * r0 + y * r1 + z * r2 + w * r3
+        inline f4 combine(scalar x, scalar y, scalar z, scalar w, f4 r0, f4 r1, f4 r2, f4 r3) {
+            return add(add(mul(splat(x), r0), mul(splat(y), r1)), add(mul(splat(z), r2), mul(splat(w), r3)));
+        }
+        
+        // v[0] * r0 + v[1] * r1 + v[2] * r2 + v[3] * r3
+        inline f4 combine(f4 v, f4 r0, f4 r1, f4 r2, f4 r3) {
+            return add(add(mul(swizzle<0, 0, 0, 0>(v), r0), mul(swizzle<1, 1, 1, 1>(v), r1)), add(mul(swizzle<2, 2, 2, 2>(v), r2), mul(swizzle<3, 3, 3, 3>(v), r3)));
+        }
+    }
+#endif
+    
     struct vector2f;
     struct vector3f;
     struct vector4f;
@@ -302,6 +364,7 @@ namespace math {
         };
         
         transform2f() = default;
+        transform2f(const transform2f &) = default;
         transform2f(const vector3f &r0, const vector3f &r1, const vector3f &r2);
         transform2f(scalar radians);
         transform2f& operator =(const transform2f& other);
@@ -311,7 +374,7 @@ namespace math {
         transform2f scaled(const vector2f &v) const;
         transform2f inverted() const;
     };
-    struct transform3f { // TODO: subvectors with ability to get ref
+    struct alignas(16) transform3f { // TODO: subvectors with ability to get ref
         union {
             struct {
                 scalar m11, m12, m13, m14;
@@ -346,6 +409,7 @@ namespace math {
         static transform3f platformPerspectiveFovRH(scalar fovY, scalar aspect, scalar zNear, scalar zFar);
         
         transform3f() = default;
+        transform3f(const transform3f &) = default;
         transform3f(const vector4f &r0, const vector4f &r1, const vector4f &r2, const vector4f &r3);
         transform3f(const vector3f &axis, scalar radians);
         transform3f& operator =(const transform3f& other);
@@ -688,11 +752,17 @@ namespace math {
     template<int Ix, int Iy, int Iz>
     inline vector3f swizzle3f<Ix, Iy, Iz>::transformed(const transform3f &trfm, bool likePosition) const {
         const scalar flat[4] = {(*this)[Ix], (*this)[Iy], (*this)[Iz], likePosition ? scalar(1.0) : scalar(0.0)};
+#if defined(MATH_SIMD)
+        scalar result[4];
+        simd::store(result, simd::combine(flat[0], flat[1], flat[2], flat[3], simd::load(trfm.row0), simd::load(trfm.row1), simd::load(trfm.row2), simd::load(trfm.row3)));
+        return {result[0], result[1], result[2]};
+#else
         return {
             flat[0] * trfm.row0[0] + flat[1] * trfm.row1[0] + flat[2] * trfm.row2[0] + flat[3] * trfm.row3[0],
             flat[0] * trfm.row0[1] + flat[1] * trfm.row1[1] + flat[2] * trfm.row2[1] + flat[3] * trfm.row3[1],
             flat[0] * trfm.row0[2] + flat[1] * trfm.row1[2] + flat[2] * trfm.row2[2] + flat[3] * trfm.row3[2]
         };
+#endif
     }
     template<int Ix, int Iy, int Iz>
     inline vector3f swizzle3f<Ix, Iy, Iz>::signs() const {
@@ -710,12 +780,18 @@ namespace math {
     template<int Ix, int Iy, int Iz, int Iw>
     inline vector4f swizzle4f<Ix, Iy, Iz, Iw>::transformed(const transform3f &trfm) const {
         const scalar flat[4] = {(*this)[Ix], (*this)[Iy], (*this)[Iz], (*this)[Iw]};
+#if defined(MATH_SIMD)
+        vector4f result;
+        simd::store(result.flat, simd::combine(flat[0], flat[1], flat[2], flat[3], simd::load(trfm.row0), simd::load(trfm.row1), simd::load(trfm.row2), simd::load(trfm.row3)));
+        return result;
+#else
         return {
             flat[0] * trfm.row0[0] + flat[1] * trfm.row1[0] + flat[2] * trfm.row2[0] + flat[3] * trfm.row3[0],
             flat[0] * trfm.row0[1] + flat[1] * trfm.row1[1] + flat[2] * trfm.row2[1] + flat[3] * trfm.row3[1],
             flat[0] * trfm.row0[2] + flat[1] * trfm.row1[2] + flat[2] * trfm.row2[2] + flat[3] * trfm.row3[2],
             flat[0] * trfm.row0[3] + flat[1] * trfm.row1[3] + flat[2] * trfm.row2[3] + flat[3] * trfm.row3[3]
         };
+#endif
     }
     template<int Ix, int Iy, int Iz, int Iw>
     inline vector4f swizzle4f<Ix, Iy, Iz, Iw>::quaternionMultiply(const vector4f &other) const {
@@ -822,6 +898,63 @@ namespace math {
         };
     }
     inline transform3f transform3f::inverted() const {
+#if defined(MATH_SIMD)
+        // Block-wise inversion: matrix is split to 2x2 sub-matrices A B / C D, each packed to one register
+        using namespace simd;
+        
+        const auto mul2 = [](f4 a, f4 b) { // A * B
+            return add(mul(a, swizzle<0, 3, 0, 3>(b)), mul(swizzle<1, 0, 3, 2>(a), swizzle<2, 1, 2, 1>(b)));
+        };
+        const auto adjMul2 = [](f4 a, f4 b) { // adj(A) * B
+            return sub(mul(swizzle<3, 3, 0, 0>(a), b), mul(swizzle<1, 1, 2, 2>(a), swizzle<2, 3, 0, 1>(b)));
+        };
+        const auto mulAdj2 = [](f4 a, f4 b) { // A * adj(B)
+            return sub(mul(a, swizzle<3, 0, 3, 0>(b)), mul(swizzle<1, 0, 3, 2>(a), swizzle<2, 1, 2, 1>(b)));
+        };
+        
+        const f4 r0 = load(row0);
+        const f4 r1 = load(row1);
+        const f4 r2 = load(row2);
+        const f4 r3 = load(row3);
+        
+        const f4 a = shuffle<0, 1, 0, 1>(r0, r1);
+        const f4 b = shuffle<2, 3, 2, 3>(r0, r1);
+        const f4 c = shuffle<0, 1, 0, 1>(r2, r3);
+        const f4 d = shuffle<2, 3, 2, 3>(r2, r3);
+        
+        // (|A|, |B|, |C|, |D|)
+        const f4 detSub = sub(mul(shuffle<0, 2, 0, 2>(r0, r2), shuffle<1, 3, 1, 3>(r1, r3)), mul(shuffle<1, 3, 1, 3>(r0, r2), shuffle<0, 2, 0, 2>(r1, r3)));
+        const f4 detA = swizzle<0, 0, 0, 0>(detSub);
+        const f4 detB = swizzle<1, 1, 1, 1>(detSub);
+        const f4 detC = swizzle<2, 2, 2, 2>(detSub);
+        const f4 detD = swizzle<3, 3, 3, 3>(detSub);
+        
+        const f4 dc = adjMul2(d, c);
+        const f4 ab = adjMul2(a, b);
+        f4 x = sub(mul(detD, a), mul2(b, dc));
+        f4 w = sub(mul(detA, d), mul2(c, ab));
+        f4 y = sub(mul(detB, c), mulAdj2(d, ab));
+        f4 z = sub(mul(detC, b), mulAdj2(a, dc));
+        
+        f4 tr = mul(ab, swizzle<0, 2, 1, 3>(dc));
+        tr = add(tr, swizzle<2, 3, 0, 1>(tr));
+        tr = add(tr, swizzle<1, 0, 3, 2>(tr));
+        
+        const f4 detM = sub(add(mul(detA, detD), mul(detB, detC)), tr);
+        const f4 rDetM = div(set(1.0f, -1.0f, -1.0f, 1.0f), detM);
+        
+        x = mul(x, rDetM);
+        y = mul(y, rDetM);
+        z = mul(z, rDetM);
+        w = mul(w, rDetM);
+        
+        transform3f result;
+        store(result.row0, shuffle<3, 1, 3, 1>(x, y));
+        store(result.row1, shuffle<2, 0, 2, 0>(x, y));
+        store(result.row2, shuffle<3, 1, 3, 1>(z, w));
+        store(result.row3, shuffle<2, 0, 2, 0>(z, w));
+        return result;
+#else
         scalar a2323 = row2[2] * row3[3] - row2[3] * row3[2];
         scalar a1323 = row2[1] * row3[3] - row2[3] * row3[1];
         scalar a1223 = row2[1] * row3[2] - row2[2] * row3[1];
@@ -874,9 +1007,23 @@ namespace math {
                 det *  (row0[0] * a1212 - row0[1] * a0212 + row0[2] * a0112)
             )
         };
+#endif
     }
     
     inline transform3f operator *(const transform3f &t0, const transform3f &t1) {
+#if defined(MATH_SIMD)
+        const simd::f4 b0 = simd::load(t1.row0);
+        const simd::f4 b1 = simd::load(t1.row1);
+        const simd::f4 b2 = simd::load(t1.row2);
+        const simd::f4 b3 = simd::load(t1.row3);
+        
+        transform3f result;
+        simd::store(result.row0, simd::combine(t0.row0[0], t0.row0[1], t0.row0[2], t0.row0[3], b0, b1, b2, b3));
+        simd::store(result.row1, simd::combine(t0.row1[0], t0.row1[1], t0.row1[2], t0.row1[3], b0, b1, b2, b3));
+        simd::store(result.row2, simd::combine(t0.row2[0], t0.row2[1], t0.row2[2], t0.row2[3], b0, b1, b2, b3));
+        simd::store(result.row3, simd::combine(t0.row3[0], t0.row3[1], t0.row3[2], t0.row3[3], b0, b1, b2, b3));
+        return result;
+#else
         vector4f r0, r1, r2, r3;
         
         r0.flat[0] = t0.row0[0] * t1.row0[0] + t0.row0[1] * t1.row1[0] + t0.row0[2] * t1.row2[0] + t0.row0[3] * t1.row3[0];
@@ -900,6 +1047,73 @@ namespace math {
         r3.flat[3] = t0.row3[0] * t1.row0[3] + t0.row3[1] * t1.row1[3] + t0.row3[2] * t1.row2[3] + t0.row3[3] * t1.row3[3];
         
         return transform3f(r0, r1, r2, r3);
+#endif
+    }
+    
+    // Batch versions of vector3f::transformed(trfm, true) and (src[i] * trfm)
+    // @src and @dst can be the same array
+    //
+    inline void transformPoints(const vector3f *src, vector3f *dst, std::size_t count, const transform3f &trfm) {
+        std::size_t i = 0;
+#if defined(MATH_SIMD)
+        // 4 points (12 packed scalars, 3 registers) per iteration. Matrix columns are pre-rotated to the
+        // component order of every output register, so results are stored as is without transposing back
+        const simd::f4 xa = simd::set(trfm.m11, trfm.m12, trfm.m13, trfm.m11);
+        const simd::f4 ya = simd::set(trfm.m21, trfm.m22, trfm.m23, trfm.m21);
+        const simd::f4 za = simd::set(trfm.m31, trfm.m32, trfm.m33, trfm.m31);
+        const simd::f4 ta = simd::set(trfm.m41, trfm.m42, trfm.m43, trfm.m41);
+        const simd::f4 xb = simd::set(trfm.m12, trfm.m13, trfm.m11, trfm.m12);
+        const simd::f4 yb = simd::set(trfm.m22, trfm.m23, trfm.m21, trfm.m22);
+        const simd::f4 zb = simd::set(trfm.m32, trfm.m33, trfm.m31, trfm.m32);
+        const simd::f4 tb = simd::set(trfm.m42, trfm.m43, trfm.m41, trfm.m42);
+        const simd::f4 xc = simd::set(trfm.m13, trfm.m11, trfm.m12, trfm.m13);
+        const simd::f4 yc = simd::set(trfm.m23, trfm.m21, trfm.m22, trfm.m23);
+        const simd::f4 zc = simd::set(trfm.m33, trfm.m31, trfm.m32, trfm.m33);
+        const simd::f4 tc = simd::set(trfm.m43, trfm.m41, trfm.m42, trfm.m43);
+        
+        for (const std::size_t blocks = count & ~std::size_t(3); i < blocks; i += 4) {
+            const simd::f4 a = simd::load(&src[i].x);     // x0 y0 z0 x1
+            const simd::f4 b = simd::load(&src[i].x + 4); // y1 z1 x2 y2
+            const simd::f4 c = simd::load(&src[i].x + 8); // z2 x3 y3 z3
+            
+            const simd::f4 ax = simd::swizzle<0, 0, 0, 3>(a);
+            const simd::f4 ay = simd::swizzle<0, 0, 0, 2>(simd::shuffle<1, 1, 0, 0>(a, b));
+            const simd::f4 az = simd::swizzle<0, 0, 0, 2>(simd::shuffle<2, 2, 1, 1>(a, b));
+            const simd::f4 bx = simd::shuffle<3, 3, 2, 2>(a, b);
+            const simd::f4 by = simd::swizzle<0, 0, 3, 3>(b);
+            const simd::f4 bz = simd::shuffle<1, 1, 0, 0>(b, c);
+            const simd::f4 cx = simd::swizzle<0, 2, 3, 3>(simd::shuffle<2, 2, 1, 1>(b, c));
+            const simd::f4 cy = simd::swizzle<0, 2, 3, 3>(simd::shuffle<3, 3, 2, 2>(b, c));
+            const simd::f4 cz = simd::swizzle<0, 3, 3, 3>(c);
+            
+            simd::store(&dst[i].x,     simd::add(simd::add(simd::mul(ax, xa), simd::mul(ay, ya)), simd::add(simd::mul(az, za), ta)));
+            simd::store(&dst[i].x + 4, simd::add(simd::add(simd::mul(bx, xb), simd::mul(by, yb)), simd::add(simd::mul(bz, zb), tb)));
+            simd::store(&dst[i].x + 8, simd::add(simd::add(simd::mul(cx, xc), simd::mul(cy, yc)), simd::add(simd::mul(cz, zc), tc)));
+        }
+#endif
+        for (; i < count; i++) {
+            dst[i] = src[i].transformed(trfm, true);
+        }
+    }
+    inline void multiplyMany(const transform3f *src, transform3f *dst, std::size_t count, const transform3f &trfm) {
+#if defined(MATH_SIMD)
+        const simd::f4 b0 = simd::load(trfm.row0);
+        const simd::f4 b1 = simd::load(trfm.row1);
+        const simd::f4 b2 = simd::load(trfm.row2);
+        const simd::f4 b3 = simd::load(trfm.row3);
+        
+        // Every output row depends on the same input row only, so in-place is fine
+        for (std::size_t i = 0; i < count; i++) {
+            simd::store(dst[i].row0, simd::combine(simd::load(src[i].row0), b0, b1, b2, b3));
+            simd::store(dst[i].row1, simd::combine(simd::load(src[i].row1), b0, b1, b2, b3));
+            simd::store(dst[i].row2, simd::combine(simd::load(src[i].row2), b0, b1, b2, b3));
+            simd::store(dst[i].row3, simd::combine(simd::load(src[i].row3), b0, b1, b2, b3));
+        }
+#else
+        for (std::size_t i = 0; i < count; i++) {
+            dst[i] = src[i] * trfm;
+        }
+#endif
     }
 }
 
@@ -0,0 +1,196 @@
+
+#include "memory.h"
+#include "thirdparty/tlsf/tlsf.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+namespace {
+    const std::size_t MIN_AREA_OVERHEAD = 1024;
+    const std::size_t ITEM_ALIGNMENT = foundation::MemoryPool::ALIGNMENT;
+    const std::size_t BASE_ALIGNMENT = 2 * sizeof(void *); // guaranteed by TLSF and malloc
+    const std::size_t ALIGNMENT_PADDING = ITEM_ALIGNMENT > BASE_ALIGNMENT ? ITEM_ALIGNMENT - BASE_ALIGNMENT : 0;
+
+    // Placed right before the aligned memory returned to user. 'offset' is distance from the start of system block
+    //
+    struct alignas(BASE_ALIGNMENT) AllocationHeader {
+        std::size_t size;
+        foundation::MemoryPoolId pool;
+        std::uint8_t tag;
+        std::uint8_t offset;
+        bool tlsfBacked;
+    };
+
+    struct Pool {
+        std::atomic_flag lock = ATOMIC_FLAG_INIT;
+        void *tlsfPool = nullptr;
+        foundation::MemoryPoolStats stats;
+    };
+
+    Pool g_pools[std::size_t(foundation::MemoryPoolId::_count)];
+
+    class PoolLock {
+    public:
+        PoolLock(Pool &pool) : _pool(pool) {
+            while (_pool.lock.test_and_set(std::memory_order_acquire));
+        }
+        ~PoolLock() {
+            _pool.lock.clear(std::memory_order_release);
+        }
+
+    private:
+        Pool &_pool;
+    };
+}
+
+namespace foundation {
+    void MemoryPool::enableTLSF(MemoryPoolId pool, std::size_t initialSize) {
+        Pool &p = g_pools[std::size_t(pool)];
+        PoolLock lock(p);
+
+        if (p.tlsfPool == nullptr) {
+            if (void *memory = std::malloc(initialSize)) {
+                if (tlsf::init_memory_pool(initialSize, memory) != std::size_t(-1)) {
+                    p.tlsfPool = memory;
+                    p.stats.tlsfBacked = true;
+                    p.stats.reservedBytes = initialSize;
+                }
+                else {
+                    std::free(memory);
+                }
+            }
+        }
+    }
+
+    void *MemoryPool::allocate(MemoryPoolId pool, std::size_t size, std::uint8_t tag) {
+        Pool &p = g_pools[std::size_t(pool)];
+        const std::size_t totalSize = size + sizeof(AllocationHeader) + ALIGNMENT_PADDING;
+        void *block = nullptr;
+        bool tlsfBacked = false;
+
+        PoolLock lock(p);
+
+        if (p.tlsfPool) {
+            block = tlsf::malloc_ex(totalSize, p.tlsfPool);
+
+            if (block == nullptr) {
+                const std::size_t areaSize = std::max(p.stats.reservedBytes, totalSize + MIN_AREA_OVERHEAD);
+                if (void *area = std::malloc(areaSize)) {
+                    tlsf::add_new_area(area, areaSize, p.tlsfPool);
+                    p.stats.reservedBytes += areaSize;
+                    block = tlsf::malloc_ex(totalSize, p.tlsfPool);
+                }
+            }
+
+            tlsfBacked = block != nullptr;
+        }
+        if (block == nullptr) {
+            block = std::malloc(totalSize);
+        }
+        if (block) {
+            const std::uintptr_t start = reinterpret_cast<std::uintptr_t>(block);
+            const std::uintptr_t memory = (start + sizeof(AllocationHeader) + ITEM_ALIGNMENT - 1) & ~std::uintptr_t(ITEM_ALIGNMENT - 1);
+            AllocationHeader *header = reinterpret_cast<AllocationHeader *>(memory) - 1;
+            header->offset = std::uint8_t(reinterpret_cast<std::uint8_t *>(header) - static_cast<std::uint8_t *>(block));
+            header->size = size;
+            header->pool = pool;
+            header->tag = std::uint8_t(std::min(std::size_t(tag), MemoryPoolStats::MAX_TAGS - 1));
+            header->tlsfBacked = tlsfBacked;
+
+            p.stats.usedBytes += size;
+            p.stats.highWaterBytes = std::max(p.stats.highWaterBytes, p.stats.usedBytes);
+            p.stats.allocationCount++;
+            p.stats.tagBytes[header->tag] += size;
+            return header + 1;
+        }
+
+        return nullptr;
+    }
+
+    void MemoryPool::free(void *ptr) {
+        if (ptr) {
+            AllocationHeader *header = static_cast<AllocationHeader *>(ptr) - 1;
+            Pool &p = g_pools[std::size_t(header->pool)];
+            PoolLock lock(p);
+
+            p.stats.usedBytes -= header->size;
+            p.stats.allocationCount--;
+            p.stats.tagBytes[header->tag] -= header->size;
+
+            void *block = reinterpret_cast<std::uint8_t *>(header) - header->offset;
+
+            if (header->tlsfBacked) {
+                tlsf::free_ex(block, p.tlsfPool);
+            }
+            else {
+                std::free(block);
+            }
+        }
+    }
+
+    auto MemoryPool::getStats(MemoryPoolId pool) -> MemoryPoolStats {
+        Pool &p = g_pools[std::size_t(pool)];
+        PoolLock lock(p);
+
+        MemoryPoolStats result = p.stats;
+
+        if (p.tlsfPool) {
+            std::size_t totalFree = 0;
+            std::size_t largestFree = 0;
+            tlsf::free_stats(p.tlsfPool, &totalFree, &largestFree);
+            result.fragmentation = totalFree ? 1.0f - float(largestFree) / float(totalFree) : 0.0f;
+        }
+
+        return result;
+    }
+    
+    FixedSizePool::FixedSizePool(MemoryPoolId pool, std::size_t itemSize, std::size_t itemsPerBlock, std::uint8_t tag)
+    : _pool(pool)
+    , _tag(tag)
+    , _itemSize((std::max(itemSize, sizeof(FreeItem)) + ITEM_ALIGNMENT - 1) / ITEM_ALIGNMENT * ITEM_ALIGNMENT)
+    , _itemsPerBlock(std::max(itemsPerBlock, std::size_t(1)))
+    {}
+    
+    FixedSizePool::~FixedSizePool() {
+        while (_lastBlock) {
+            void *previous = *static_cast<void **>(_lastBlock);
+            MemoryPool::free(_lastBlock);
+            _lastBlock = previous;
+        }
+    }
+    
+    void *FixedSizePool::allocate() {
+        if (_freeItems == nullptr) {
+            std::uint8_t *block = static_cast<std::uint8_t *>(MemoryPool::allocate(_pool, ITEM_ALIGNMENT + _itemSize * _itemsPerBlock, _tag));
+            
+            if (block == nullptr) {
+                return nullptr;
+            }
+            
+            *reinterpret_cast<void **>(block) = _lastBlock;
+            _lastBlock = block;
+            _blockCount++;
+            
+            for (std::size_t i = _itemsPerBlock; i > 0; i--) {
+                FreeItem *item = reinterpret_cast<FreeItem *>(block + ITEM_ALIGNMENT + (i - 1) * _itemSize);
+                item->next = _freeItems;
+                _freeItems = item;
+            }
+        }
+        
+        FreeItem *result = _freeItems;
+        _freeItems = result->next;
+        _usedCount++;
+        return result;
+    }
+    
+    void FixedSizePool::free(void *ptr) {
+        if (ptr) {
+            FreeItem *item = static_cast<FreeItem *>(ptr);
+            item->next = _freeItems;
+            _freeItems = item;
+            _usedCount--;
+        }
+    }
+}
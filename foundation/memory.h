@@ -0,0 +1,122 @@
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace foundation {
+    // Subsystems with their own memory pool
+    //
+    enum class MemoryPoolId : std::uint8_t {
+        RESOURCES = 0,
+        SCENE,
+        UI,
+        DATAHUB,
+        WORLD,
+        _count
+    };
+
+    struct MemoryPoolStats {
+        static const std::size_t MAX_TAGS = 16;
+
+        bool tlsfBacked = false;
+        std::size_t reservedBytes = 0;          // memory taken from system by TLSF pool
+        std::size_t usedBytes = 0;              // bytes requested by alive allocations
+        std::size_t highWaterBytes = 0;         // maximum of usedBytes
+        std::size_t allocationCount = 0;        // alive allocations
+        float fragmentation = 0.0f;             // 1 - largest free block / all free memory. Zero for system-backed pool
+        std::size_t tagBytes[MAX_TAGS] = {};    // usedBytes split by tag
+    };
+
+    // Engine-wide allocator layer. Every pool counts its memory by tags
+    // By default pools forward to system malloc. enableTLSF() switches a pool to its own TLSF heap with own lock,
+    // so subsystems and worker threads don't contend for the system allocator
+    // All functions are thread-safe
+    //
+    class MemoryPool {
+    public:
+        // Every allocation is aligned at least for SIMD types, also on platforms where malloc gives less
+        //
+        static constexpr std::size_t ALIGNMENT = alignof(std::max_align_t) > 16 ? alignof(std::max_align_t) : 16;
+
+        // Switches pool to TLSF. Should be called at startup. Allocations made before stay valid and are freed to system
+        // @initialSize - bytes reserved at once. Every next area doubles reserved memory
+        //
+        static void enableTLSF(MemoryPoolId pool, std::size_t initialSize);
+
+        // @tag - any number below MemoryPoolStats::MAX_TAGS, defined by subsystem
+        //
+        static auto allocate(MemoryPoolId pool, std::size_t size, std::uint8_t tag = 0) -> void *;
+        static void free(void *ptr);
+
+        static auto getStats(MemoryPoolId pool) -> MemoryPoolStats;
+    };
+
+    // STL allocator over MemoryPool
+    //
+    template<typename T, MemoryPoolId POOL, std::uint8_t TAG = 0> struct PoolAllocator {
+        using value_type = T;
+        template<typename U> struct rebind { using other = PoolAllocator<U, POOL, TAG>; };
+
+        PoolAllocator() = default;
+        template<typename U> PoolAllocator(const PoolAllocator<U, POOL, TAG> &) {}
+
+        T *allocate(std::size_t n) {
+            return static_cast<T *>(MemoryPool::allocate(POOL, n * sizeof(T), TAG));
+        }
+        void deallocate(T *ptr, std::size_t) {
+            MemoryPool::free(ptr);
+        }
+
+        template<typename U> bool operator ==(const PoolAllocator<U, POOL, TAG> &) const { return true; }
+        template<typename U> bool operator !=(const PoolAllocator<U, POOL, TAG> &) const { return false; }
+    };
+
+    struct PoolDeleter {
+        void operator()(void *ptr) const { MemoryPool::free(ptr); }
+    };
+
+    // Raw byte buffer from a pool
+    //
+    using PoolBytes = std::unique_ptr<std::uint8_t[], PoolDeleter>;
+
+    inline PoolBytes makePoolBytes(MemoryPoolId pool, std::size_t size, std::uint8_t tag = 0) {
+        return PoolBytes(static_cast<std::uint8_t *>(MemoryPool::allocate(pool, size, tag)));
+    }
+    
+    // Free-list allocator of equal-sized items. Takes memory from a pool by blocks and returns it only on destruction
+    // Items are aligned to MemoryPool::ALIGNMENT
+    // Not thread-safe
+    //
+    class FixedSizePool {
+    public:
+        FixedSizePool(MemoryPoolId pool, std::size_t itemSize, std::size_t itemsPerBlock, std::uint8_t tag = 0);
+        ~FixedSizePool();
+        
+        auto allocate() -> void *;
+        void free(void *ptr);
+        
+        auto getUsedCount() const -> std::size_t { return _usedCount; }
+        auto getBlockCount() const -> std::size_t { return _blockCount; }
+        
+    private:
+        struct FreeItem {
+            FreeItem *next;
+        };
+        
+        const MemoryPoolId _pool;
+        const std::uint8_t _tag;
+        const std::size_t _itemSize;
+        const std::size_t _itemsPerBlock;
+        
+        void *_lastBlock = nullptr; // every block starts with pointer to previous one
+        FreeItem *_freeItems = nullptr;
+        std::size_t _usedCount = 0;
+        std::size_t _blockCount = 0;
+        
+    private:
+        FixedSizePool(const FixedSizePool &) = delete;
+        FixedSizePool &operator =(const FixedSizePool &) = delete;
+    };
+}
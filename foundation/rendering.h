@@ -254,6 +254,12 @@ namespace foundation {
         //
         virtual void draw(const RenderDataPtr &inputData, std::uint32_t instanceCount = 1) = 0;
 
+        // Draw part of RenderData. Lets many meshes (or frames of one mesh) share one buffer
+        // @start       - first vertex (first index if data is indexed)
+        // @count       - vertex count (index count if data is indexed)
+        //
+        virtual void draw(const RenderDataPtr &inputData, std::uint32_t start, std::uint32_t count, std::uint32_t instanceCount = 1) = 0;
+
         // Draw dynamic data
         // @data        - pointer to data (array of structures). Layout should be compatible with current shader
         // @vcnt        - count of structures in array
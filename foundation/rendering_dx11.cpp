@@ -952,6 +952,8 @@ namespace foundation {
         if (_swapChain) {
             _swapChain->Present(1, 0);
         }
+        
+        util::FrameArena::instance().reset();
     }
 
     void Direct3D11Rendering::getFrameBufferData(std::uint8_t *imgFrame) {}
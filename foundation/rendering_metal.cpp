@@ -1016,36 +1016,47 @@ namespace foundation {
     }
     
     void MetalRendering::draw(const RenderDataPtr &inputData, std::uint32_t instanceCount) {
+        const MetalData *implData = static_cast<const MetalData *>(inputData.get());
+        
+        if (implData) {
+            draw(inputData, 0, implData->getIndexCount() ? implData->getIndexCount() : implData->getVertexCount(), instanceCount);
+        }
+        else {
+            draw(inputData, 0, 1, instanceCount);
+        }
+    }
+    
+    void MetalRendering::draw(const RenderDataPtr &inputData, std::uint32_t start, std::uint32_t count, std::uint32_t instanceCount) {
         if (_currentRenderCommandEncoder && _currentShader) {
             const InputLayout &layout = _currentShader->getInputLayout();
             const MetalData *implData = static_cast<const MetalData *>(inputData.get());
             const MTLPrimitiveType topology = g_topologies[int(_currentTopology)];
             
-            std::uint32_t vcnt = 1;
-            std::uint32_t icnt = 0;
+            std::uint32_t stride = 0;
             id<MTLBuffer> vbuffer = nil;
             id<MTLBuffer> ibuffer = nil;
             
             if (implData) {
-                vcnt = implData->getVertexCount();
-                icnt = implData->getIndexCount();
+                stride = implData->getStride();
                 vbuffer = implData->getVertexes();
                 ibuffer = implData->getIndexes();
             }
 
             //[_currentRenderCommandEncoder setTriangleFillMode:MTLTriangleFillModeLines];
-            [_currentRenderCommandEncoder setVertexBuffer:vbuffer offset:0 atIndex:VERTEX_IN_BINDING_START];
-
             if (layout.repeat > 1) {
-                [_currentRenderCommandEncoder setVertexBytes:&vcnt length:sizeof(std::uint32_t) atIndex:VERTEX_IN_VERTEX_COUNT];
-                [_currentRenderCommandEncoder drawPrimitives:topology vertexStart:0 vertexCount:layout.repeat instanceCount:vcnt * instanceCount];
+                // instance index restarts from zero, so the range is applied by buffer offset
+                [_currentRenderCommandEncoder setVertexBuffer:vbuffer offset:start * stride atIndex:VERTEX_IN_BINDING_START];
+                [_currentRenderCommandEncoder setVertexBytes:&count length:sizeof(std::uint32_t) atIndex:VERTEX_IN_VERTEX_COUNT];
+                [_currentRenderCommandEncoder drawPrimitives:topology vertexStart:0 vertexCount:layout.repeat instanceCount:count * instanceCount];
             }
             else {
+                [_currentRenderCommandEncoder setVertexBuffer:vbuffer offset:0 atIndex:VERTEX_IN_BINDING_START];
+                
                 if (ibuffer) {
-                    [_currentRenderCommandEncoder drawIndexedPrimitives:topology indexCount:icnt indexType:MTLIndexTypeUInt32 indexBuffer:ibuffer indexBufferOffset:0 instanceCount:instanceCount];
+                    [_currentRenderCommandEncoder drawIndexedPrimitives:topology indexCount:count indexType:MTLIndexTypeUInt32 indexBuffer:ibuffer indexBufferOffset:start * sizeof(std::uint32_t) instanceCount:instanceCount];
                 }
                 else {
-                    [_currentRenderCommandEncoder drawPrimitives:topology vertexStart:0 vertexCount:vcnt instanceCount:instanceCount];
+                    [_currentRenderCommandEncoder drawPrimitives:topology vertexStart:start vertexCount:count instanceCount:instanceCount];
                 }
             }
         }
@@ -1112,6 +1123,8 @@ namespace foundation {
 
             dispatch_semaphore_wait(_frameBufferingSemaphore, DISPATCH_TIME_FOREVER);
         }
+        
+        util::FrameArena::instance().reset();
     }
     
     void MetalRendering::_appendConstantBuffer(const void *buffer, std::uint32_t size, std::uint32_t index) {
@@ -136,6 +136,7 @@ namespace foundation {
         
         void draw(std::uint32_t vertexCount) override;
         void draw(const RenderDataPtr &inputData, std::uint32_t instanceCount) override;
+        void draw(const RenderDataPtr &inputData, std::uint32_t start, std::uint32_t count, std::uint32_t instanceCount) override;
         void draw(const void *data, std::uint32_t vcnt, const std::uint32_t *indexes = nullptr, std::uint32_t icnt = 0) override;
         void presentFrame() override;
         
@@ -17,9 +17,9 @@ extern "C" {
     void webgl_applyShader(WebGLId shader, std::uint32_t ztype, std::uint32_t btype);
     void webgl_applyConstants(std::uint32_t index, const void *drawConstants, std::uint32_t byteLength);
     void webgl_applyTexture(std::uint32_t index, WebGLId texture, int samplingType);
-    void webgl_drawDefault(WebGLId data, std::uint32_t vertexCount, std::uint32_t instanceCount, GLenum topology);
-    void webgl_drawIndexed(WebGLId data, std::uint32_t indexCount, std::uint32_t instanceCount, GLenum topology);
-    void webgl_drawWithRepeat(WebGLId data, std::uint32_t attrCount, std::uint32_t instanceCount, std::uint32_t vertexCount, std::uint32_t totalInstCount, GLenum topology);
+    void webgl_drawDefault(WebGLId data, std::uint32_t vertexStart, std::uint32_t vertexCount, std::uint32_t instanceCount, GLenum topology);
+    void webgl_drawIndexed(WebGLId data, std::uint32_t indexStart, std::uint32_t indexCount, std::uint32_t instanceCount, GLenum topology);
+    void webgl_drawWithRepeat(WebGLId data, std::uint32_t attrCount, std::uint32_t instanceCount, std::uint32_t vertexCount, std::uint32_t totalInstCount, std::uint32_t vertexStart, GLenum topology);
     void webgl_deleteProgram(WebGLId id);
     void webgl_deleteData(WebGLId id);
     void webgl_deleteTexture(WebGLId id);
@@ -724,10 +724,10 @@ namespace foundation {
             const InputLayout &layout = _currentShader->getInputLayout();
             
             if (layout.repeat > 1) {
-                webgl_drawDefault(0, layout.repeat, vertexCount, g_topologies[int(_topology)]);
+                webgl_drawDefault(0, 0, layout.repeat, vertexCount, g_topologies[int(_topology)]);
             }
             else {
-                webgl_drawDefault(0, vertexCount, 1, g_topologies[int(_topology)]);
+                webgl_drawDefault(0, 0, vertexCount, 1, g_topologies[int(_topology)]);
             }
         }
     }
@@ -735,24 +735,33 @@ namespace foundation {
     void WASMRendering::draw(const RenderDataPtr &inputData, std::uint32_t instanceCount) {
         const WASMData *platformData = static_cast<const WASMData *>(inputData.get());
         
+        if (platformData) {
+            draw(inputData, 0, platformData->getIndexCount() ? platformData->getIndexCount() : platformData->getVertexCount(), instanceCount);
+        }
+        else {
+            draw(inputData, 0, 1, instanceCount);
+        }
+    }
+    
+    void WASMRendering::draw(const RenderDataPtr &inputData, std::uint32_t start, std::uint32_t count, std::uint32_t instanceCount) {
+        const WASMData *platformData = static_cast<const WASMData *>(inputData.get());
+        
         if (_currentShader) {
             const InputLayout &layout = _currentShader->getInputLayout();
             WebGLId id = 0;
-            std::uint32_t vcount = 1;
             
             if (platformData) {
                 id = platformData->getWebGLData();
-                vcount = platformData->getVertexCount();
             }
             if (layout.repeat > 1) {
-                webgl_drawWithRepeat(id, std::uint32_t(layout.attributes.size()), instanceCount, layout.repeat, vcount * instanceCount, g_topologies[int(_topology)]);
+                webgl_drawWithRepeat(id, std::uint32_t(layout.attributes.size()), instanceCount, layout.repeat, count * instanceCount, start, g_topologies[int(_topology)]);
             }
             else {
-                if (platformData->getIndexCount()) {
-                    webgl_drawIndexed(id, platformData->getIndexCount(), instanceCount, g_topologies[int(_topology)]);
+                if (platformData && platformData->getIndexCount()) {
+                    webgl_drawIndexed(id, start, count, instanceCount, g_topologies[int(_topology)]);
                 }
                 else {
-                    webgl_drawDefault(id, vcount, instanceCount, g_topologies[int(_topology)]);
+                    webgl_drawDefault(id, start, count, instanceCount, g_topologies[int(_topology)]);
                 }
             }
         }
@@ -766,6 +775,8 @@ namespace foundation {
         for (std::size_t i = 0; i < MAX_TEXTURES; i++) {
             webgl_applyTexture(i, 0, 0);
         }
+        
+        util::FrameArena::instance().reset();
     }
     
     std::uint8_t *WASMRendering::_getUploadBuffer(std::size_t requiredLength) {
@@ -1,6 +1,7 @@
 
 #include "util.h"
 #include "math.h"
+#include <algorithm>
 
 namespace util {
     std::int64_t strstream::atoi(const char *s, std::size_t &len) {
@@ -196,6 +197,59 @@ namespace util {
     }
 }
 
+namespace util {
+    FrameArena &FrameArena::instance() {
+        static FrameArena arena;
+        return arena;
+    }
+    
+    void *FrameArena::allocate(std::size_t size, std::size_t alignment) {
+        while (true) {
+            if (_currentBlock < _blocks.size()) {
+                Block &block = _blocks[_currentBlock];
+                const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(block.data.get());
+                const std::size_t offset = ((base + _offset + alignment - 1) & ~(alignment - 1)) - base;
+                
+                if (offset + size <= block.size) {
+                    _offset = offset + size;
+                    _frameBytes += size;
+                    _peakFrameBytes = std::max(_peakFrameBytes, _frameBytes);
+                    return block.data.get() + offset;
+                }
+                if (_currentBlock + 1 < _blocks.size()) {
+                    _currentBlock++;
+                    _offset = 0;
+                    continue;
+                }
+            }
+            
+            const std::size_t lastSize = _blocks.empty() ? 0 : _blocks.back().size;
+            const std::size_t blockSize = std::max(std::max(MIN_BLOCK_SIZE, 2 * lastSize), size + alignment);
+            _blocks.emplace_back(Block { std::make_unique<std::uint8_t[]>(blockSize), blockSize });
+            _heapAllocationCount++;
+            _currentBlock = _blocks.size() - 1;
+            _offset = 0;
+        }
+    }
+    
+    void FrameArena::reset() {
+        // Overflow blocks are merged, so next frame of the same weight fits a single block
+        if (_blocks.size() > 1) {
+            std::size_t totalSize = 0;
+            for (const Block &block : _blocks) {
+                totalSize += block.size;
+            }
+            _blocks.clear();
+            _blocks.emplace_back(Block { std::make_unique<std::uint8_t[]>(totalSize), totalSize });
+            _heapAllocationCount++;
+        }
+        
+        _currentBlock = 0;
+        _offset = 0;
+        _frameBytes = 0;
+    }
+}
+
 namespace util {
     Description Description::emptyDesc = {};
     Description Description::parse(const std::uint8_t *data, std::size_t length) {
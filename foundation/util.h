@@ -2,8 +2,12 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <new>
+#include <type_traits>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <unordered_map>
@@ -24,41 +28,37 @@ TODO:
  */
 
 namespace util {
+    // Lambdas up to INLINE_SIZE bytes are stored in the callback itself, bigger ones are allocated on heap
+    //
     template <typename M> class callback final {};
     template <typename R, typename... Args> class callback <R(Args...)> final {
+    public:
+        static const std::size_t INLINE_SIZE = 48;
+        
+        template <typename L> static constexpr bool isInline() {
+            return sizeof(L) <= INLINE_SIZE && alignof(L) <= alignof(std::uint64_t) && std::is_nothrow_move_constructible_v<L>;
+        }
+        
     public:
         callback() {}
         template <typename L, R(L::*)(Args...) const = &L::operator()> callback(L&& lambda) {
-            _data.target = new L (std::move(lambda));
-            _data.call = [](void *ptr, Args... args) {
-                return (static_cast<L *>(ptr))->operator()(std::forward<Args>(args)...);
-            };
-            _data.clean = [](void *ptr) {
-                delete static_cast<L *>(ptr);
-            };
+            _init(std::move(lambda));
         }
         template <typename L, R(L::*)(Args...) = &L::operator()> callback(L&& lambda) {
-            _data.target = new L (std::move(lambda));
-            _data.call = [](void *ptr, Args... args) {
-                return (static_cast<L *>(ptr))->operator()(std::forward<Args>(args)...);
-            };
-            _data.clean = [](void *ptr) {
-                delete static_cast<L *>(ptr);
-            };
+            _init(std::move(lambda));
         }
         
-        callback(callback &&other) : _data(std::move(other._data)) {
-            other._data = {};
+        callback(callback &&other) {
+            _moveFrom(other);
         }
         callback& operator =(callback &&other) {
-            _data.clean(_data.target);
-            _data = other._data;
-            other._data = {};
+            _reset();
+            _moveFrom(other);
             return *this;
         }
         
         ~callback() {
-            _data.clean(_data.target);
+            _reset();
         }
         
         operator bool () const {
@@ -71,30 +71,139 @@ namespace util {
         
         decltype(auto) callAndReset(Args... args) {
             struct Guard {
-                Data &toClean;
+                callback &toClean;
                 ~Guard() {
-                    toClean.clean(toClean.target);
-                    toClean = {};
+                    toClean._reset();
                 }
             }
-            guard {_data};
+            guard {*this};
             return _data.call ? _data.call(_data.target, std::forward<Args>(args)...) : R();
         }
         
     private:
+        template <typename L> void _init(L &&lambda) {
+            _data.call = [](void *ptr, Args... args) {
+                return (static_cast<L *>(ptr))->operator()(std::forward<Args>(args)...);
+            };
+            
+            if constexpr (isInline<L>()) {
+                _data.target = new (_storage) L (std::move(lambda));
+                _data.manage = [](void *dst, void *src) {
+                    if (dst) {
+                        new (dst) L (std::move(*static_cast<L *>(src)));
+                    }
+                    static_cast<L *>(src)->~L();
+                };
+            }
+            else {
+                _data.target = new L (std::move(lambda));
+                _data.manage = [](void *, void *src) {
+                    delete static_cast<L *>(src);
+                };
+            }
+        }
+        
+        void _moveFrom(callback &other) {
+            _data = other._data;
+            
+            if (other._data.target == other._storage) {
+                _data.manage(_storage, other._storage);
+                _data.target = _storage;
+            }
+            
+            other._data = {};
+        }
+        
+        void _reset() {
+            if (_data.manage) {
+                _data.manage(nullptr, _data.target);
+            }
+            _data = {};
+        }
+        
         struct Data {
             R(*call)(void *ptr, Args...) = nullptr;
-            void (*clean)(void *ptr) = [](void *){};
+            void (*manage)(void *dst, void *src) = nullptr; // moves inline target to dst if dst != nullptr, then destroys src
             void *target = nullptr;
         }
         _data;
         
+        alignas(std::uint64_t) std::uint8_t _storage[INLINE_SIZE];
+        
     private:
         callback(const callback &) = delete;
         callback& operator =(const callback &) = delete;
     };
 }
 
+namespace util {
+    // Bump allocator for temporary data that lives until the end of the current frame
+    // All memory is reclaimed at once by RenderingInterface::presentFrame, so frame data must not be kept across frames
+    // Main thread only
+    //
+    class FrameArena {
+    public:
+        static FrameArena &instance();
+        
+    public:
+        auto allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t)) -> void *;
+        void reset();
+        
+        // Bytes allocated since last reset and the maximum of that value among all frames
+        //
+        auto getFrameBytes() const -> std::size_t { return _frameBytes; }
+        auto getPeakFrameBytes() const -> std::size_t { return _peakFrameBytes; }
+        
+        // How many times arena had to request memory from heap. Stops growing once the arena fits the heaviest frame
+        //
+        auto getHeapAllocationCount() const -> std::size_t { return _heapAllocationCount; }
+        
+    private:
+        static constexpr std::size_t MIN_BLOCK_SIZE = 64 * 1024;
+        
+        struct Block {
+            std::unique_ptr<std::uint8_t[]> data;
+            std::size_t size = 0;
+        };
+        
+        std::vector<Block> _blocks;
+        std::size_t _currentBlock = 0;
+        std::size_t _offset = 0;
+        std::size_t _frameBytes = 0;
+        std::size_t _peakFrameBytes = 0;
+        std::size_t _heapAllocationCount = 0;
+    };
+    
+    // STL allocator over FrameArena. Deallocation does nothing, memory is returned at the end of the frame
+    //
+    template<typename T> struct FrameAllocator {
+        using value_type = T;
+        
+        FrameAllocator() = default;
+        template<typename U> FrameAllocator(const FrameAllocator<U> &) {}
+        
+        T *allocate(std::size_t n) {
+            return static_cast<T *>(FrameArena::instance().allocate(n * sizeof(T), alignof(T)));
+        }
+        void deallocate(T *, std::size_t) {}
+        
+        template<typename U> bool operator ==(const FrameAllocator<U> &) const { return true; }
+        template<typename U> bool operator !=(const FrameAllocator<U> &) const { return false; }
+    };
+    
+    template<typename T> using FrameVector = std::vector<T, FrameAllocator<T>>;
+    using FrameString = std::basic_string<char, std::char_traits<char>, FrameAllocator<char>>;
+    
+    // Hash for unordered containers with std::string keys. Allows lookup by std::string_view or const char * without constructing std::string
+    //
+    struct StringHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    };
+    
+    template<typename T> using StringMap = std::unordered_map<std::string, T, StringHash, std::equal_to<>>;
+}
+
 namespace util {
     class strstream {
     public:
@@ -367,6 +476,15 @@ namespace util {
         auto getVector2is(const char *name) const -> std::vector<math::vector2i> { return _getAllValues<math::vector2i>(name); }
         auto getVector3is(const char *name) const -> std::vector<math::vector3i> { return _getAllValues<math::vector3i>(name); }
         auto getVector4is(const char *name) const -> std::vector<math::vector4i> { return _getAllValues<math::vector4i>(name); }
+        
+        // Same as above but values are appended to frame-lifetime @output
+        //
+        void getIntegers(const char *name, FrameVector<std::int64_t> &output) const { _getAllValues(name, output); }
+        void getNumbers(const char *name, FrameVector<double> &output) const { _getAllValues(name, output); }
+        void getVector2fs(const char *name, FrameVector<math::vector2f> &output) const { _getAllValues(name, output); }
+        void getVector3fs(const char *name, FrameVector<math::vector3f> &output) const { _getAllValues(name, output); }
+        void getVector4fs(const char *name, FrameVector<math::vector4f> &output) const { _getAllValues(name, output); }
+        
         auto getDescriptions(const char *name) const -> std::vector<const util::Description *> {
             std::vector<const util::Description *> result;
             auto range = this->equal_range(name);
@@ -421,13 +539,16 @@ namespace util {
         }
         template <typename T> std::vector<T> _getAllValues(const char *name) const {
             std::vector<T> result;
+            _getAllValues(name, result);
+            return result;
+        }
+        template <typename T, typename A> void _getAllValues(const char *name, std::vector<T, A> &output) const {
             auto range = this->equal_range(name);
             for (auto index = range.first; index != range.second; ++index) {
                 if (std::holds_alternative<T>(index->second)) {
-                    result.emplace_back(*std::get_if<T>(&index->second));
+                    output.emplace_back(*std::get_if<T>(&index->second));
                 }
             }
-            return result;
         }
         template <typename T> std::unordered_map<std::string, T> _getAllValues() const {
             std::unordered_map<std::string, T> result;
@@ -443,16 +564,107 @@ namespace util {
 }
 
 namespace util {
-    template<typename T> void cleanupUnused(std::vector<T> &v) {
-        for (auto index = v.begin(); index != v.end(); ) {
-            if (index->use_count() <= 1) {
-                *index = v.back();
-                v.pop_back();
+    struct SlotHandle {
+        static const std::uint32_t INVALID_INDEX = std::uint32_t(-1);
+        
+        std::uint32_t index = INVALID_INDEX;
+        std::uint32_t generation = 0;
+    };
+    
+    // Dense array of values addressed by generational handles. Handle of a released value never resolves again
+    // Iteration goes over values in insertion order. Released value is reset to T{} in place and removed by compact(), which keeps the order
+    //
+    template<typename T> class SlotMap {
+    public:
+        auto insert(T &&value) -> SlotHandle {
+            std::uint32_t slotIndex;
+            if (_freeSlots.empty()) {
+                slotIndex = std::uint32_t(_slots.size());
+                _slots.emplace_back();
             }
             else {
-                ++index;
+                slotIndex = _freeSlots.back();
+                _freeSlots.pop_back();
+            }
+            
+            _slots[slotIndex].valueIndex = std::uint32_t(_values.size());
+            _values.emplace_back(std::move(value));
+            _valueSlots.emplace_back(slotIndex);
+            return SlotHandle { slotIndex, _slots[slotIndex].generation };
+        }
+        bool release(SlotHandle handle) {
+            if (handle.index < _slots.size() && _slots[handle.index].generation == handle.generation) {
+                Slot &slot = _slots[handle.index];
+                _values[slot.valueIndex] = T{};
+                _valueSlots[slot.valueIndex] = SlotHandle::INVALID_INDEX;
+                _freeSlots.emplace_back(handle.index);
+                _releasedCount++;
+                slot.valueIndex = SlotHandle::INVALID_INDEX;
+                slot.generation++;
+                return true;
+            }
+            return false;
+        }
+        auto get(SlotHandle handle) -> T * {
+            if (handle.index < _slots.size() && _slots[handle.index].generation == handle.generation) {
+                return &_values[_slots[handle.index].valueIndex];
+            }
+            return nullptr;
+        }
+        
+        // O(n) if anything was released since previous call, otherwise does nothing
+        //
+        void compact() {
+            if (_releasedCount) {
+                std::size_t count = 0;
+                for (std::size_t i = 0; i < _values.size(); i++) {
+                    if (_valueSlots[i] != SlotHandle::INVALID_INDEX) {
+                        if (count != i) {
+                            _values[count] = std::move(_values[i]);
+                            _valueSlots[count] = _valueSlots[i];
+                            _slots[_valueSlots[count]].valueIndex = std::uint32_t(count);
+                        }
+                        count++;
+                    }
+                }
+                
+                _values.resize(count);
+                _valueSlots.resize(count);
+                _releasedCount = 0;
             }
         }
+        
+        auto size() const -> std::size_t { return _values.size(); }
+        auto operator[](std::size_t index) -> T & { return _values[index]; }
+        auto operator[](std::size_t index) const -> const T & { return _values[index]; }
+        auto begin() { return _values.begin(); }
+        auto end() { return _values.end(); }
+        auto begin() const { return _values.begin(); }
+        auto end() const { return _values.end(); }
+        
+    private:
+        struct Slot {
+            std::uint32_t valueIndex = SlotHandle::INVALID_INDEX;
+            std::uint32_t generation = 0;
+        };
+        
+        std::vector<T> _values;
+        std::vector<std::uint32_t> _valueSlots;
+        std::vector<Slot> _slots;
+        std::vector<std::uint32_t> _freeSlots;
+        std::size_t _releasedCount = 0;
+    };
+    
+    // Registers @object in @map and returns its owning pointer. When the last reference is gone, object is released from @map and deleted
+    // Map is kept alive by its objects. The last reference must be dropped on the thread that iterates the map
+    //
+    template<typename T, typename U> std::shared_ptr<U> makeSlotShared(const std::shared_ptr<SlotMap<T *>> &map, std::unique_ptr<U> &&object) {
+        U *ptr = object.release();
+        const SlotHandle handle = map->insert(static_cast<T *>(ptr));
+        return std::shared_ptr<U>(ptr, [map, handle](U *p) {
+            map->release(handle);
+            delete p;
+        });
     }
 }
 
@@ -16,8 +16,8 @@ namespace game {
         }
         else {
             resourcePath = path;
-            api.resources->getOrLoadVoxelMesh(path.c_str(), [this, &api](const std::vector<foundation::RenderDataPtr> &data, const util::Description& desc) {
-                mesh = api.scene->addVoxelMesh(data, desc);
+            api.resources->getOrLoadVoxelMesh(path.c_str(), [this, &api](const foundation::RenderDataPtr &data, const std::vector<std::uint32_t> &frameOffsets, const util::Description& desc) {
+                mesh = api.scene->addVoxelMesh(data, frameOffsets, desc);
                 api.platform->sendEditorMsg("engine.refresh", EDITOR_REFRESH_PARAM);
             });
         }
@@ -67,7 +67,9 @@ namespace game {
                             _currentAnimationTime.value() -= float(anim->second.z) / 1000.0f;
                         }
                     }
-                    node->mesh->setFrame(anim->second.x + std::uint32_t(frameOffset));
+                    const std::uint32_t frame = std::uint32_t(frameOffset);
+                    const std::uint32_t nextFrame = frame + 1 < std::uint32_t(length) ? frame + 1 : (_animationLooped ? 0 : frame);
+                    node->mesh->setFrame(anim->second.x + frame, anim->second.x + nextFrame, frameOffset - float(frame));
                     _currentAnimationTime.value() += dtSec;
                 }
             }
@@ -133,9 +135,10 @@ namespace game {
             _nodeAccess.forEachNode([this](const std::shared_ptr<EditorNode> &node) {
                 std::shared_ptr<EditorNodeVoxelMesh> meshNode = std::dynamic_pointer_cast<EditorNodeVoxelMesh>(node);
                 if (meshNode && meshNode->mesh) {
-                    _api.resources->getOrLoadVoxelMesh(meshNode->resourcePath.data(), [meshNode, this](const std::vector<foundation::RenderDataPtr> &data, const util::Description& desc) {
-                        meshNode->mesh = _api.scene->addVoxelMesh(data, desc);
-                        meshNode->mesh->setPosition(meshNode->globalPosition);
+                    _api.resources->getOrLoadVoxelMesh(meshNode->resourcePath.data(), [meshNode, this](const foundation::RenderDataPtr &data, const std::vector<std::uint32_t> &frameOffsets, const util::Description& desc) {
+                        if ((meshNode->mesh = _api.scene->addVoxelMesh(data, frameOffsets, desc))) {
+                            meshNode->mesh->setPosition(meshNode->globalPosition);
+                        }
                         _api.platform->sendEditorMsg("engine.refresh", EDITOR_REFRESH_PARAM);
                     });
                 }
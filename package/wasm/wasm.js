@@ -321,7 +321,10 @@ const imports = {
             glbuffers[glBufferIDCounter] = {
                 indexes: ibo,
                 buffer: vbo,
-                layout: vao
+                layout: vao,
+                formats: Array.from(lmem),
+                stride: stride,
+                start: 0
             };
 
             return glBufferIDCounter++;
@@ -457,22 +460,32 @@ const imports = {
             glcontext.bindTexture(glcontext.TEXTURE_2D, texture);
             glcontext.bindSampler(index, glsamplers[samplingType]);
         },
-        webgl_drawDefault: function(buffer, vertexCount, instanceCount, topology) {
+        webgl_drawDefault: function(buffer, vertexStart, vertexCount, instanceCount, topology) {
             if (uniformInstanceCountLocation) {
                 glcontext.uniform1i(uniformInstanceCountLocation, instanceCount);
             }
             glcontext.bindVertexArray(glbuffers[buffer].layout);
-            glcontext.drawArraysInstanced(topology, 0, vertexCount, instanceCount);
+            glcontext.drawArraysInstanced(topology, vertexStart, vertexCount, instanceCount);
         },
-        webgl_drawIndexed: function(buffer, indexCount, instanceCount, topology) {
+        webgl_drawIndexed: function(buffer, indexStart, indexCount, instanceCount, topology) {
             glcontext.bindVertexArray(glbuffers[buffer].layout);
-            glcontext.drawElementsInstanced(topology, indexCount, glcontext.UNSIGNED_INT, 0, instanceCount);
+            glcontext.drawElementsInstanced(topology, indexCount, glcontext.UNSIGNED_INT, indexStart * 4, instanceCount);
         },
-        webgl_drawWithRepeat: function(buffer, attrCount, instanceCount, vertexCount, totalInstCount, topology) {
+        webgl_drawWithRepeat: function(buffer, attrCount, instanceCount, vertexCount, totalInstCount, vertexStart, topology) {
+            const data = glbuffers[buffer];
             if (uniformInstanceCountLocation) {
                 glcontext.uniform1i(uniformInstanceCountLocation, instanceCount);
             }
-            glcontext.bindVertexArray(glbuffers[buffer].layout);
+            glcontext.bindVertexArray(data.layout);
+            // WebGL2 has no base instance, so per-instance attributes are rebased to the first vertex of the range
+            if (data.start != vertexStart) {
+                glcontext.bindBuffer(glcontext.ARRAY_BUFFER, data.buffer);
+                for (let i = 0, offset = vertexStart * data.stride; i < attrCount; i++) {
+                    offset += vertexAttribFunctions[data.formats[i]](i, data.stride, offset);
+                }
+                glcontext.bindBuffer(glcontext.ARRAY_BUFFER, null);
+                data.start = vertexStart;
+            }
             for (let i = 0; i < attrCount; i++) {
                 glcontext.vertexAttribDivisor(i, instanceCount);
             }
@@ -550,7 +563,10 @@ worker.onmessage = (msg) => {
         
         glbuffers[0] = {
             buffer: glcontext.createBuffer(),
-            layout: glcontext.createVertexArray()
+            layout: glcontext.createVertexArray(),
+            formats: [],
+            stride: 0,
+            start: 0
         };
         glcontext.bindVertexArray(glbuffers[0].layout);
         glcontext.bindBuffer(glcontext.ARRAY_BUFFER, glbuffers[0].buffer);
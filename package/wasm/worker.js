@@ -48,9 +48,9 @@ onmessage = (msg) => {
                 webgl_applyShader: (shaderID, ztype, btype) => { throw "can't access webgl from background" },
                 webgl_applyConstants: (index, ptr, len) => { throw "can't access webgl from background" },
                 webgl_applyTexture: (index, textureID, samplingType) => { throw "can't access webgl from background" },
-                webgl_drawDefault: (buffer, vertexCount, instanceCount, topology) => { throw "can't access webgl from background" },
-                webgl_drawIndexed: (buffer, indexes, indexCount, topology) => { throw "can't access webgl from background" },
-                webgl_drawWithRepeat: (buffer, attrCount, instanceCount, vertexCount, totalInstCount, topology) => { throw "can't access webgl from background" }
+                webgl_drawDefault: (buffer, vertexStart, vertexCount, instanceCount, topology) => { throw "can't access webgl from background" },
+                webgl_drawIndexed: (buffer, indexStart, indexCount, instanceCount, topology) => { throw "can't access webgl from background" },
+                webgl_drawWithRepeat: (buffer, attrCount, instanceCount, vertexCount, totalInstCount, vertexStart, topology) => { throw "can't access webgl from background" }
             }
         };
 
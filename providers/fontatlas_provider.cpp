@@ -1,7 +1,12 @@
 
 #include "fontatlas_provider.h"
+#include "foundation/memory.h"
 #include "thirdparty/stb_mini_ttf/stb_mini_ttf.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
 #include <list>
 #include <unordered_set>
 #include <unordered_map>
@@ -9,8 +14,20 @@
 #include <bit>
 
 namespace {
-    static const int ATLAS_SIZE = 512;
-    static const int ATLAS_SPACE = 10;
+    const std::uint8_t MEMORY_TAG_FONT_PIXELS = 5; // lower tags of the pool are used by resource provider
+    const std::uint8_t MEMORY_TAG_FONT_METRICS = 6;
+    
+    const int PAGE_WIDTH = 512;
+    const int PAGE_HEIGHT_MIN = 64;
+    const int PAGE_HEIGHT_MAX = 512;
+    const int GLYPH_SPACING = 1; // blur reads one pixel around glyph
+    
+    const std::uint8_t BLUR_SDF = 0xff; // blur value in keys of distance field glyphs
+    const int SDF_UPSCALE = 4;          // distance is found on upscaled glyph and averaged
+    const float SDF_FAR = 1e20f;
+    
+    const std::uint32_t METRICS_ASCII_COUNT = 128;
+    const std::uint32_t METRICS_EMPTY_KEY = 0xffffffff;
 
     std::uint32_t utf8ToUTF16(const char *utf8Char, std::uint32_t &utf8Len) {
         const std::uint8_t *src = (const std::uint8_t *)utf8Char;
@@ -58,34 +75,225 @@ namespace {
     std::uint32_t getU16Ch(std::uint64_t key) {
         return std::uint32_t(key & 0xffffffff);
     }
-    std::uint8_t getBlur(std::uint64_t key) {
-        return std::uint8_t(key >> 56);
+    
+    struct GlyphMetrics {
+        int glyph = 0;                  // zero if font hasn't the char
+        float advance = 0.0f;           // rounded up, like in getTextWidth
+        float lsb = 0.0f;
+    };
+    
+    // Metrics of chars of one font size. ASCII chars are in array, the others are in open addressing table
+    // with linear probing. Codepoints of one script are contiguous, so codepoint itself is a good hash
+    //
+    struct GlyphMetricsCache {
+        const stbtt_fontinfo *ttf;
+        float scale;
+        GlyphMetrics ascii[METRICS_ASCII_COUNT];
+        std::vector<std::uint32_t, foundation::PoolAllocator<std::uint32_t, foundation::MemoryPoolId::RESOURCES, MEMORY_TAG_FONT_METRICS>> keys;
+        std::vector<GlyphMetrics, foundation::PoolAllocator<GlyphMetrics, foundation::MemoryPoolId::RESOURCES, MEMORY_TAG_FONT_METRICS>> values;
+        std::size_t count = 0;
+        
+        GlyphMetricsCache(const stbtt_fontinfo *ttf, std::uint8_t fontSize) : ttf(ttf), scale(stbtt_ScaleForMappingEmToPixels(ttf, float(fontSize))) {
+            for (std::uint32_t i = 0; i < METRICS_ASCII_COUNT; i++) {
+                ascii[i] = makeMetrics(i);
+            }
+        }
+        
+        GlyphMetrics makeMetrics(std::uint32_t u16ch) const {
+            GlyphMetrics result;
+            
+            if ((result.glyph = stbtt_FindGlyphIndex(ttf, int(u16ch))) != 0) {
+                int iadvance, ilsb;
+                stbtt_GetGlyphHMetrics(ttf, result.glyph, &iadvance, &ilsb);
+                result.advance = ceilfloat(scale * float(iadvance));
+                result.lsb = floorfloat(scale * float(ilsb));
+            }
+            
+            return result;
+        }
+        
+        const GlyphMetrics &get(std::uint32_t u16ch) {
+            if (u16ch < METRICS_ASCII_COUNT) {
+                return ascii[u16ch];
+            }
+            if (2 * (count + 1) > keys.size()) {
+                grow();
+            }
+            
+            std::size_t slot = u16ch & (keys.size() - 1);
+            
+            while (keys[slot] != METRICS_EMPTY_KEY) {
+                if (keys[slot] == u16ch) {
+                    return values[slot];
+                }
+                slot = (slot + 1) & (keys.size() - 1);
+            }
+            
+            keys[slot] = u16ch;
+            values[slot] = makeMetrics(u16ch);
+            count++;
+            return values[slot];
+        }
+        
+        void grow() {
+            auto oldKeys = std::move(keys);
+            auto oldValues = std::move(values);
+            
+            keys.assign(std::max(std::size_t(64), 2 * oldKeys.size()), METRICS_EMPTY_KEY);
+            values.resize(keys.size());
+            
+            for (std::size_t i = 0; i < oldKeys.size(); i++) {
+                if (oldKeys[i] != METRICS_EMPTY_KEY) {
+                    std::size_t slot = oldKeys[i] & (keys.size() - 1);
+                    while (keys[slot] != METRICS_EMPTY_KEY) {
+                        slot = (slot + 1) & (keys.size() - 1);
+                    }
+                    keys[slot] = oldKeys[i];
+                    values[slot] = oldValues[i];
+                }
+            }
+        }
+    };
+    
+    int floorDiv(int a, int b) {
+        return a >= 0 ? a / b : -((b - 1 - a) / b);
+    }
+    
+    // Box of distance field glyph in pixels of reference size without spread, and box of upscaled glyph
+    //
+    void getSDFGlyphBox(const stbtt_fontinfo *ttf, int glyph, float scale, int (&box)[4], int (&upscaledBox)[4]) {
+        stbtt_GetGlyphBitmapBox(ttf, glyph, scale * SDF_UPSCALE, scale * SDF_UPSCALE, &upscaledBox[0], &upscaledBox[1], &upscaledBox[2], &upscaledBox[3]);
+        box[0] = floorDiv(upscaledBox[0], SDF_UPSCALE);
+        box[1] = floorDiv(upscaledBox[1], SDF_UPSCALE);
+        box[2] = floorDiv(upscaledBox[2] + SDF_UPSCALE - 1, SDF_UPSCALE);
+        box[3] = floorDiv(upscaledBox[3] + SDF_UPSCALE - 1, SDF_UPSCALE);
+    }
+    
+    // Squared euclidean distance transform of a row or a column in place (Felzenszwalb & Huttenlocher)
+    // @f, @v, @z - scratch buffers of @count, @count and @count + 1 items
+    //
+    void distanceTransform(float *data, int count, int stride, float *f, int *v, float *z) {
+        for (int q = 0; q < count; q++) {
+            f[q] = data[q * stride];
+        }
+        
+        int k = 0;
+        v[0] = 0;
+        z[0] = -SDF_FAR;
+        z[1] = SDF_FAR;
+        
+        for (int q = 1; q < count; q++) {
+            float s = ((f[q] + float(q * q)) - (f[v[k]] + float(v[k] * v[k]))) / float(2 * (q - v[k]));
+            
+            while (s <= z[k]) {
+                k--;
+                s = ((f[q] + float(q * q)) - (f[v[k]] + float(v[k] * v[k]))) / float(2 * (q - v[k]));
+            }
+            
+            k++;
+            v[k] = q;
+            z[k] = s;
+            z[k + 1] = SDF_FAR;
+        }
+        
+        k = 0;
+        
+        for (int q = 0; q < count; q++) {
+            while (z[k + 1] < float(q)) {
+                k++;
+            }
+            
+            const float d = float(q - v[k]);
+            data[q * stride] = d * d + f[v[k]];
+        }
+    }
+    
+    // Glyph is rasterized SDF_UPSCALE times bigger, distances of upscaled pixels are averaged to one output pixel
+    // @output  - left top corner of glyph rectangle with spread border
+    //
+    void makeGlyphSDF(const stbtt_fontinfo *ttf, int glyph, float scale, std::uint8_t *output, int w, int h, int stride) {
+        int box[4], upscaledBox[4];
+        getSDFGlyphBox(ttf, glyph, scale, box, upscaledBox);
+        
+        const int uw = w * SDF_UPSCALE;
+        const int uh = h * SDF_UPSCALE;
+        const int ux = resource::FontAtlasProvider::SDF_SPREAD * SDF_UPSCALE + upscaledBox[0] - box[0] * SDF_UPSCALE;
+        const int uy = resource::FontAtlasProvider::SDF_SPREAD * SDF_UPSCALE + upscaledBox[1] - box[1] * SDF_UPSCALE;
+        
+        std::vector<std::uint8_t> coverage(std::size_t(uw) * uh, 0);
+        stbtt_MakeGlyphBitmap(ttf, coverage.data() + uy * uw + ux, upscaledBox[2] - upscaledBox[0], upscaledBox[3] - upscaledBox[1], uw, scale * SDF_UPSCALE, scale * SDF_UPSCALE, glyph);
+        
+        // Squared distances to the nearest inside pixel and to the nearest outside pixel
+        std::vector<float> toInside(coverage.size());
+        std::vector<float> toOutside(coverage.size());
+        
+        for (std::size_t i = 0; i < coverage.size(); i++) {
+            toInside[i] = coverage[i] > 127 ? 0.0f : SDF_FAR;
+            toOutside[i] = coverage[i] > 127 ? SDF_FAR : 0.0f;
+        }
+        
+        const int side = std::max(uw, uh);
+        std::vector<float> f(side), z(side + 1);
+        std::vector<int> v(side);
+        
+        for (float *grid : {toInside.data(), toOutside.data()}) {
+            for (int x = 0; x < uw; x++) {
+                distanceTransform(grid + x, uh, uw, f.data(), v.data(), z.data());
+            }
+            for (int y = 0; y < uh; y++) {
+                distanceTransform(grid + y * uw, uw, 1, f.data(), v.data(), z.data());
+            }
+        }
+        
+        // Sum of SDF_UPSCALE^2 distances in upscaled pixels -> distance in reference pixels -> texel value
+        const float norm = 127.0f / float(resource::FontAtlasProvider::SDF_SPREAD * SDF_UPSCALE * SDF_UPSCALE * SDF_UPSCALE);
+        
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                float sum = 0.0f;
+                
+                for (int by = 0; by < SDF_UPSCALE; by++) {
+                    for (int bx = 0; bx < SDF_UPSCALE; bx++) {
+                        const std::size_t i = std::size_t(y * SDF_UPSCALE + by) * uw + x * SDF_UPSCALE + bx;
+                        sum += toOutside[i] > 0.0f ? std::sqrt(toOutside[i]) - 0.5f : 0.5f - std::sqrt(toInside[i]);
+                    }
+                }
+                
+                output[y * stride + x] = std::uint8_t(std::clamp(128.0f + sum * norm, 0.0f, 255.0f));
+            }
+        }
     }
-
 }
 
 namespace resource {
     class FontAtlasProviderImpl : public std::enable_shared_from_this<FontAtlasProviderImpl>, public FontAtlasProvider {
     public:
-        struct FontAtlas {
-            struct CharInfo {
-                math::vector2f txLT;
-                math::vector2f txRB;
-                math::vector2f pxSize;
-                float advance, lsb, voffset;
-                std::uint8_t blur;
-            };
+        struct Glyph {
+            int x = 0, y = 0, w = 0, h = 0; // rectangle in page with blur border
+            float advance = 0.0f, lsb = 0.0f, voffset = 0.0f;
+            std::uint32_t lastUse = 0;      // frame of the last request
+            bool missing = false;           // font hasn't this char
+        };
+        
+        // Glyphs are placed by shelves. Page grows in height and when it's full, glyphs unused since the last
+        // texture replacement are evicted. Glyphs are marked as used when they are requested and when they are delivered
+        // with the texture. Users of replaced texture request their texts again in the next frame
+        //
+        struct FontPage {
+            // --- used from worker thread while async operation is in progress ---
+            foundation::PoolBytes txdata;
             
-            // --- used from worker thread ---
-            std::unique_ptr<std::uint8_t[]> txdata;
-            int offsetX = ATLAS_SPACE;
-            int offsetY = ATLAS_SPACE;
-
             // --- used from main thread ---
-            std::unordered_map<std::uint64_t, CharInfo> chars;
+            std::unordered_map<std::uint64_t, Glyph> glyphs;
             foundation::RenderTexturePtr texture = nullptr;
             std::uint8_t fontSize = 0;
             float baseLine = 0.0f;
+            int height = 0;
+            int shelfX = GLYPH_SPACING;
+            int shelfY = GLYPH_SPACING;
+            int shelfHeight = 0;
+            std::uint32_t textureFrame = 0;
+            bool dirty = false;             // texture doesn't have all glyphs
         };
         
     public:
@@ -94,10 +302,24 @@ namespace resource {
         
         auto getTextWidth(const char *text, std::uint8_t fontSize) const -> math::vector2f override;
         void getTextFontAtlas(const char *text, std::uint8_t fontSize, std::uint8_t blur, util::callback<void(std::vector<FontCharInfo> &&, const foundation::RenderTexturePtr &)> &&completion) override;
+        void getTextFontAtlasSDF(const char *text, std::uint8_t fontSize, util::callback<void(std::vector<FontCharInfo> &&, const foundation::RenderTexturePtr &)> &&completion) override;
+        auto getStats() const -> FontAtlasStats override;
         void update(float dtSec) override;
         
     private:
-        FontAtlas *_collectChars(const char *text, std::uint8_t fontSize, std::uint8_t blur, std::vector<FontCharInfo> &readyChars, std::unordered_set<std::uint64_t> &toLoad);
+        struct RasterJob {
+            int glyph;
+            int x, y, w, h;
+        };
+        
+        void _requestText(const char *text, std::uint8_t fontSize, std::uint8_t blur, std::uint8_t targetSize, util::callback<void(std::vector<FontCharInfo> &&, const foundation::RenderTexturePtr &)> &&completion);
+        auto _getMetrics(std::uint8_t fontSize) const -> GlyphMetricsCache &;
+        auto _findPage(std::uint8_t fontSize, const std::vector<std::uint64_t> &keys, std::size_t &foundCount) -> FontPage *;
+        auto _placeText(std::uint8_t fontSize, const std::vector<std::uint64_t> &keys, std::uint8_t blur, FontPage *suitable, std::vector<RasterJob> &jobs) -> FontPage *;
+        auto _reserve(FontPage &page, const std::vector<std::uint64_t> &keys, std::uint8_t blur, std::vector<RasterJob> &jobs) -> bool;
+        auto _evictUnused(FontPage &page) -> bool;
+        auto _makeChars(FontPage &page, const char *text, std::uint8_t blur, std::uint8_t targetSize) -> std::vector<FontCharInfo>;
+        void _updateTexture(FontPage &page);
         
     private:
         const std::shared_ptr<foundation::PlatformInterface> _platform;
@@ -107,16 +329,24 @@ namespace resource {
         
         stbtt_fontinfo _ttfInfo;
         
+        // Created on first use of font size
+        mutable std::unique_ptr<GlyphMetricsCache> _metrics[256];
+        
         struct QueueEntry {
             std::string text;
             std::uint8_t fontSize;
             std::uint8_t blur;
+            std::uint8_t targetSize;        // chars are scaled to it from fontSize
             util::callback<void(std::vector<FontCharInfo> &&, const foundation::RenderTexturePtr &)> callback;
+            FontPage *page = nullptr;
         };
         
-        std::list<FontAtlas> _atlases;
+        std::list<FontPage> _pages;
         std::list<QueueEntry> _callsQueue;
         std::list<QueueEntry> _postponedQueue;
+        std::vector<std::uint64_t> _textKeys;
+        std::uint32_t _frame = 0;
+        FontAtlasStats _stats;
         bool _asyncInProgress;
     };
     
@@ -142,225 +372,502 @@ namespace resource {
     }
     
     math::vector2f FontAtlasProviderImpl::getTextWidth(const char *text, std::uint8_t size) const {
-        const float scale = stbtt_ScaleForMappingEmToPixels(&_ttfInfo, float(size));
+        GlyphMetricsCache &metrics = _getMetrics(size);
         float result = 0.0f;
-                
+        
         for (const char *src = text; *src; ) {
-            std::uint32_t len = 0;
-            const std::uint32_t u16ch = utf8ToUTF16(src, len);
-            
-            const int glyph = stbtt_FindGlyphIndex(&_ttfInfo, u16ch);
-            if (glyph != 0) {
-                int iadvance, ilsb;
-                stbtt_GetGlyphHMetrics(&_ttfInfo, glyph, &iadvance, &ilsb);
-                result += ceilfloat(scale * float(iadvance));
+            if (std::uint8_t(*src) < METRICS_ASCII_COUNT) {
+                result += metrics.ascii[std::uint8_t(*src++)].advance;
+            }
+            else {
+                std::uint32_t len = 0;
+                result += metrics.get(utf8ToUTF16(src, len)).advance;
+                src += len;
             }
-            
-            src += len;
         }
         
         return math::vector2f(result, float(size));
     }
     
     void FontAtlasProviderImpl::getTextFontAtlas(const char *text, std::uint8_t fontSize, std::uint8_t blur, util::callback<void(std::vector<FontCharInfo> &&, const foundation::RenderTexturePtr &)> &&completion) {
+        _requestText(text, fontSize, std::min(blur, std::uint8_t(BLUR_SDF - 1)), fontSize, std::move(completion));
+    }
+    
+    void FontAtlasProviderImpl::getTextFontAtlasSDF(const char *text, std::uint8_t fontSize, util::callback<void(std::vector<FontCharInfo> &&, const foundation::RenderTexturePtr &)> &&completion) {
+        _requestText(text, SDF_REFERENCE_SIZE, BLUR_SDF, fontSize, std::move(completion));
+    }
+    
+    void FontAtlasProviderImpl::_requestText(const char *text, std::uint8_t fontSize, std::uint8_t blur, std::uint8_t targetSize, util::callback<void(std::vector<FontCharInfo> &&, const foundation::RenderTexturePtr &)> &&completion) {
         if (_asyncInProgress) {
             _callsQueue.emplace_back(QueueEntry{
                 .text = text,
                 .fontSize = fontSize,
                 .blur = blur,
+                .targetSize = targetSize,
                 .callback = std::move(completion)
             });
             return;
         }
         
-        std::vector<FontCharInfo> readyChars;
-        std::unordered_set<std::uint64_t> toLoad;
-        FontAtlas *suitable = _collectChars(text, fontSize, blur, readyChars, toLoad);
+        _textKeys.clear();
         
-        if (toLoad.empty()) {
-            completion(std::move(readyChars), suitable->texture);
+        for (const char *src = text; *src; ) {
+            std::uint32_t len = 0;
+            _textKeys.emplace_back(makeKey(utf8ToUTF16(src, len), blur));
+            src += len;
+        }
+        
+        std::sort(_textKeys.begin(), _textKeys.end());
+        _textKeys.erase(std::unique(_textKeys.begin(), _textKeys.end()), _textKeys.end());
+        
+        std::size_t foundCount = 0;
+        FontPage *suitable = _findPage(fontSize, _textKeys, foundCount);
+        
+        _stats.hitCount += foundCount;
+        _stats.missCount += _textKeys.size() - foundCount;
+        
+        if (suitable && foundCount == _textKeys.size()) {
+            if (suitable->dirty) {
+                _postponedQueue.emplace_back(QueueEntry{
+                    .text = text,
+                    .fontSize = fontSize,
+                    .blur = blur,
+                    .targetSize = targetSize,
+                    .callback = std::move(completion),
+                    .page = suitable
+                });
+            }
+            else {
+                completion(_makeChars(*suitable, text, blur, targetSize), suitable->texture);
+            }
         }
         else {
-            _asyncInProgress = true;
+            std::vector<RasterJob> jobs;
             
-            struct AsyncContext {
-                std::unordered_map<std::uint64_t, FontAtlas::CharInfo> resultChars;
-            };
-            
-            if (suitable == nullptr) {
+            if ((suitable = _placeText(fontSize, _textKeys, blur, suitable, jobs)) == nullptr) {
                 const float scale = stbtt_ScaleForMappingEmToPixels(&_ttfInfo, float(fontSize));
                 int ascent, descent, lineGap;
                 stbtt_GetFontVMetrics(&_ttfInfo, &ascent, &descent, &lineGap);
                 
-                FontAtlas *newAtlas = &_atlases.emplace_front();
-                newAtlas->baseLine = std::roundf(float(ascent) * scale);
-                newAtlas->fontSize = fontSize;
-                newAtlas->txdata = std::make_unique<std::uint8_t[]>(ATLAS_SIZE * ATLAS_SIZE);
-                suitable = newAtlas;
+                suitable = &_pages.emplace_back();
+                suitable->baseLine = std::roundf(float(ascent) * scale);
+                suitable->fontSize = fontSize;
+                
+                if (_reserve(*suitable, _textKeys, blur, jobs) == false) {
+                    _platform->logError("[FontAtlasProviderImpl::_requestText] Text '%s' doesn't fit into atlas page", text);
+                    _pages.pop_back();
+                    completion({}, nullptr);
+                    return;
+                }
             }
             
-            _platform->executeAsync(std::make_unique<foundation::CommonAsyncTask<AsyncContext>>([weak = weak_from_this(), toLoad = std::move(toLoad), suitable, fontSize, blur](AsyncContext &ctx) {
+            _asyncInProgress = true;
+            
+            struct AsyncContext {};
+            
+            _platform->executeAsync(std::make_unique<foundation::CommonAsyncTask<AsyncContext>>([weak = weak_from_this(), jobs = std::move(jobs), txdata = suitable->txdata.get(), fontSize, blur](AsyncContext &) {
                 if (std::shared_ptr<FontAtlasProviderImpl> self = weak.lock()) {
                     //--- worker thread ---
                     const stbtt_fontinfo *ttf = &self->_ttfInfo;
                     const float scale = stbtt_ScaleForMappingEmToPixels(ttf, float(fontSize));
                     
-                    int ascent, descent, lineGap;
-                    stbtt_GetFontVMetrics(ttf, &ascent, &descent, &lineGap);
-                    int lineHeight = int(float(ascent - descent) * scale);
-                    
-                    for (std::uint16_t u16ch : toLoad) {
-                        int glyph = stbtt_FindGlyphIndex(ttf, u16ch);
-                        if (glyph != 0) {
-                            int ix0 = 0, ix1 = 0, iy0 = 0, iy1 = 0, iadvance, ilsb;
-
-                            stbtt_GetGlyphBitmapBox(ttf, glyph, scale, scale, &ix0, &iy0, &ix1, &iy1);
-                            stbtt_GetGlyphHMetrics(ttf, glyph, &iadvance, &ilsb);
-                            
-                            ix0 -= blur; ix1 += blur;
-                            iy0 -= blur; iy1 += blur;
-
-                            if (suitable->offsetX + ix1 - ix0 + 1 >= ATLAS_SIZE - ATLAS_SPACE) {
-                                suitable->offsetX = 10;
-                                suitable->offsetY = suitable->offsetY + lineHeight;
-                                
-                                if (suitable->offsetY >= ATLAS_SIZE - ATLAS_SPACE) { // TODO: atlas growing 4096x32 -> 4096x64 ...
-                                    self->_platform->logError("[FontAtlasProviderImpl::getTextFontAtlas] Atlas overflow");
-                                    return;
-                                }
-                            }
-                            
-                            FontAtlas::CharInfo &chInfo = ctx.resultChars.emplace(makeKey(u16ch, blur), FontAtlas::CharInfo{}).first->second;
-                            chInfo.advance = ceilfloat(scale * float(iadvance));
-                            chInfo.lsb = floorfloat(scale * float(ilsb));
-                            chInfo.pxSize = math::vector2f(ix1 - ix0, iy1 - iy0);
-                            chInfo.txLT = math::vector2f(suitable->offsetX - blur, suitable->offsetY + suitable->baseLine + iy0) / float(ATLAS_SIZE);
-                            chInfo.txRB = chInfo.txLT + chInfo.pxSize / float(ATLAS_SIZE);
-                            chInfo.voffset = suitable->baseLine + float(iy0);
-                            chInfo.blur = blur;
-
-                            if (ix1 > ix0 && iy1 > iy0) {
-                                int startY = suitable->offsetY + int(ceilfloat(suitable->baseLine)) + iy0;
-                                int startX = suitable->offsetX - blur;
-                                int offset = (startY + blur) * ATLAS_SIZE + startX;
-                                stbtt_MakeGlyphBitmap(ttf, suitable->txdata.get() + offset, ix1 - ix0, iy1 - iy0, ATLAS_SIZE, scale, scale, glyph);
-                                
-                                for (int b = 0; b < blur; b++) {
-                                    for (int bY = startY; bY < startY + iy1 - iy0; bY++) {
-                                        for (int bX = startX; bX < startX + ix1 - ix0; bX++) {
-                                            std::uint8_t &bpx = *(suitable->txdata.get() + bY * ATLAS_SIZE + bX);
-                                            int sum = 0;
-                                            sum += *(suitable->txdata.get() + (bY - 1) * ATLAS_SIZE + (bX - 1));
-                                            sum += *(suitable->txdata.get() + (bY - 1) * ATLAS_SIZE + (bX + 1));
-                                            sum += *(suitable->txdata.get() + (bY + 1) * ATLAS_SIZE + (bX - 1));
-                                            sum += *(suitable->txdata.get() + (bY + 1) * ATLAS_SIZE + (bX + 1));
-                                            sum += *(suitable->txdata.get() + (bY - 1) * ATLAS_SIZE + (bX + 0));
-                                            sum += *(suitable->txdata.get() + (bY + 1) * ATLAS_SIZE + (bX + 0));
-                                            sum += *(suitable->txdata.get() + (bY + 0) * ATLAS_SIZE + (bX - 1));
-                                            sum += *(suitable->txdata.get() + (bY + 0) * ATLAS_SIZE + (bX + 1));
-                                            bpx = std::max(bpx, std::uint8_t(sum >> 3));
-                                        }
-                                    }
+                    for (const RasterJob &job : jobs) {
+                        std::uint8_t *start = txdata + job.y * PAGE_WIDTH + job.x;
+                        
+                        if (blur == BLUR_SDF) {
+                            makeGlyphSDF(ttf, job.glyph, scale, start, job.w, job.h, PAGE_WIDTH);
+                            continue;
+                        }
+                        
+                        stbtt_MakeGlyphBitmap(ttf, start + blur * PAGE_WIDTH + blur, job.w - 2 * blur, job.h - 2 * blur, PAGE_WIDTH, scale, scale, job.glyph);
+                        
+                        for (int b = 0; b < blur; b++) {
+                            for (int bY = 0; bY < job.h; bY++) {
+                                for (int bX = 0; bX < job.w; bX++) {
+                                    std::uint8_t *bpx = start + bY * PAGE_WIDTH + bX;
+                                    int sum = 0;
+                                    sum += *(bpx - PAGE_WIDTH - 1);
+                                    sum += *(bpx - PAGE_WIDTH + 1);
+                                    sum += *(bpx + PAGE_WIDTH - 1);
+                                    sum += *(bpx + PAGE_WIDTH + 1);
+                                    sum += *(bpx - PAGE_WIDTH);
+                                    sum += *(bpx + PAGE_WIDTH);
+                                    sum += *(bpx - 1);
+                                    sum += *(bpx + 1);
+                                    *bpx = std::max(*bpx, std::uint8_t(sum >> 3));
                                 }
-                                
-                                suitable->offsetX += ix1 - ix0 + 1;
                             }
                         }
-                        else {
-                            self->_platform->logError("[FontAtlasProviderImpl::getTextFontAtlas] Char %d not found in TTF", int(u16ch));
-                        }
                     }
                     //--- worker thread ---
                 }
             },
-            [weak = weak_from_this(), txt = std::string(text), fontSize, blur, suitable, completion = std::move(completion)](AsyncContext &ctx) mutable {
+            [weak = weak_from_this(), txt = std::string(text), fontSize, blur, targetSize, suitable, completion = std::move(completion)](AsyncContext &) mutable {
                 if (std::shared_ptr<FontAtlasProviderImpl> self = weak.lock()) {
                     self->_asyncInProgress = false;
-                    suitable->chars.merge(ctx.resultChars);
-
+                    
                     for (const auto &item : self->_callsQueue) {
                         if (item.fontSize == fontSize) {
                             self->_postponedQueue.emplace_back(QueueEntry{
                                 .text = txt,
                                 .fontSize = fontSize,
                                 .blur = blur,
-                                .callback = std::move(completion)
+                                .targetSize = targetSize,
+                                .callback = std::move(completion),
+                                .page = suitable
                             });
                             return;
                         }
                     }
                     
-                    suitable->texture = self->_rendering->createTexture(foundation::RenderTextureFormat::R8UN, ATLAS_SIZE, ATLAS_SIZE, { suitable->txdata.get() });
-                    self->getTextFontAtlas(txt.data(), fontSize, blur, std::move(completion));
+                    self->_updateTexture(*suitable);
+                    completion(self->_makeChars(*suitable, txt.data(), blur, targetSize), suitable->texture);
                 }
             }));
         }
     }
+    
+    FontAtlasStats FontAtlasProviderImpl::getStats() const {
+        FontAtlasStats result = _stats;
+        
+        for (const FontPage &page : _pages) {
+            result.pageCount++;
+            result.pixelBytes += std::size_t(PAGE_WIDTH) * std::size_t(page.height);
+            result.glyphCount += page.glyphs.size();
+        }
+        
+        const std::size_t total = result.hitCount + result.missCount;
+        result.hitRate = total ? float(result.hitCount) / float(total) : 0.0f;
+        return result;
+    }
 
-    FontAtlasProviderImpl::FontAtlas *FontAtlasProviderImpl::_collectChars(const char *text, std::uint8_t fontSize, std::uint8_t blur, std::vector<FontCharInfo> &readyChars, std::unordered_set<std::uint64_t> &toLoad) {
-        FontAtlas *suitable = nullptr;
-
-        for (auto atlasIt = _atlases.begin(); atlasIt != _atlases.end(); ++atlasIt) {
-            if (atlasIt->fontSize == fontSize) {
-                suitable = &(*atlasIt);
-                break;
+    GlyphMetricsCache &FontAtlasProviderImpl::_getMetrics(std::uint8_t fontSize) const {
+        if (_metrics[fontSize] == nullptr) {
+            _metrics[fontSize] = std::make_unique<GlyphMetricsCache>(&_ttfInfo, fontSize);
+        }
+        
+        return *_metrics[fontSize];
+    }
+    
+    FontAtlasProviderImpl::FontPage *FontAtlasProviderImpl::_findPage(std::uint8_t fontSize, const std::vector<std::uint64_t> &keys, std::size_t &foundCount) {
+        FontPage *result = nullptr;
+        foundCount = 0;
+        
+        // The page with the most of glyphs
+        for (FontPage &page : _pages) {
+            if (page.fontSize == fontSize) {
+                std::size_t count = 0;
+                
+                for (std::uint64_t key : keys) {
+                    count += page.glyphs.count(key);
+                }
+                if (result == nullptr || count > foundCount) {
+                    result = &page;
+                    foundCount = count;
+                    
+                    if (count == keys.size()) {
+                        break;
+                    }
+                }
             }
         }
         
-        for (const char *src = text; *src; ) {
-            std::uint32_t len = 0;
-            std::uint32_t u16ch = utf8ToUTF16(src, len);
-
-            if (suitable) {
-                auto index = suitable->chars.find(makeKey(u16ch, blur));
-                if (index != suitable->chars.end()) {
-                    readyChars.emplace_back(FontCharInfo {
-                        .txLT = index->second.txLT,
-                        .txRB = index->second.txRB,
-                        .pxSize = index->second.pxSize,
-                        .advance = index->second.advance,
-                        .lsb = index->second.lsb,
-                        .voffset = index->second.voffset
-                    });
+        if (result) {
+            for (std::uint64_t key : keys) {
+                auto index = result->glyphs.find(key);
+                if (index != result->glyphs.end()) {
+                    index->second.lastUse = _frame;
+                }
+            }
+        }
+        
+        return result;
+    }
+    
+    FontAtlasProviderImpl::FontPage *FontAtlasProviderImpl::_placeText(std::uint8_t fontSize, const std::vector<std::uint64_t> &keys, std::uint8_t blur, FontPage *suitable, std::vector<RasterJob> &jobs) {
+        if (suitable && _reserve(*suitable, keys, blur, jobs)) {
+            return suitable;
+        }
+        
+        // Free space of other pages is used first, then unused glyphs are evicted
+        for (FontPage &page : _pages) {
+            if (page.fontSize == fontSize && &page != suitable && _reserve(page, keys, blur, jobs)) {
+                return &page;
+            }
+        }
+        if (suitable && _evictUnused(*suitable) && _reserve(*suitable, keys, blur, jobs)) {
+            return suitable;
+        }
+        for (FontPage &page : _pages) {
+            if (page.fontSize == fontSize && &page != suitable && _evictUnused(page) && _reserve(page, keys, blur, jobs)) {
+                return &page;
+            }
+        }
+        
+        return nullptr;
+    }
+    
+    bool FontAtlasProviderImpl::_reserve(FontPage &page, const std::vector<std::uint64_t> &keys, std::uint8_t blur, std::vector<RasterJob> &jobs) {
+        GlyphMetricsCache &metrics = _getMetrics(page.fontSize);
+        const float scale = metrics.scale;
+        const int savedShelfX = page.shelfX;
+        const int savedShelfY = page.shelfY;
+        const int savedShelfHeight = page.shelfHeight;
+        
+        std::vector<std::pair<std::uint64_t, Glyph>> added;
+        std::vector<int> glyphIndexes;
+        
+        for (std::uint64_t key : keys) {
+            if (page.glyphs.count(key) == 0) {
+                Glyph &glyph = added.emplace_back(key, Glyph{}).second;
+                const GlyphMetrics &charMetrics = metrics.get(getU16Ch(key));
+                const int index = charMetrics.glyph;
+                
+                if (index != 0) {
+                    int ix0 = 0, ix1 = 0, iy0 = 0, iy1 = 0;
+                    glyph.advance = charMetrics.advance;
+                    
+                    if (blur == BLUR_SDF) {
+                        int box[4], upscaledBox[4];
+                        getSDFGlyphBox(&_ttfInfo, index, scale, box, upscaledBox);
+                        
+                        const int border = upscaledBox[2] > upscaledBox[0] && upscaledBox[3] > upscaledBox[1] ? SDF_SPREAD : 0;
+                        glyph.w = border ? box[2] - box[0] + 2 * border : 0;
+                        glyph.h = border ? box[3] - box[1] + 2 * border : 0;
+                        glyph.lsb = float(box[0] - border);
+                        glyph.voffset = page.baseLine + float(box[1] - border);
+                    }
+                    else {
+                        stbtt_GetGlyphBitmapBox(&_ttfInfo, index, scale, scale, &ix0, &iy0, &ix1, &iy1);
+                        
+                        const int border = ix1 > ix0 && iy1 > iy0 ? blur : 0;
+                        glyph.w = ix1 > ix0 && iy1 > iy0 ? ix1 - ix0 + 2 * border : 0;
+                        glyph.h = ix1 > ix0 && iy1 > iy0 ? iy1 - iy0 + 2 * border : 0;
+                        glyph.lsb = charMetrics.lsb - float(border);
+                        glyph.voffset = page.baseLine + float(iy0 - border);
+                    }
                 }
                 else {
-                    toLoad.emplace(makeKey(u16ch, blur));
+                    _platform->logError("[FontAtlasProviderImpl::_reserve] Char %d not found in TTF", int(getU16Ch(key)));
+                    glyph.missing = true;
+                }
+                
+                glyphIndexes.emplace_back(index);
+            }
+        }
+        
+        // Higher glyphs first, so shelves are filled evenly
+        std::vector<std::size_t> order(added.size());
+        for (std::size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&added](std::size_t left, std::size_t right) {
+            return added[left].second.h > added[right].second.h;
+        });
+        
+        int height = std::max(page.height, PAGE_HEIGHT_MIN);
+        
+        for (std::size_t i : order) {
+            Glyph &glyph = added[i].second;
+            
+            if (glyph.w > 0) {
+                if (page.shelfX + glyph.w + GLYPH_SPACING > PAGE_WIDTH) {
+                    page.shelfX = GLYPH_SPACING;
+                    page.shelfY += page.shelfHeight + GLYPH_SPACING;
+                    page.shelfHeight = 0;
                 }
+                while (page.shelfY + glyph.h + GLYPH_SPACING > height && height < PAGE_HEIGHT_MAX) {
+                    height *= 2;
+                }
+                if (page.shelfX + glyph.w + GLYPH_SPACING > PAGE_WIDTH || page.shelfY + glyph.h + GLYPH_SPACING > height) {
+                    page.shelfX = savedShelfX;
+                    page.shelfY = savedShelfY;
+                    page.shelfHeight = savedShelfHeight;
+                    return false;
+                }
+                
+                glyph.x = page.shelfX;
+                glyph.y = page.shelfY;
+                page.shelfX += glyph.w + GLYPH_SPACING;
+                page.shelfHeight = std::max(page.shelfHeight, glyph.h);
+            }
+        }
+        
+        if (height != page.height) {
+            foundation::PoolBytes txdata = foundation::makePoolBytes(foundation::MemoryPoolId::RESOURCES, std::size_t(PAGE_WIDTH) * height, MEMORY_TAG_FONT_PIXELS);
+            std::memset(txdata.get(), 0, std::size_t(PAGE_WIDTH) * height);
+            
+            if (page.txdata) {
+                std::memcpy(txdata.get(), page.txdata.get(), std::size_t(PAGE_WIDTH) * page.height);
+            }
+            
+            page.txdata = std::move(txdata);
+            page.height = height;
+        }
+        
+        for (std::size_t i = 0; i < added.size(); i++) {
+            Glyph &glyph = added[i].second;
+            glyph.lastUse = _frame;
+            
+            if (glyph.w > 0) {
+                jobs.emplace_back(RasterJob{glyphIndexes[i], glyph.x, glyph.y, glyph.w, glyph.h});
+            }
+            
+            page.glyphs.emplace(added[i].first, glyph);
+        }
+        
+        page.dirty = true;
+        return true;
+    }
+    
+    bool FontAtlasProviderImpl::_evictUnused(FontPage &page) {
+        if (page.height < PAGE_HEIGHT_MAX || _frame <= page.textureFrame + 1) {
+            return false; // users of the current texture may not have requested their texts yet
+        }
+        
+        std::vector<std::pair<std::uint64_t, Glyph>> alive;
+        std::size_t evicted = 0;
+        
+        for (const auto &item : page.glyphs) {
+            if (item.second.lastUse >= page.textureFrame) {
+                alive.emplace_back(item);
             }
             else {
-                toLoad.emplace(makeKey(u16ch, blur));
+                evicted++;
             }
-
+        }
+        
+        if (evicted == 0) {
+            return false;
+        }
+        
+        std::sort(alive.begin(), alive.end(), [](const std::pair<std::uint64_t, Glyph> &left, const std::pair<std::uint64_t, Glyph> &right) {
+            return left.second.h > right.second.h;
+        });
+        
+        foundation::PoolBytes txdata = foundation::makePoolBytes(foundation::MemoryPoolId::RESOURCES, std::size_t(PAGE_WIDTH) * page.height, MEMORY_TAG_FONT_PIXELS);
+        std::memset(txdata.get(), 0, std::size_t(PAGE_WIDTH) * page.height);
+        
+        page.glyphs.clear();
+        page.shelfX = GLYPH_SPACING;
+        page.shelfY = GLYPH_SPACING;
+        page.shelfHeight = 0;
+        
+        for (auto &item : alive) {
+            Glyph &glyph = item.second;
+            
+            if (glyph.w > 0) {
+                if (page.shelfX + glyph.w + GLYPH_SPACING > PAGE_WIDTH) {
+                    page.shelfX = GLYPH_SPACING;
+                    page.shelfY += page.shelfHeight + GLYPH_SPACING;
+                    page.shelfHeight = 0;
+                }
+                if (page.shelfY + glyph.h + GLYPH_SPACING > page.height) {
+                    evicted++;
+                    continue;
+                }
+                
+                for (int row = 0; row < glyph.h; row++) {
+                    std::memcpy(txdata.get() + (page.shelfY + row) * PAGE_WIDTH + page.shelfX, page.txdata.get() + (glyph.y + row) * PAGE_WIDTH + glyph.x, glyph.w);
+                }
+                
+                glyph.x = page.shelfX;
+                glyph.y = page.shelfY;
+                page.shelfX += glyph.w + GLYPH_SPACING;
+                page.shelfHeight = std::max(page.shelfHeight, glyph.h);
+            }
+            
+            page.glyphs.emplace(item.first, glyph);
+        }
+        
+        page.txdata = std::move(txdata);
+        page.dirty = true;
+        _stats.evictedCount += evicted;
+        return true;
+    }
+    
+    std::vector<FontCharInfo> FontAtlasProviderImpl::_makeChars(FontPage &page, const char *text, std::uint8_t blur, std::uint8_t targetSize) {
+        std::vector<FontCharInfo> result;
+        const math::vector2f pageSize = math::vector2f(PAGE_WIDTH, page.height);
+        
+        // Distance field glyphs are scaled, their advances and baseline are of target size
+        GlyphMetricsCache &targetMetrics = _getMetrics(targetSize);
+        float k = 1.0f;
+        float baseLine = page.baseLine;
+        
+        if (blur == BLUR_SDF) {
+            int ascent, descent, lineGap;
+            stbtt_GetFontVMetrics(&_ttfInfo, &ascent, &descent, &lineGap);
+            k = float(targetSize) / float(page.fontSize);
+            baseLine = std::roundf(float(ascent) * stbtt_ScaleForMappingEmToPixels(&_ttfInfo, float(targetSize)));
+        }
+        
+        for (const char *src = text; *src; ) {
+            std::uint32_t len = 0;
+            const std::uint32_t u16ch = utf8ToUTF16(src, len);
+            auto index = page.glyphs.find(makeKey(u16ch, blur));
+            
+            if (index != page.glyphs.end()) {
+                index->second.lastUse = _frame; // texture is delivered after request frame, so it has to be stamped again
+            }
+            if (index != page.glyphs.end() && index->second.missing == false) {
+                const Glyph &glyph = index->second;
+                
+                result.emplace_back(FontCharInfo {
+                    .txLT = math::vector2f(glyph.x, glyph.y) / pageSize,
+                    .txRB = math::vector2f(glyph.x + glyph.w, glyph.y + glyph.h) / pageSize,
+                    .pxSize = math::vector2f(glyph.w, glyph.h) * k,
+                    .advance = blur == BLUR_SDF ? targetMetrics.get(u16ch).advance : glyph.advance,
+                    .lsb = glyph.lsb * k,
+                    .voffset = baseLine + (glyph.voffset - page.baseLine) * k
+                });
+            }
+            
             src += len;
         }
         
-        return suitable;
+        return result;
+    }
+    
+    void FontAtlasProviderImpl::_updateTexture(FontPage &page) {
+        if (page.dirty) {
+            page.texture = _rendering->createTexture(foundation::RenderTextureFormat::R8UN, PAGE_WIDTH, page.height, { page.txdata.get() });
+            page.textureFrame = _frame;
+            page.dirty = false;
+        }
     }
     
     void FontAtlasProviderImpl::update(float dtSec) {
         while (_asyncInProgress == false && _callsQueue.size()) {
             QueueEntry &entry = _callsQueue.front();
-            getTextFontAtlas(entry.text.data(), entry.fontSize, entry.blur, std::move(entry.callback));
+            _requestText(entry.text.data(), entry.fontSize, entry.blur, entry.targetSize, std::move(entry.callback));
             _callsQueue.pop_front();
         }
         if (_asyncInProgress == false && _callsQueue.empty()) {
             while (_postponedQueue.size()) {
                 QueueEntry &entry = _postponedQueue.front();
-                
-                std::vector<FontCharInfo> readyChars;
-                std::unordered_set<std::uint64_t> toLoad;
-                FontAtlas *suitable = _collectChars(entry.text.data(), entry.fontSize, entry.blur, readyChars, toLoad);
-                
-                if (suitable && toLoad.empty()) {
-                    entry.callback(std::move(readyChars), suitable->texture);
-                }
-                else {
-                    _platform->logError("[FontAtlasProviderImpl::update] Atlas logic error");
-                }
-                
+                _updateTexture(*entry.page);
+                entry.callback(_makeChars(*entry.page, entry.text.data(), entry.blur, entry.targetSize), entry.page->texture);
                 _postponedQueue.pop_front();
             }
+            
+            // Pages without glyphs requested since the texture was replaced have no users
+            _pages.remove_if([frame = _frame](const FontPage &page) {
+                if (page.dirty == false && frame > page.textureFrame + 1) {
+                    for (const auto &item : page.glyphs) {
+                        if (item.second.lastUse >= page.textureFrame) {
+                            return false;
+                        }
+                    }
+                    
+                    return true;
+                }
+                
+                return false;
+            });
         }
+        
+        _frame++;
     }
 }
 
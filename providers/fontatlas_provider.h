@@ -15,8 +15,25 @@ namespace resource {
         math::vector2f pxSize;
         float advance, lsb, voffset;
     };
+    
+    struct FontAtlasStats {
+        std::size_t pageCount = 0;
+        std::size_t pixelBytes = 0;         // memory of all pages
+        std::size_t glyphCount = 0;
+        std::size_t hitCount = 0;           // glyphs found in pages
+        std::size_t missCount = 0;          // glyphs that were rasterized
+        std::size_t evictedCount = 0;       // unused glyphs removed to free space
+        float hitRate = 0.0f;
+    };
 
     class FontAtlasProvider {
+    public:
+        // Distance field glyphs are rasterized once at this size and scaled to any other
+        // Texel value is 0.5 on glyph edge and changes by 0.5 per SDF_SPREAD pixels of reference size, inside is greater
+        //
+        static const std::uint8_t SDF_REFERENCE_SIZE = 32;
+        static const int SDF_SPREAD = 4;
+        
     public:
         static std::shared_ptr<FontAtlasProvider> instance(
             const foundation::PlatformInterfacePtr &platform,
@@ -32,9 +49,20 @@ namespace resource {
         
         // Rasterize font to atlases according to @text and @size
         // @return  - FontAtlasInfo with coordinates and textures
+        // Glyphs of a text are placed on one page. Pages grow, new pages are added when they are full
+        // Page texture is replaced when glyphs are added or evicted, so keep it as weak pointer and request text again when it's expired
         //
         virtual void getTextFontAtlas(const char *text, std::uint8_t fontSize, std::uint8_t blur, util::callback<void(std::vector<resource::FontCharInfo> &&, const foundation::RenderTexturePtr &)> &&completion) = 0;
         
+        // Same as getTextFontAtlas, but glyphs are signed distance field of SDF_REFERENCE_SIZE and chars are scaled to @fontSize
+        // One set of glyphs serves all sizes. Shadow, outline and glow are made by shader from the same texels
+        //
+        virtual void getTextFontAtlasSDF(const char *text, std::uint8_t fontSize, util::callback<void(std::vector<resource::FontCharInfo> &&, const foundation::RenderTexturePtr &)> &&completion) = 0;
+        
+        // Memory of atlas pages and efficiency of glyph cache
+        //
+        virtual auto getStats() const -> FontAtlasStats = 0;
+        
         // Provider tracks resources life time and tries to free them
         //
         virtual void update(float dtSec) = 0;
@@ -4,6 +4,7 @@
 #include "meshes_list.h"
 #include "grounds_list.h"
 #include "foundation/layouts.h"
+#include "foundation/memory.h"
 
 #include "thirdparty/upng/upng.h"
 
@@ -11,8 +12,17 @@
 #include <memory>
 
 namespace {
+    const std::uint8_t MEMORY_TAG_TEXTURE_PIXELS = 1;
+    const std::uint8_t MEMORY_TAG_GROUND_PIXELS = 2;
+    const std::uint8_t MEMORY_TAG_GROUND_GEOMETRY = 3;
+    const std::uint8_t MEMORY_TAG_ATLAS_PIXELS = 4;
+    
+    const int ATLAS_PAGE_SIZE = 1024;
+    const int ATLAS_IMAGE_SIZE_MAX = 256; // bigger images have their own textures
+    const int ATLAS_PADDING = 1;
+    
     struct TextureAsyncContext {
-        std::unique_ptr<std::uint8_t[]> data;
+        foundation::PoolBytes data;
         std::uint32_t w, h;
         foundation::RenderTextureFormat format;
     };
@@ -26,7 +36,8 @@ namespace {
             std::uint8_t colorIndex, mask;
         };
         util::Description description;
-        std::vector<std::vector<VTXMVOX>> voxels;
+        std::vector<VTXMVOX> voxels;                // all frames one after another
+        std::vector<std::uint32_t> frameOffsets;    // frame count + 1 entries
     };
     struct GroundAsyncContext {
         struct Vertex {
@@ -35,10 +46,10 @@ namespace {
             float u, v;
         };
 
-        std::unique_ptr<std::uint8_t[]> data;
+        foundation::PoolBytes data;
         std::uint32_t w, h;
-        std::vector<Vertex> vertexes;
-        std::vector<std::uint32_t> indexes;
+        std::vector<Vertex, foundation::PoolAllocator<Vertex, foundation::MemoryPoolId::RESOURCES, MEMORY_TAG_GROUND_GEOMETRY>> vertexes;
+        std::vector<std::uint32_t, foundation::PoolAllocator<std::uint32_t, foundation::MemoryPoolId::RESOURCES, MEMORY_TAG_GROUND_GEOMETRY>> indexes;
     };
     
     bool readEmitter(const std::uint8_t *data, util::Description &desc, size_t &read) {
@@ -55,6 +66,7 @@ namespace {
 
     void readMesh(MeshAsyncContext &ctx, const std::uint8_t *data) {
         ctx.voxels.clear();
+        ctx.frameOffsets.clear();
         
         if (memcmp(data, "VOX ", 4) == 0) {
             if (*(std::int32_t *)(data + 4) == 0x7f) { // vox made by gen_meshes.py
@@ -65,18 +77,22 @@ namespace {
                 const math::vector3f originOffset = ctx.description.getVector3f("offset", {});
                 
                 std::uint32_t frameCount = *(std::uint32_t *)data;
-                ctx.voxels.resize(frameCount);
+                ctx.frameOffsets.reserve(frameCount + 1);
+                ctx.frameOffsets.emplace_back(0);
                 data += sizeof(std::uint32_t);
                 
                 for (std::uint32_t f = 0; f < frameCount; f++) {
                     std::uint32_t voxelCount = *(std::uint32_t *)data;
                     data += sizeof(std::uint32_t);
-                    ctx.voxels[f].resize(voxelCount);
+                    
+                    const std::uint32_t frameStart = ctx.frameOffsets.back();
+                    ctx.voxels.resize(frameStart + voxelCount);
+                    ctx.frameOffsets.emplace_back(frameStart + voxelCount);
                     
                     // TODO: move that loop to the mesh-preparing tool
                     for (std::uint32_t i = 0; i < voxelCount; i++) {
                         const MeshAsyncContext::Voxel &src = *(MeshAsyncContext::Voxel *)data;
-                        MeshAsyncContext::VTXMVOX &voxel = ctx.voxels[f][i];
+                        MeshAsyncContext::VTXMVOX &voxel = ctx.voxels[frameStart + i];
                         voxel.positionX = src.positionX - originOffset.x;
                         voxel.positionY = src.positionY - originOffset.y;
                         voxel.positionZ = src.positionZ - originOffset.z;
@@ -122,7 +138,7 @@ namespace {
                 if (upng_get_format(upng) == UPNG_LUMINANCE8) {
                     ctx.w = upng_get_width(upng);
                     ctx.h = upng_get_height(upng);
-                    ctx.data = std::make_unique<std::uint8_t[]>(ctx.w * ctx.h);
+                    ctx.data = foundation::makePoolBytes(foundation::MemoryPoolId::RESOURCES, ctx.w * ctx.h, MEMORY_TAG_GROUND_PIXELS);
                     std::memcpy(ctx.data.get(), upng_get_buffer(upng), ctx.w * ctx.h);
                     return;
                 }
@@ -171,12 +187,14 @@ namespace resource {
         auto getGroundInfo(const char *groundPath) -> const GroundInfo * override;
         
         void getOrLoadTexture(const char *texPath, util::callback<void(const foundation::RenderTexturePtr &)> &&completion) override;
-        void getOrLoadVoxelMesh(const char *meshPath, util::callback<void(const std::vector<foundation::RenderDataPtr> &, const util::Description &)> &&completion) override;
+        void getOrLoadAtlasTexture(const char *texPath, util::callback<void(const foundation::RenderTexturePtr &, const math::vector4f &)> &&completion) override;
+        void getOrLoadVoxelMesh(const char *meshPath, util::callback<void(const foundation::RenderDataPtr &, const std::vector<std::uint32_t> &, const util::Description &)> &&completion) override;
         void getOrLoadGround(const char *groundPath, util::callback<void(const foundation::RenderDataPtr &, const foundation::RenderTexturePtr &)> &&completion) override;
         void getOrLoadEmitter(const char *descPath, util::callback<void(const util::Description &, const foundation::RenderTexturePtr &, const foundation::RenderTexturePtr &)> &&completion) override;
         void getOrLoadDescription(const char *descPath, util::callback<void(const util::Description &)> &&completion) override;
         
         auto getPrefab(const char *prefabPath) -> const util::Description & override;
+        auto getPrefabsVersion() const -> std::uint32_t override;
         
         void removeTexture(const char *texturePath) override;
         void removeMesh(const char *meshPath) override;
@@ -187,6 +205,12 @@ namespace resource {
         
         void update(float dtSec) override;
         
+    private:
+        struct AtlasPage;
+        
+        void _decodeTexture(const std::string &path, const std::uint8_t *data, std::size_t len, TextureAsyncContext &ctx) const;
+        auto _packToAtlas(const TextureAsyncContext &ctx, math::vector4f &uv) -> AtlasPage *;
+        
     private:
         const std::shared_ptr<foundation::PlatformInterface> _platform;
         const std::shared_ptr<foundation::RenderingInterface> _rendering;
@@ -196,7 +220,8 @@ namespace resource {
             bool outdated = false;
         };
         struct VoxelMesh {
-            std::vector<foundation::RenderDataPtr> frames;
+            foundation::RenderDataPtr frames;
+            std::vector<std::uint32_t> frameOffsets;
             util::Description description;
             bool outdated = false;
         };
@@ -216,21 +241,48 @@ namespace resource {
             bool outdated = false;
         };
         
+        // Page texture is created again in update() if images were added, waiting callbacks are called then
+        // Skyline packing: page is covered by segments, images are placed on the lowest segment where they fit
+        struct AtlasPage {
+            struct Segment {
+                int x, y, width;
+            };
+            
+            foundation::PoolBytes pixels;
+            std::vector<Segment> skyline;
+            foundation::RenderTexturePtr texture;
+            std::vector<util::callback<void()>> waiting;
+            bool dirty = false;
+        };
+        struct AtlasRegion {
+            AtlasPage *page = nullptr; // nullptr if image has its own texture
+            foundation::RenderTexturePtr texture;
+            math::vector4f uv;
+            bool outdated = false;
+        };
+        
         std::unordered_map<std::string, TextureData> _textures;
         std::unordered_map<std::string, VoxelMesh> _meshes;
         std::unordered_map<std::string, GroundMesh> _grounds;
         std::unordered_map<std::string, Emitter> _emitters;
         std::unordered_map<std::string, Description> _descriptions;
+        std::unordered_map<std::string, AtlasRegion> _atlasRegions;
+        std::list<AtlasPage> _atlasPages;
 
         std::unordered_map<std::string, util::Description> _prefabs;
+        std::uint32_t _prefabsVersion = 0;
         
         struct QueueEntryTexture {
             std::string texPath;
             util::callback<void(const foundation::RenderTexturePtr &)> callbackPtr;
         };
+        struct QueueEntryAtlas {
+            std::string texPath;
+            util::callback<void(const foundation::RenderTexturePtr &, const math::vector4f &)> callback;
+        };
         struct QueueEntryMesh {
             std::string meshPath;
-            util::callback<void(const std::vector<foundation::RenderDataPtr> &, const util::Description &)> callback;
+            util::callback<void(const foundation::RenderDataPtr &, const std::vector<std::uint32_t> &, const util::Description &)> callback;
         };
         struct QueueEntryGround {
             std::string groundPath;
@@ -246,6 +298,7 @@ namespace resource {
         };
 
         std::list<QueueEntryTexture> _callsQueueTexture;
+        std::list<QueueEntryAtlas> _callsQueueAtlas;
         std::list<QueueEntryMesh> _callsQueueMesh;
         std::list<QueueEntryGround> _callsQueueGround;
         std::list<QueueEntryEmitter> _callsQueueEmitter;
@@ -312,36 +365,7 @@ namespace resource {
                         self->_platform->executeAsync(std::make_unique<foundation::CommonAsyncTask<TextureAsyncContext>>([weak, path, mem = std::move(mem), len](TextureAsyncContext &ctx) {
                             //--- worker thread ---
                             if (std::shared_ptr<ResourceProviderImpl> self = weak.lock()) {
-                                upng_t *upng = upng_new_from_bytes(mem.get(), (unsigned long)(len));
-                                if (upng != nullptr && *reinterpret_cast<const unsigned *>(mem.get()) == UPNG_HEAD && upng_decode(upng) == UPNG_EOK) {
-                                    foundation::RenderTextureFormat format = foundation::RenderTextureFormat::UNKNOWN;
-                                    std::uint32_t bytesPerPixel = 0;
-                                    
-                                    if (upng_get_format(upng) == UPNG_RGBA8) {
-                                        format = foundation::RenderTextureFormat::RGBA8UN;
-                                        bytesPerPixel = 4;
-                                    }
-                                    else if (upng_get_format(upng) == UPNG_LUMINANCE8) {
-                                        format = foundation::RenderTextureFormat::R8UN;
-                                        bytesPerPixel = 1;
-                                    }
-                                    
-                                    if (format != foundation::RenderTextureFormat::UNKNOWN) {
-                                        ctx.format = format;
-                                        ctx.w = upng_get_width(upng);
-                                        ctx.h = upng_get_height(upng);
-                                        ctx.data = std::make_unique<std::uint8_t[]>(ctx.w * ctx.h * bytesPerPixel);
-                                        std::memcpy(ctx.data.get(), upng_get_buffer(upng), ctx.w * ctx.h * bytesPerPixel);
-                                    }
-                                    else {
-                                        self->_platform->logError("[TextureProviderImpl::getOrLoadTexture] '%s' must have a valid format (rgba8, lum8)", path.data());
-                                    }
-                                    
-                                    upng_free(upng);
-                                }
-                                else {
-                                    self->_platform->logError("[TextureProviderImpl::getOrLoadTexture] '%s' is not a valid png file", path.data());
-                                }
+                                self->_decodeTexture(path, mem.get(), len, ctx);
                             }
                             //--- worker thread ---
                         },
@@ -372,7 +396,179 @@ namespace resource {
         }
     }
         
-    void ResourceProviderImpl::getOrLoadVoxelMesh(const char *meshPath, util::callback<void(const std::vector<foundation::RenderDataPtr> &, const util::Description &)> &&completion) {
+    void ResourceProviderImpl::getOrLoadAtlasTexture(const char *texPath, util::callback<void(const foundation::RenderTexturePtr &, const math::vector4f &)> &&completion) {
+        if (_asyncInProgress) {
+            _callsQueueAtlas.emplace_back(QueueEntryAtlas {
+                .texPath = texPath,
+                .callback = std::move(completion)
+            });
+            
+            return;
+        }
+        
+        std::string path = std::string(texPath);
+        
+        auto index = _atlasRegions.find(path);
+        if (index != _atlasRegions.end() && index->second.outdated == false) {
+            const AtlasRegion &region = index->second;
+            
+            if (region.page == nullptr) {
+                completion(region.texture, region.uv);
+            }
+            else if (region.page->dirty) {
+                region.page->waiting.emplace_back([page = region.page, uv = region.uv, completion = std::move(completion)]() {
+                    completion(page->texture, uv);
+                });
+            }
+            else {
+                completion(region.page->texture, region.uv);
+            }
+        }
+        else {
+            _asyncInProgress = true;
+            _platform->loadFile((path + ".png").data(), [weak = weak_from_this(), path, completion = std::move(completion)](std::unique_ptr<std::uint8_t[]> &&mem, std::size_t len) mutable {
+                if (std::shared_ptr<ResourceProviderImpl> self = weak.lock()) {
+                    if (len) {
+                        self->_platform->executeAsync(std::make_unique<foundation::CommonAsyncTask<TextureAsyncContext>>([weak, path, mem = std::move(mem), len](TextureAsyncContext &ctx) {
+                            //--- worker thread ---
+                            if (std::shared_ptr<ResourceProviderImpl> self = weak.lock()) {
+                                self->_decodeTexture(path, mem.get(), len, ctx);
+                            }
+                            //--- worker thread ---
+                        },
+                        [weak, path, completion = std::move(completion)](TextureAsyncContext &ctx) mutable {
+                            if (std::shared_ptr<ResourceProviderImpl> self = weak.lock()) {
+                                self->_asyncInProgress = false;
+                                
+                                if (ctx.data) {
+                                    AtlasRegion region;
+                                    
+                                    if ((region.page = self->_packToAtlas(ctx, region.uv)) == nullptr) {
+                                        region.texture = self->_rendering->createTexture(ctx.format, ctx.w, ctx.h, {ctx.data.get()});
+                                        region.uv = math::vector4f(0.0f, 0.0f, 1.0f, 1.0f);
+                                    }
+                                    
+                                    self->_atlasRegions.erase(path);
+                                    self->_atlasRegions.emplace(path, std::move(region));
+                                    self->getOrLoadAtlasTexture(path.data(), std::move(completion));
+                                }
+                                else {
+                                    self->_platform->logError("[ResourceProviderImpl::getOrLoadAtlasTexture] Async operation has failed for file '%s'", path.data());
+                                    completion(nullptr, math::vector4f(0.0f, 0.0f, 1.0f, 1.0f));
+                                }
+                            }
+                        }));
+                    }
+                    else {
+                        self->_asyncInProgress = false;
+                        self->_platform->logError("[ResourceProviderImpl::getOrLoadAtlasTexture] Unable to find file '%s'", path.data());
+                        completion(nullptr, math::vector4f(0.0f, 0.0f, 1.0f, 1.0f));
+                    }
+                }
+            });
+        }
+    }
+    
+    ResourceProviderImpl::AtlasPage *ResourceProviderImpl::_packToAtlas(const TextureAsyncContext &ctx, math::vector4f &uv) {
+        const int w = int(ctx.w) + ATLAS_PADDING;
+        const int h = int(ctx.h) + ATLAS_PADDING;
+        
+        if (ctx.format != foundation::RenderTextureFormat::RGBA8UN || ctx.w > ATLAS_IMAGE_SIZE_MAX || ctx.h > ATLAS_IMAGE_SIZE_MAX) {
+            return nullptr;
+        }
+        
+        for (int attempt = 0; attempt < 2; attempt++) {
+            for (AtlasPage &page : _atlasPages) {
+                std::vector<AtlasPage::Segment> &skyline = page.skyline;
+                std::size_t bestIndex = skyline.size();
+                int bestX = 0, bestY = ATLAS_PAGE_SIZE;
+                
+                // The lowest place, image lies on the highest segment under it
+                for (std::size_t i = 0; i < skyline.size(); i++) {
+                    const int x = skyline[i].x;
+                    int y = 0;
+                    
+                    if (x + w <= ATLAS_PAGE_SIZE) {
+                        for (std::size_t c = i; c < skyline.size() && skyline[c].x < x + w; c++) {
+                            y = std::max(y, skyline[c].y);
+                        }
+                        if (y + h <= ATLAS_PAGE_SIZE && y < bestY) {
+                            bestIndex = i;
+                            bestX = x;
+                            bestY = y;
+                        }
+                    }
+                }
+                
+                if (bestIndex < skyline.size()) {
+                    std::size_t next = bestIndex;
+                    
+                    // Segments under the image are cut or removed
+                    while (next < skyline.size() && skyline[next].x + skyline[next].width <= bestX + w) {
+                        next++;
+                    }
+                    if (next < skyline.size() && skyline[next].x < bestX + w) {
+                        skyline[next].width -= bestX + w - skyline[next].x;
+                        skyline[next].x = bestX + w;
+                    }
+                    
+                    skyline.erase(skyline.begin() + bestIndex, skyline.begin() + next);
+                    skyline.insert(skyline.begin() + bestIndex, AtlasPage::Segment{bestX, bestY + h, w});
+                    
+                    for (std::uint32_t row = 0; row < ctx.h; row++) {
+                        std::uint8_t *dst = page.pixels.get() + (std::size_t(bestY + row) * ATLAS_PAGE_SIZE + bestX) * 4;
+                        std::memcpy(dst, ctx.data.get() + std::size_t(row) * ctx.w * 4, ctx.w * 4);
+                    }
+                    
+                    uv = math::vector4f(float(bestX), float(bestY), float(bestX + int(ctx.w)), float(bestY + int(ctx.h))) / float(ATLAS_PAGE_SIZE);
+                    page.dirty = true;
+                    return &page;
+                }
+            }
+            
+            AtlasPage &page = _atlasPages.emplace_back();
+            page.pixels = foundation::makePoolBytes(foundation::MemoryPoolId::RESOURCES, ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE * 4, MEMORY_TAG_ATLAS_PIXELS);
+            page.skyline.emplace_back(AtlasPage::Segment{0, 0, ATLAS_PAGE_SIZE});
+            std::memset(page.pixels.get(), 0, ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE * 4);
+        }
+        
+        return nullptr;
+    }
+    
+    void ResourceProviderImpl::_decodeTexture(const std::string &path, const std::uint8_t *data, std::size_t len, TextureAsyncContext &ctx) const {
+        upng_t *upng = upng_new_from_bytes(data, (unsigned long)(len));
+        if (upng != nullptr && *reinterpret_cast<const unsigned *>(data) == UPNG_HEAD && upng_decode(upng) == UPNG_EOK) {
+            foundation::RenderTextureFormat format = foundation::RenderTextureFormat::UNKNOWN;
+            std::uint32_t bytesPerPixel = 0;
+            
+            if (upng_get_format(upng) == UPNG_RGBA8) {
+                format = foundation::RenderTextureFormat::RGBA8UN;
+                bytesPerPixel = 4;
+            }
+            else if (upng_get_format(upng) == UPNG_LUMINANCE8) {
+                format = foundation::RenderTextureFormat::R8UN;
+                bytesPerPixel = 1;
+            }
+            
+            if (format != foundation::RenderTextureFormat::UNKNOWN) {
+                ctx.format = format;
+                ctx.w = upng_get_width(upng);
+                ctx.h = upng_get_height(upng);
+                ctx.data = foundation::makePoolBytes(foundation::MemoryPoolId::RESOURCES, ctx.w * ctx.h * bytesPerPixel, MEMORY_TAG_TEXTURE_PIXELS);
+                std::memcpy(ctx.data.get(), upng_get_buffer(upng), ctx.w * ctx.h * bytesPerPixel);
+            }
+            else {
+                _platform->logError("[ResourceProviderImpl::_decodeTexture] '%s' must have a valid format (rgba8, lum8)", path.data());
+            }
+            
+            upng_free(upng);
+        }
+        else {
+            _platform->logError("[ResourceProviderImpl::_decodeTexture] '%s' is not a valid png file", path.data());
+        }
+    }
+    
+    void ResourceProviderImpl::getOrLoadVoxelMesh(const char *meshPath, util::callback<void(const foundation::RenderDataPtr &, const std::vector<std::uint32_t> &, const util::Description &)> &&completion) {
         if (_asyncInProgress) {
             _callsQueueMesh.emplace_back(QueueEntryMesh {
                 .meshPath = meshPath,
@@ -386,7 +582,7 @@ namespace resource {
 
         auto index = _meshes.find(path);
         if (index != _meshes.end() && index->second.outdated == false) {
-            completion(index->second.frames, index->second.description);
+            completion(index->second.frames, index->second.frameOffsets, index->second.description);
         }
         else {
             _asyncInProgress = true;
@@ -405,14 +601,11 @@ namespace resource {
                                 self->_asyncInProgress = false;
                                 
                                 if (ctx.voxels.size()) {
-                                    std::vector<foundation::RenderDataPtr> frames (ctx.voxels.size());
-                                    for (std::size_t f = 0; f < ctx.voxels.size(); f++) {
-                                        frames[f] = self->_rendering->createData(layouts::VTXMVOX, ctx.voxels[f].data(), std::uint32_t(ctx.voxels[f].size()));
-                                    }
+                                    foundation::RenderDataPtr frames = self->_rendering->createData(layouts::VTXMVOX, ctx.voxels.data(), ctx.frameOffsets.back());
                                     
                                     self->_meshes.erase(path);
-                                    const VoxelMesh &result = self->_meshes.emplace(path, VoxelMesh{std::move(frames), std::move(ctx.description)}).first->second;
-                                    completion(result.frames, result.description);
+                                    const VoxelMesh &result = self->_meshes.emplace(path, VoxelMesh{std::move(frames), std::move(ctx.frameOffsets), std::move(ctx.description)}).first->second;
+                                    completion(result.frames, result.frameOffsets, result.description);
                                 }
                                 else {
                                     self->_platform->logError("[ResourceProviderImpl::getOrLoadVoxelMesh] '%s' is not a valid vxm file", path.data());
@@ -423,7 +616,7 @@ namespace resource {
                     else {
                         self->_asyncInProgress = false;
                         self->_platform->logError("[ResourceProviderImpl::getOrLoadVoxelMesh] Unable to find file '%s'", path.data());
-                        completion({}, {});
+                        completion(nullptr, {}, {});
                     }
                 }
             });
@@ -609,12 +802,22 @@ namespace resource {
         
         return util::Description::emptyDesc;
     }
+    
+    std::uint32_t ResourceProviderImpl::getPrefabsVersion() const {
+        return _prefabsVersion;
+    }
 
     void ResourceProviderImpl::removeTexture(const char *texturePath) {
         auto index = _textures.find(texturePath);
         if (index != _textures.end()) {
             index->second.outdated = true;
         }
+        
+        // Space of the image in atlas page isn't reused
+        auto regionIndex = _atlasRegions.find(texturePath);
+        if (regionIndex != _atlasRegions.end()) {
+            regionIndex->second.outdated = true;
+        }
     }
     void ResourceProviderImpl::removeMesh(const char *meshPath) {
         auto index = _meshes.find(meshPath);
@@ -643,6 +846,7 @@ namespace resource {
     void ResourceProviderImpl::reloadPrefabs(util::callback<void()> &&completion) {
         _platform->loadFile(resource::PREFAB_BIN, [this, cb = std::move(completion)](std::unique_ptr<std::uint8_t []> &&prefabsData, std::size_t prefabsSize) {
             if (prefabsSize && readPrefabs(_prefabs, prefabsData.get())) {
+                _prefabsVersion++;
                 cb();
                 _platform->logMsg("[ResourceProviderImpl::reloadPrefabs] prefabs.bin reloaded");
             }
@@ -653,11 +857,28 @@ namespace resource {
     }
     
     void ResourceProviderImpl::update(float dtSec) {
+        for (AtlasPage &page : _atlasPages) {
+            if (page.dirty) {
+                page.texture = _rendering->createTexture(foundation::RenderTextureFormat::RGBA8UN, ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE, {page.pixels.get()});
+                page.dirty = false;
+                
+                std::vector<util::callback<void()>> waiting = std::move(page.waiting);
+                for (const util::callback<void()> &callback : waiting) {
+                    callback();
+                }
+            }
+        }
+        
         while (_asyncInProgress == false && _callsQueueTexture.size()) {
             QueueEntryTexture &entry = _callsQueueTexture.front();
             getOrLoadTexture(entry.texPath.data(), std::move(entry.callbackPtr));
             _callsQueueTexture.pop_front();
         }
+        while (_asyncInProgress == false && _callsQueueAtlas.size()) {
+            QueueEntryAtlas &entry = _callsQueueAtlas.front();
+            getOrLoadAtlasTexture(entry.texPath.data(), std::move(entry.callback));
+            _callsQueueAtlas.pop_front();
+        }
         while (_asyncInProgress == false && _callsQueueMesh.size()) {
             QueueEntryMesh &entry = _callsQueueMesh.front();
             getOrLoadVoxelMesh(entry.meshPath.data(), std::move(entry.callback));
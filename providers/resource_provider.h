@@ -59,11 +59,19 @@ namespace resource {
         //
         virtual void getOrLoadTexture(const char *texturePath, util::callback<void(const foundation::RenderTexturePtr &)> &&completion) = 0;
         
+        // Asynchronously load small rgba8 texture into a shared atlas page, so many images are drawn with one texture
+        // @texturePath - path to file without extension
+        // @return - page texture (nullptr if not loaded) and image rectangle in texture coordinates (left, top, right, bottom)
+        // Page texture is replaced when images are added to the page. Keep it as weak pointer and get it again when it is expired
+        // Big textures are not packed, they have their own texture and rectangle (0, 0, 1, 1)
+        //
+        virtual void getOrLoadAtlasTexture(const char *texturePath, util::callback<void(const foundation::RenderTexturePtr &, const math::vector4f &)> &&completion) = 0;
+        
         // Asynchronously load voxels with VTXMVOX layout from file if they aren't loaded yet
         // @meshPath - path to file without extension
-        // @return - mesh frames (zero size if not loaded)
+        // @return - voxels of all frames in one buffer (nullptr if not loaded) and frame count + 1 offsets to that buffer
         //
-        virtual void getOrLoadVoxelMesh(const char *meshPath, util::callback<void(const std::vector<foundation::RenderDataPtr> &, const util::Description &)> &&completion) = 0;
+        virtual void getOrLoadVoxelMesh(const char *meshPath, util::callback<void(const foundation::RenderDataPtr &, const std::vector<std::uint32_t> &, const util::Description &)> &&completion) = 0;
         
         // Asynchronously load ground from file if it isn't loaded yet
         // @groundPath - path to file without extension
@@ -88,6 +96,10 @@ namespace resource {
         //
         virtual auto getPrefab(const char *prefabPath) -> const util::Description & = 0;
         
+        // Incremented every time prefabs are reloaded. Data built from prefabs should be rebuilt when it changes
+        //
+        virtual auto getPrefabsVersion() const -> std::uint32_t = 0;
+        
         // Force removing resources from internal storages
         //
         virtual void removeTexture(const char *texturePath) = 0;
@@ -1,14 +1,23 @@
 
 #include "foundation/platform.h"
 #include "foundation/rendering.h"
+#include "foundation/memory.h"
+#include "foundation/jobs.h"
 #include "providers/resource_provider.h"
-#include "voxel/scene.h"
-#include "voxel/world.h"
-#include "voxel/raycast.h"
-#include "voxel/simulation.h"
+#include "providers/fontatlas_provider.h"
+#include "core/scene.h"
+#include "core/world.h"
+#include "core/raycast.h"
+#include "core/simulation.h"
 #include "ui/stage.h"
 #include "datahub/datahub.h"
 
+#include <array>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
 std::string testDesc0 = "v0 : integer = 17\r\nv1 : number = 678.3400\r\nv2 : bool = true\r\nv3 : string = \"ttt\"\r\n";
 std::string testDesc1 = R"(
 v0 : vector2i = 10 20
@@ -52,9 +61,166 @@ std::string testDesc6 = R"(test : string[2] = "qwerty"  "grimm")";
 
 
 foundation::PlatformInterfacePtr platform;
+std::size_t g_allocationCount = 0;
+
+void *operator new(std::size_t size) {
+    g_allocationCount++;
+    return std::malloc(size);
+}
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+// Callbacks a typical frame creates: render passes, file completion, async task pair
+// Padding makes captures bigger than inline storage, that is how every callback was stored before
+//
+template<std::size_t Padding> std::size_t countFrameAllocations() {
+    const std::size_t start = g_allocationCount;
+    const std::array<std::uint8_t, Padding> padding = {};
+    int counter = 0;
+    
+    for (int i = 0; i < 3; i++) {
+        util::callback<void(int &)> pass = [&counter, padding, i](int &value) { value += i + padding[0]; };
+        pass(counter);
+    }
+    
+    util::callback<void(std::unique_ptr<std::uint8_t[]> &&, std::size_t)> completion = [&counter, padding](std::unique_ptr<std::uint8_t[]> &&data, std::size_t size) {
+        counter += int(size) + padding[0];
+    };
+    completion.callAndReset(nullptr, 1);
+    
+    util::callback<void(int &)> background = [padding](int &value) { value *= 2 + padding[0]; };
+    util::callback<void(int &)> main = [padding, &counter](int &value) { counter += value + padding[0]; };
+    util::callback<void(int &)> queued = std::move(background);
+    queued(counter);
+    main(counter);
+    
+    return g_allocationCount - start;
+}
 
 void testUtilCallback() {
+    {
+        int value = 0;
+        util::callback<void(int)> cb = [&value](int v) { value = v; };
+        cb(5);
+        assert(value == 5);
+        util::callback<void(int)> moved = std::move(cb);
+        assert(!cb && moved);
+        moved(7);
+        assert(value == 7);
+        cb = std::move(moved);
+        cb(9);
+        assert(value == 9);
+    }
+    {
+        std::shared_ptr<int> token = std::make_shared<int>(1);
+        {
+            util::callback<int()> small = [token]() { return *token; };
+            util::callback<int()> big = [token, padding = std::array<std::uint8_t, 128>{}]() { return *token + padding[0]; };
+            assert(token.use_count() == 3);
+            
+            util::callback<int()> smallMoved = std::move(small);
+            util::callback<int()> bigMoved = std::move(big);
+            assert(token.use_count() == 3);
+            assert(smallMoved() == 1 && bigMoved() == 1);
+            
+            assert(smallMoved.callAndReset() == 1);
+            assert(!smallMoved && token.use_count() == 2);
+        }
+        assert(token.use_count() == 1);
+    }
+    {
+        const std::size_t inlineAllocations = countFrameAllocations<1>();
+        const std::size_t heapAllocations = countFrameAllocations<util::callback<void()>::INLINE_SIZE + 1>();
+        
+        printf("[testUtilCallback] allocations per frame: %d with inline storage, %d with heap storage\n", int(inlineAllocations), int(heapAllocations));
+        assert(inlineAllocations == 0);
+        assert(heapAllocations == 6);
+    }
+}
+
+void testUtilFrameArena() {
+    util::FrameArena &arena = util::FrameArena::instance();
+    arena.reset();
+    
+    for (int frame = 0; frame < 4; frame++) {
+        {
+            util::FrameVector<math::vector3f> points;
+            for (int i = 0; i < 1000 * (frame + 1); i++) {
+                points.emplace_back(float(i), 0.0f, 0.0f);
+            }
+            util::FrameString name ("object.node:animation_with_a_long_name");
+            std::uint64_t *aligned = static_cast<std::uint64_t *>(arena.allocate(sizeof(std::uint64_t) * 3, 64));
+            assert(reinterpret_cast<std::uintptr_t>(aligned) % 64 == 0);
+            assert(points[999].x == 999.0f);
+            assert(arena.getFrameBytes() > 1000 * sizeof(math::vector3f));
+        }
+        arena.reset();
+        assert(arena.getFrameBytes() == 0);
+    }
+    
+    // Heaviest frame is already covered, so repeating it doesn't touch the heap
+    const std::size_t start = g_allocationCount;
+    {
+        util::FrameVector<math::vector3f> points;
+        for (int i = 0; i < 4000; i++) {
+            points.emplace_back(float(i), 0.0f, 0.0f);
+        }
+    }
+    arena.reset();
+    
+    printf("[testUtilFrameArena] peak frame bytes: %d, arena heap allocations: %d\n", int(arena.getPeakFrameBytes()), int(arena.getHeapAllocationCount()));
+    assert(g_allocationCount == start);
+}
 
+void testUtilSlotMap() {
+    {
+        util::SlotMap<int> map;
+        const util::SlotHandle h0 = map.insert(10);
+        const util::SlotHandle h1 = map.insert(11);
+        const util::SlotHandle h2 = map.insert(12);
+        
+        assert(map.release(h1));
+        assert(map.release(h1) == false);
+        assert(map.get(h1) == nullptr && *map.get(h2) == 12);
+        
+        const util::SlotHandle h3 = map.insert(13);
+        assert(h3.index == h1.index && h3.generation != h1.generation);
+        assert(map.get(h1) == nullptr && *map.get(h3) == 13);
+        
+        map.compact();
+        assert(map.size() == 3 && map[0] == 10 && map[1] == 12 && map[2] == 13);
+        assert(*map.get(h0) == 10 && *map.get(h2) == 12 && *map.get(h3) == 13);
+    }
+    {
+        struct Object {
+            int &destroyed;
+            Object(int &d) : destroyed(d) {}
+            ~Object() { destroyed++; }
+        };
+        
+        int destroyed = 0;
+        std::shared_ptr<util::SlotMap<Object *>> map = std::make_shared<util::SlotMap<Object *>>();
+        std::shared_ptr<Object> a = util::makeSlotShared(map, std::make_unique<Object>(destroyed));
+        std::shared_ptr<Object> b = util::makeSlotShared(map, std::make_unique<Object>(destroyed));
+        std::shared_ptr<Object> c = util::makeSlotShared(map, std::make_unique<Object>(destroyed));
+        Object *bptr = b.get();
+        
+        a = nullptr;
+        assert(destroyed == 1 && (*map)[0] == nullptr);
+        map->compact();
+        assert(map->size() == 2 && (*map)[0] == bptr && (*map)[1] == c.get());
+        
+        std::weak_ptr<util::SlotMap<Object *>> weakMap = map;
+        map = nullptr;
+        assert(weakMap.expired() == false);
+        b = nullptr;
+        c = nullptr;
+        assert(destroyed == 3 && weakMap.expired());
+    }
 }
 
 void testUtilStrstream() {
@@ -168,16 +334,345 @@ void testUtilDescription() {
 
 void testUtil() {
     testUtilCallback();
+    testUtilFrameArena();
+    testUtilSlotMap();
     testUtilStrstream();
     testUtilDescription();
 }
 
+void testMemoryPool() {
+    const foundation::MemoryPoolId pool = foundation::MemoryPoolId::SCENE;
+    void *early = foundation::MemoryPool::allocate(pool, 100, 1);
+    foundation::MemoryPool::enableTLSF(pool, 64 * 1024);
+    
+    std::vector<void *> blocks;
+    for (std::size_t i = 0; i < 1000; i++) {
+        blocks.emplace_back(foundation::MemoryPool::allocate(pool, 16 + i % 200, std::uint8_t(i % 3)));
+    }
+    for (std::size_t i = 0; i < blocks.size(); i += 2) {
+        foundation::MemoryPool::free(blocks[i]);
+    }
+    
+    foundation::MemoryPoolStats stats = foundation::MemoryPool::getStats(pool);
+    printf("[testMemoryPool] reserved: %d, used: %d, high-water: %d, fragmentation: %.2f\n", int(stats.reservedBytes), int(stats.usedBytes), int(stats.highWaterBytes), stats.fragmentation);
+    assert(stats.tlsfBacked && stats.allocationCount == 501);
+    assert(stats.usedBytes == stats.tagBytes[0] + stats.tagBytes[1] + stats.tagBytes[2]);
+    assert(stats.highWaterBytes > stats.usedBytes);
+    assert(stats.fragmentation > 0.0f);
+    
+    for (std::size_t i = 1; i < blocks.size(); i += 2) {
+        foundation::MemoryPool::free(blocks[i]);
+    }
+    foundation::MemoryPool::free(early);
+    
+    {
+        std::vector<int, foundation::PoolAllocator<int, foundation::MemoryPoolId::SCENE, 4>> values;
+        for (int i = 0; i < 1000; i++) {
+            values.emplace_back(i);
+        }
+        assert(foundation::MemoryPool::getStats(pool).tagBytes[4] >= 1000 * sizeof(int));
+    }
+    {
+        foundation::FixedSizePool items (pool, 40, 64, 5);
+        std::vector<void *> ptrs;
+        
+        for (int i = 0; i < 2; i++) {
+            for (std::size_t c = 0; c < 200; c++) {
+                ptrs.emplace_back(items.allocate());
+                std::memset(ptrs.back(), 0xff, 40);
+            }
+            for (void *ptr : ptrs) {
+                items.free(ptr);
+            }
+            ptrs.clear();
+        }
+        
+        assert(items.getUsedCount() == 0 && items.getBlockCount() == 4);
+        assert(foundation::MemoryPool::getStats(pool).tagBytes[5] >= 200 * 40);
+    }
+    {
+        // SIMD types are aligned in every pool allocation and pooled item
+        foundation::FixedSizePool items (pool, sizeof(math::transform3f), 7, 5);
+        std::vector<void *> ptrs;
+        
+        for (std::size_t i = 0; i < 20; i++) {
+            ptrs.emplace_back(items.allocate());
+            ptrs.emplace_back(foundation::MemoryPool::allocate(pool, sizeof(math::transform3f) + i * 3));
+        }
+        for (std::size_t i = 0; i < ptrs.size(); i++) {
+            assert(reinterpret_cast<std::uintptr_t>(ptrs[i]) % alignof(math::transform3f) == 0);
+            assert(reinterpret_cast<std::uintptr_t>(ptrs[i]) % foundation::MemoryPool::ALIGNMENT == 0);
+            new (ptrs[i]) math::transform3f (math::transform3f::identity());
+            if (i % 2) {
+                foundation::MemoryPool::free(ptrs[i]);
+            }
+            else {
+                items.free(ptrs[i]);
+            }
+        }
+    }
+    
+    stats = foundation::MemoryPool::getStats(pool);
+    assert(stats.usedBytes == 0 && stats.allocationCount == 0);
+}
+
+void testJobSystem() {
+    const std::size_t count = 10000;
+    std::vector<int> visits (count, 0);
+    
+    for (int i = 0; i < 3; i++) {
+        foundation::JobSystem::parallelFor(count, [&visits](std::size_t index) {
+            visits[index]++;
+        });
+    }
+    for (std::size_t i = 0; i < count; i++) {
+        assert(visits[i] == 3);
+    }
+    
+    printf("[testJobSystem] threads: %d\n", int(foundation::JobSystem::getThreadCount()));
+}
+
+math::transform3f testMathReferenceMultiply(const math::transform3f &t0, const math::transform3f &t1) {
+    math::transform3f result;
+    for (int i = 0; i < 4; i++) {
+        for (int c = 0; c < 4; c++) {
+            result.flat[i * 4 + c] = 0.0f;
+            for (int k = 0; k < 4; k++) {
+                result.flat[i * 4 + c] += t0.flat[i * 4 + k] * t1.flat[k * 4 + c];
+            }
+        }
+    }
+    return result;
+}
+
+bool testMathEqual(const math::transform3f &t0, const math::transform3f &t1, float eps) {
+    for (int i = 0; i < 16; i++) {
+        if (std::fabs(t0.flat[i] - t1.flat[i]) > eps) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void testMath() {
+    const std::size_t count = 4096;
+    
+    std::vector<math::transform3f> transforms (count);
+    std::vector<math::vector3f> points (count);
+    
+    for (std::size_t i = 0; i < count; i++) {
+        const float f = float(i);
+        const math::transform3f scale = math::transform3f({1.0f + f * 0.001f, 0, 0, 0}, {0, 1.5f, 0, 0}, {0, 0, 0.5f, 0}, {0, 0, 0, 1});
+        transforms[i] = scale * math::transform3f(math::vector3f(std::sin(f), 1.0f, std::cos(f)).normalized(), f * 0.1f).translated({f * 0.01f, -f * 0.005f, 2.0f});
+        points[i] = math::vector3f(f * 0.3f, -f, 1.0f + f * 0.01f);
+    }
+    
+    const math::transform3f &trfm = transforms[7];
+    
+    for (std::size_t i = 0; i < count; i++) {
+        assert(testMathEqual(transforms[i] * trfm, testMathReferenceMultiply(transforms[i], trfm), 0.01f));
+        assert(testMathEqual(transforms[i] * transforms[i].inverted(), math::transform3f::identity(), 0.001f));
+        
+        const math::vector3f p = points[i].transformed(trfm, true);
+        assert(std::fabs(p.x - (points[i].x * trfm.m11 + points[i].y * trfm.m21 + points[i].z * trfm.m31 + trfm.m41)) < 0.01f);
+        assert(std::fabs(p.y - (points[i].x * trfm.m12 + points[i].y * trfm.m22 + points[i].z * trfm.m32 + trfm.m42)) < 0.01f);
+        assert(std::fabs(p.z - (points[i].x * trfm.m13 + points[i].y * trfm.m23 + points[i].z * trfm.m33 + trfm.m43)) < 0.01f);
+    }
+    
+    std::vector<math::transform3f> transformsOut (count);
+    std::vector<math::vector3f> pointsOut (count);
+    
+    // Batch functions against per-item functions; odd counts cover the scalar tail, in-place covers aliasing
+    for (std::size_t batch : {count, count - 1, std::size_t(7), std::size_t(3), std::size_t(0)}) {
+        math::multiplyMany(transforms.data(), transformsOut.data(), batch, trfm);
+        math::transformPoints(points.data(), pointsOut.data(), batch, trfm);
+        
+        for (std::size_t i = 0; i < batch; i++) {
+            assert(testMathEqual(transformsOut[i], transforms[i] * trfm, 0.001f));
+            assert(testMathEqual(transformsOut[i], testMathReferenceMultiply(transforms[i], trfm), 0.01f));
+            assert((pointsOut[i] - points[i].transformed(trfm, true)).length() < 0.00001f * (1.0f + pointsOut[i].length()));
+        }
+        
+        std::copy(transforms.begin(), transforms.end(), transformsOut.begin());
+        std::copy(points.begin(), points.end(), pointsOut.begin());
+        math::multiplyMany(transformsOut.data(), transformsOut.data(), batch, trfm);
+        math::transformPoints(pointsOut.data(), pointsOut.data(), batch, trfm);
+        
+        for (std::size_t i = 0; i < count; i++) {
+            const math::transform3f t = i < batch ? transforms[i] * trfm : transforms[i];
+            const math::vector3f p = i < batch ? points[i].transformed(trfm, true) : points[i];
+            assert(testMathEqual(transformsOut[i], t, 0.001f));
+            assert((pointsOut[i] - p).length() < 0.00001f * (1.0f + p.length()));
+        }
+    }
+}
+
+// Platform that completes async tasks when test wants, so the frame order of the engine can be reproduced
+//
+class TestPlatform : public foundation::PlatformInterface {
+public:
+    void completeTasks() {
+        std::vector<std::unique_ptr<foundation::AsyncTask>> tasks = std::move(_tasks);
+        _tasks.clear();
+        
+        for (auto &task : tasks) {
+            task->executeInBackground();
+            task->executeInMainThread();
+        }
+    }
+    
+    auto getErrorCount() const -> int { return _errorCount; }
+    
+public:
+    void logMsg(const char *fmt, ...) override {}
+    void logError(const char *fmt, ...) override {
+        va_list args;
+        va_start(args, fmt);
+        vprintf(fmt, args);
+        va_end(args);
+        _errorCount++;
+    }
+    
+    void executeAsync(std::unique_ptr<foundation::AsyncTask> &&task) override { _tasks.emplace_back(std::move(task)); }
+    void loadFile(const char *filePath, util::callback<void(std::unique_ptr<std::uint8_t[]> &&data, std::size_t size)> &&completion) override { completion(nullptr, 0); }
+    void saveFile(const char *filePath, const std::uint8_t *data, std::size_t size, util::callback<void(bool)> &&completion) override { completion(false); }
+    float getScreenWidth() const override { return 1024.0f; }
+    float getScreenHeight() const override { return 768.0f; }
+    void *attachNativeRenderingContext(void *context) override { return nullptr; }
+    void showCursor() override {}
+    void hideCursor() override {}
+    void showKeyboard() override {}
+    void hideKeyboard() override {}
+    void sendEditorMsg(const std::string &msg, const std::string &data) override {}
+    void editorLoopbackMsg(const std::string &msg, const std::string &data) override {}
+    foundation::EventHandlerToken addEditorEventHandler(util::callback<bool(const std::string &, const std::string &)> &&handler, bool setTop) override { return nullptr; }
+    foundation::EventHandlerToken addKeyboardEventHandler(util::callback<bool(const foundation::PlatformKeyboardEventArgs &)> &&handler, bool setTop) override { return nullptr; }
+    foundation::EventHandlerToken addInputEventHandler(util::callback<bool(const char(&utf8char)[4])> &&input, bool setTop) override { return nullptr; }
+    foundation::EventHandlerToken addPointerEventHandler(util::callback<bool(const foundation::PlatformPointerEventArgs &)> &&handler, bool setTop) override { return nullptr; }
+    foundation::EventHandlerToken addGamepadEventHandler(util::callback<bool(const foundation::PlatformGamepadEventArgs &)> &&handler, bool setTop) override { return nullptr; }
+    void removeEventHandler(foundation::EventHandlerToken token) override {}
+    void setLoop(util::callback<void(float)> &&updateAndDraw) override {}
+    void setResizeHandler(util::callback<void()> &&handler) override {}
+    void exit() override {}
+    
+private:
+    std::vector<std::unique_ptr<foundation::AsyncTask>> _tasks;
+    int _errorCount = 0;
+};
+
+// Rendering that only counts created textures
+//
+class TestRendering : public foundation::RenderingInterface {
+public:
+    class Texture : public foundation::RenderTexture {
+    public:
+        Texture(std::uint32_t w, std::uint32_t h) : _w(w), _h(h) {}
+        auto getWidth() const -> std::uint32_t override { return _w; }
+        auto getHeight() const -> std::uint32_t override { return _h; }
+        auto getMipCount() const -> std::uint32_t override { return 1; }
+        auto getFormat() const -> foundation::RenderTextureFormat override { return foundation::RenderTextureFormat::R8UN; }
+        
+    private:
+        const std::uint32_t _w, _h;
+    };
+    
+    auto getTextureCount() const -> int { return _textureCount; }
+    
+public:
+    void updateFrameConstants(const math::transform3f &vp, const math::transform3f &svp, const math::transform3f &ivp, const math::vector3f &camPos, const math::vector3f &camDir) override {}
+    auto createShader(const char *name, const char *src, const foundation::InputLayout &layout) -> foundation::RenderShaderPtr override { return nullptr; }
+    auto createTexture(foundation::RenderTextureFormat format, std::uint32_t w, std::uint32_t h, const std::initializer_list<const void *> &mipsData) -> foundation::RenderTexturePtr override {
+        _textureCount++;
+        return std::make_shared<Texture>(w, h);
+    }
+    auto createRenderTarget(foundation::RenderTextureFormat format, std::uint32_t textureCount, std::uint32_t w, std::uint32_t h, bool withZBuffer) -> foundation::RenderTargetPtr override { return nullptr; }
+    auto createData(const foundation::InputLayout &layout, const void *data, std::uint32_t vcnt, const std::uint32_t *indexes, std::uint32_t icnt) -> foundation::RenderDataPtr override { return nullptr; }
+    auto getBackBufferWidth() const -> float override { return 1024.0f; }
+    auto getBackBufferHeight() const -> float override { return 768.0f; }
+    auto getStdVPMatrix() const -> math::transform3f override { return math::transform3f::identity(); }
+    void forTarget(const foundation::RenderTargetPtr &target, const foundation::RenderTexturePtr &depth, const std::optional<math::color> &rgba, util::callback<void(foundation::RenderingInterface &)> &&pass) override { pass(*this); }
+    void applyShader(const foundation::RenderShaderPtr &shader, foundation::RenderTopology topology, foundation::BlendType blendType, foundation::DepthBehavior depthBehavior) override {}
+    void applyTextures(const std::initializer_list<std::pair<foundation::RenderTexturePtr, foundation::SamplerType>> &textures) override {}
+    void applyTextures(const std::vector<std::pair<foundation::RenderTexturePtr, foundation::SamplerType>> &textures) override {}
+    void applyShaderConstants(const void *constants) override {}
+    void draw(std::uint32_t vertexCount) override {}
+    void draw(const foundation::RenderDataPtr &inputData, std::uint32_t instanceCount) override {}
+    void draw(const foundation::RenderDataPtr &inputData, std::uint32_t start, std::uint32_t count, std::uint32_t instanceCount) override {}
+    void draw(const void *data, std::uint32_t vcnt, const std::uint32_t *indexes, std::uint32_t icnt) override {}
+    void presentFrame() override {}
+    
+private:
+    int _textureCount = 0;
+};
+
+// Frame order of the engine: async completions, stage draw (text is requested again if its texture is expired), provider update
+// Static labels have to keep their glyphs while the page texture is replaced by new texts
+//
+void testFontAtlas(std::unique_ptr<std::uint8_t[]> &&ttfData, std::size_t ttfSize) {
+    const std::shared_ptr<TestPlatform> testPlatform = std::make_shared<TestPlatform>();
+    const std::shared_ptr<TestRendering> testRendering = std::make_shared<TestRendering>();
+    const resource::FontAtlasProviderPtr fontAtlas = resource::FontAtlasProvider::instance(testPlatform, testRendering, std::move(ttfData), ttfSize);
+    
+    struct Label {
+        const char *text;
+        std::weak_ptr<foundation::RenderTexture> texture;
+        int requestCount = 0;
+        int framesWithoutTexture = 0;   // after it was shown
+        bool shown = false;
+    };
+    
+    Label score = {"Score: 123"};
+    Label lives = {"Lives: 3"};
+    
+    const auto draw = [&](Label &label) {
+        if (label.texture.expired()) {
+            label.requestCount++;
+            
+            fontAtlas->getTextFontAtlas(label.text, 20, 0, [&label](std::vector<resource::FontCharInfo> &&chars, const foundation::RenderTexturePtr &texture) {
+                assert(chars.size() == std::strlen(label.text));
+                label.texture = texture;
+            });
+        }
+        
+        label.framesWithoutTexture += label.shown && label.texture.expired() ? 1 : 0;
+        label.shown = label.shown || label.texture.expired() == false;
+    };
+    
+    for (int frame = 0; frame < 30; frame++) {
+        testPlatform->completeTasks();
+        draw(score);
+        
+        if (frame >= 10) {
+            draw(lives);
+        }
+        
+        fontAtlas->update(0.016f);
+    }
+    
+    const resource::FontAtlasStats stats = fontAtlas->getStats();
+    
+    printf("[testFontAtlas] requests: %d + %d, textures: %d, glyphs: %d\n", score.requestCount, lives.requestCount, testRendering->getTextureCount(), int(stats.glyphCount));
+    
+    assert(testPlatform->getErrorCount() == 0);
+    assert(score.requestCount == 2 && score.framesWithoutTexture == 0); // page texture is replaced once, when lives are added
+    assert(lives.requestCount == 1 && lives.framesWithoutTexture == 0);
+    assert(testRendering->getTextureCount() == 2 && stats.pageCount == 1);
+}
+
 extern "C" void initialize() {
     testUtil();
+    testMemoryPool();
+    testJobSystem();
+    testMath();
+    dh::testDataHub();
     
     platform = foundation::PlatformInterface::instance();
-    platform->setLoop([](float dtSec) {
-        platform->exit();
+    platform->loadFile("arial.ttf", [](std::unique_ptr<std::uint8_t[]> &&fontData, std::size_t fontSize) {
+        testFontAtlas(std::move(fontData), fontSize);
+        
+        platform->setLoop([](float dtSec) {
+            platform->exit();
+        });
     });
 }
 
@@ -56,6 +56,7 @@
 
 #include "tlsf.h"
 #include <memory>
+#include <cstring>
 
 /*************************************************************************/
 /* Definition of the structures used by TLSF */
@@ -524,6 +525,30 @@ void free_ex(void *ptr, void *mem_pool)
     tmp_b->prev_hdr = b;
 }
 
+/******************************************************************/
+void free_stats(void *mem_pool, size_t *total_free, size_t *largest_free)
+{
+/******************************************************************/
+    tlsf_t *tlsf = (tlsf_t *) mem_pool;
+    bhdr_t *b;
+    size_t fl, sl, size;
+
+    *total_free = 0;
+    *largest_free = 0;
+
+    for (fl = 0; fl < REAL_FLI; fl++) {
+        for (sl = 0; sl < MAX_SLI; sl++) {
+            for (b = tlsf->matrix[fl][sl]; b; b = b->ptr.free_ptr.next) {
+                size = b->size & BLOCK_SIZE;
+                *total_free += size;
+                if (size > *largest_free) {
+                    *largest_free = size;
+                }
+            }
+        }
+    }
+}
+
 
 } // tlsf namespace
 
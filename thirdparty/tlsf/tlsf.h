@@ -4,6 +4,7 @@
  * Removed all functionality dependent on system API so it can be used on unknown platform
  * Removed mt locks and statistics
  * Removed realloc/calloc
+ * Added free_stats query
  * Strict integer types
  * C++ conformance (also placed to namespace)
 */
@@ -39,6 +40,8 @@ namespace tlsf {
     
     void *malloc_ex(size_t, void *);
     void free_ex(void *, void *);
+    
+    void free_stats(void *, size_t *, size_t *);
 }
 
 #endif
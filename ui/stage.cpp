@@ -1,16 +1,191 @@
 
 #include "stage.h"
 #include "foundation/layouts.h"
+#include "foundation/memory.h"
 
+#include <algorithm>
 #include <list>
 #include <memory>
+#include <unordered_map>
+
+namespace {
+    const std::uint8_t MEMORY_TAG_TEXT_INSTANCES = 1;
+    const std::uint8_t MEMORY_TAG_DRAW_LIST = 2;
+    const std::uint8_t MEMORY_TAG_IMAGE_INSTANCES = 3;
+}
 
 namespace ui {
     struct DrawingInstance {
         math::vector4f positionAndSize;
         math::vector4f uvCoords;
         math::color color;
-        math::vector4f args; //[is R component only, 0, 0, 0]
+        math::vector4f args; //[is R component only, is distance field, edge value, edge sharpness]
+    };
+
+    // Instances of the whole stage in drawing order
+    // Consecutive instances with the same texture and sampler are drawn by one call, so order of elements is kept
+    // Instances are kept between frames. While elements come in the same order with the same instance counts,
+    // only ranges of changed elements are written again
+    //
+    class DrawList {
+    public:
+        void begin() {
+            _batches.clear();
+            _entryIndex = 0;
+            _retained = true;
+        }
+        void append(const void *owner, const foundation::RenderTexturePtr &texture, const DrawingInstance *instances, std::uint32_t count, bool changed, foundation::SamplerType sampler = foundation::SamplerType::NEAREST) {
+            if (count) {
+                const std::uint32_t start = _entryIndex ? _entries[_entryIndex - 1].start + _entries[_entryIndex - 1].count : 0;
+                
+                if (_retained && _entryIndex < _entries.size() && _entries[_entryIndex].owner == owner && _entries[_entryIndex].count == count) {
+                    if (changed) {
+                        std::copy(instances, instances + count, _instances.begin() + start);
+                    }
+                }
+                else {
+                    _retained = false;
+                    _entries.resize(_entryIndex);
+                    _entries.emplace_back(Entry{owner, start, count});
+                    _instances.resize(start);
+                    _instances.insert(_instances.end(), instances, instances + count);
+                }
+                
+                if (_batches.empty() || _batches.back().texture != texture || _batches.back().sampler != sampler) {
+                    _batches.emplace_back(Batch{texture, sampler, start, 0});
+                }
+                
+                _batches.back().count += count;
+                _entryIndex++;
+            }
+        }
+        void end() {
+            if (_entryIndex < _entries.size()) {
+                _instances.resize(_entries[_entryIndex].start);
+                _entries.resize(_entryIndex);
+            }
+        }
+        void flush(foundation::RenderingInterface &rendering) {
+            for (const Batch &batch : _batches) {
+                rendering.applyTextures({{batch.texture, batch.sampler}});
+                rendering.draw(_instances.data() + batch.start, batch.count);
+            }
+        }
+        
+    private:
+        struct Entry {
+            const void *owner;
+            std::uint32_t start;
+            std::uint32_t count;
+        };
+        struct Batch {
+            foundation::RenderTexturePtr texture;
+            foundation::SamplerType sampler;
+            std::uint32_t start;
+            std::uint32_t count;
+        };
+        
+        std::vector<DrawingInstance, foundation::PoolAllocator<DrawingInstance, foundation::MemoryPoolId::UI, MEMORY_TAG_DRAW_LIST>> _instances;
+        std::vector<Entry> _entries; // elements appended in the last frame
+        std::vector<Batch> _batches;
+        std::size_t _entryIndex = 0;
+        bool _retained = true;
+    };
+    
+    class InteractorImpl;
+    
+    // Screen cells with interactors whose active area touches them, so a press checks only interactors under pointer
+    // Interactors that have captured pointer get its moves and release wherever they are
+    // Interactors remove themselves on destruction
+    //
+    class InteractionGrid {
+    public:
+        static constexpr float CELL_SIZE = 64.0f;
+        static const std::int32_t CELLS_PER_INTERACTOR_MAX = 64; // bigger interactors are checked on every press
+        
+        struct Location {
+            std::int32_t xmin = 0, ymin = 0, xmax = -1, ymax = -1; // empty range if not placed
+            bool oversized = false;
+        };
+        
+    public:
+        void place(InteractorImpl *interactor, const math::vector2f &lt, const math::vector2f &rb, Location &location) {
+            Location next;
+            next.xmin = _getCellCoord(std::min(lt.x, rb.x));
+            next.ymin = _getCellCoord(std::min(lt.y, rb.y));
+            next.xmax = _getCellCoord(std::max(lt.x, rb.x));
+            next.ymax = _getCellCoord(std::max(lt.y, rb.y));
+            next.oversized = std::int64_t(next.xmax - next.xmin + 1) * std::int64_t(next.ymax - next.ymin + 1) > CELLS_PER_INTERACTOR_MAX;
+            
+            if (next.xmin != location.xmin || next.ymin != location.ymin || next.xmax != location.xmax || next.ymax != location.ymax) {
+                _forEachCell(location, [interactor](std::vector<InteractorImpl *> &cell) {
+                    cell.erase(std::remove(cell.begin(), cell.end(), interactor), cell.end());
+                });
+                
+                location = next;
+                
+                _forEachCell(location, [interactor](std::vector<InteractorImpl *> &cell) {
+                    cell.emplace_back(interactor);
+                });
+            }
+        }
+        void remove(InteractorImpl *interactor, Location &location) {
+            _forEachCell(location, [interactor](std::vector<InteractorImpl *> &cell) {
+                cell.erase(std::remove(cell.begin(), cell.end(), interactor), cell.end());
+            });
+            
+            location = Location();
+            setCaptured(interactor, false);
+        }
+        void setCaptured(InteractorImpl *interactor, bool captured) {
+            _captured.erase(std::remove(_captured.begin(), _captured.end(), interactor), _captured.end());
+            
+            if (captured) {
+                _captured.emplace_back(interactor);
+            }
+        }
+        void getCandidates(float x, float y, std::vector<InteractorImpl *> &output) const {
+            const auto index = _cells.find(_getCellKey(_getCellCoord(x), _getCellCoord(y)));
+            if (index != _cells.end()) {
+                output.insert(output.end(), index->second.begin(), index->second.end());
+            }
+            
+            output.insert(output.end(), _oversized.begin(), _oversized.end());
+        }
+        void getCaptured(std::vector<InteractorImpl *> &output) const {
+            output.insert(output.end(), _captured.begin(), _captured.end());
+        }
+        
+    private:
+        static const std::int32_t CELL_COORD_MAX = 1 << 24;
+        
+        // Elements far off screen or with infinite coordinates are clamped, so casting is defined
+        static auto _getCellCoord(float value) -> std::int32_t {
+            const float coord = std::floor(value / CELL_SIZE);
+            if (coord >= float(-CELL_COORD_MAX)) {
+                return coord <= float(CELL_COORD_MAX) ? std::int32_t(coord) : CELL_COORD_MAX;
+            }
+            return -CELL_COORD_MAX;
+        }
+        static auto _getCellKey(std::int32_t x, std::int32_t y) -> std::uint64_t {
+            return std::uint64_t(std::uint32_t(x)) | (std::uint64_t(std::uint32_t(y)) << 32);
+        }
+        template<typename F> void _forEachCell(const Location &location, F &&visitor) {
+            if (location.oversized) {
+                visitor(_oversized);
+            }
+            else {
+                for (std::int32_t y = location.ymin; y <= location.ymax; y++) {
+                    for (std::int32_t x = location.xmin; x <= location.xmax; x++) {
+                        visitor(_cells[_getCellKey(x, y)]);
+                    }
+                }
+            }
+        }
+        
+        std::unordered_map<std::uint64_t, std::vector<InteractorImpl *>> _cells;
+        std::vector<InteractorImpl *> _oversized;
+        std::vector<InteractorImpl *> _captured;
     };
 
     class StageFacility {
@@ -19,6 +194,7 @@ namespace ui {
         virtual const foundation::RenderingInterfacePtr &getRendering() const = 0;
         virtual const resource::ResourceProviderPtr &getResourceProvider() const = 0;
         virtual const resource::FontAtlasProviderPtr &getFontAtlasProvider() const = 0;
+        virtual const std::shared_ptr<InteractionGrid> &getInteractionGrid() const = 0;
         virtual ~StageFacility() = default;
     };
 }
@@ -29,14 +205,23 @@ namespace ui {
     class ElementImpl : public virtual StageInterface::Element {
     public:
         ElementImpl(const StageFacility &facility, const std::shared_ptr<Element> &parent) : _facility(facility), _parent(std::dynamic_pointer_cast<ElementImpl>(parent)) {}
-        ~ElementImpl() override {}
+        ~ElementImpl() override {
+            if (auto target = _anchorTarget.lock()) {
+                target->_removeAnchored(this);
+            }
+        }
         
         void setAnchor(const std::shared_ptr<Element> &target, HorizontalAnchor h, VerticalAnchor v, float hOffset, float vOffset) {
             if (target) {
                 std::shared_ptr<ElementImpl> targetImpl = std::dynamic_pointer_cast<ElementImpl>(target);
                 if (targetImpl->_parent.lock() == _parent.lock()) {
                     if (targetImpl->_anchorTarget.lock().get() != this) {
+                        if (auto previous = _anchorTarget.lock()) {
+                            previous->_removeAnchored(this);
+                        }
+                        
                         _anchorTarget = targetImpl;
+                        targetImpl->_anchoredElements.emplace_back(this);
                     }
                     else {
                         _facility.getPlatform()->logError("[ElementImpl::setAnchor] Cyclic anchor is not allowed\n");
@@ -50,10 +235,74 @@ namespace ui {
             _anchorOffsets = math::vector2f(hOffset, vOffset);
             _hAnchor = h;
             _vAnchor = v;
+            invalidateLayout();
         }
         void attachElement(const std::shared_ptr<ElementImpl> &element) {
             _attachedElements.emplace_back(element);
+            element->invalidateLayout();
+        }
+        
+        // Element is placed again only if it's invalidated: its size or anchor has changed or the element it depends on has moved
+        //
+        void invalidateLayout() {
+            _layoutDirty = true;
+            
+            for (auto parent = _parent.lock(); parent && parent->_descendantsDirty == false; parent = parent->_parent.lock()) {
+                parent->_descendantsDirty = true;
+            }
         }
+        
+        // Volatile element is placed every frame (it follows world position for example)
+        //
+        void setLayoutVolatile(bool isVolatile) {
+            if (_layoutVolatile != isVolatile) {
+                _layoutVolatile = isVolatile;
+                
+                for (auto parent = _parent.lock(); parent; parent = parent->_parent.lock()) {
+                    parent->_volatileDescendants += isVolatile ? 1 : -1;
+                }
+            }
+            
+            invalidateLayout();
+        }
+        
+        // Pointer events go to interactors in this order: children before parent, siblings in attach order
+        //
+        static void updateInteractionOrder(const std::list<std::shared_ptr<ElementImpl>> &elements, std::uint32_t &order) {
+            for (const auto &item : elements) {
+                updateInteractionOrder(item->_attachedElements, order);
+                item->_interactionOrder = order++;
+            }
+        }
+        auto getInteractionOrder() const -> std::uint32_t {
+            return _interactionOrder;
+        }
+        
+        // Places invalidated elements from the list and their descendants
+        // Elements anchored to the next ones in the list are placed in the following pass
+        //
+        static void updateLayout(const std::list<std::shared_ptr<ElementImpl>> &elements) {
+            for (const auto &item : elements) {
+                if (item->_layoutDirty || item->_descendantsDirty || item->_layoutVolatile || item->_volatileDescendants) {
+                    item->_updateLayout();
+                }
+            }
+            for (std::size_t pass = 0; pass < elements.size(); pass++) {
+                bool updated = false;
+                
+                for (const auto &item : elements) {
+                    if (item->_layoutDirty || item->_descendantsDirty) {
+                        item->_updateLayout();
+                        updated = true;
+                    }
+                }
+                
+                if (updated == false) {
+                    break;
+                }
+            }
+        }
+        
         const math::vector2f &getPosition() const override {
             return _globalPosition;
         }
@@ -104,23 +353,20 @@ namespace ui {
             else if (_vAnchor == VerticalAnchor::BOTTOMSIDE) {
                 _globalPosition.y = rb.y + _anchorOffsets.y;
             }
-            
-            for (auto &item : _attachedElements) {
-                item->updateCoordinates();
-            }
         }
-        virtual bool onInteraction(ui::Action action, std::size_t id, float x, float y) {
+        virtual void draw(DrawList &drawList) {
             for (auto &item : _attachedElements) {
-                if (item->onInteraction(action, id, x, y)) {
-                    return true;
-                }
+                item->draw(drawList);
             }
-            
-            return false;
         }
-        virtual void draw() {
-            for (auto &item : _attachedElements) {
-                item->draw();
+        
+    protected:
+        virtual void _onRectChanged() {}
+        
+        void _setSize(const math::vector2f &size) {
+            if (_size.x != size.x || _size.y != size.y) {
+                _size = size;
+                invalidateLayout();
             }
         }
         
@@ -133,11 +379,51 @@ namespace ui {
         math::vector2f _anchorOffsets = math::vector2f(0, 0);
 
         std::list<std::shared_ptr<ElementImpl>> _attachedElements;
+        bool _instancesDirty = true; // element should fill its drawing instances again
 
+    private:
+        void _updateLayout() {
+            if (_layoutDirty || _layoutVolatile) {
+                const math::vector2f position = _globalPosition;
+                
+                _layoutDirty = false;
+                updateCoordinates();
+                
+                if (position.x != _globalPosition.x || position.y != _globalPosition.y || _layoutSize.x != _size.x || _layoutSize.y != _size.y) {
+                    _layoutSize = _size;
+                    _instancesDirty = true;
+                    _onRectChanged();
+                    
+                    for (auto &item : _attachedElements) {
+                        item->_layoutDirty = true;
+                        _descendantsDirty = true;
+                    }
+                    for (ElementImpl *item : _anchoredElements) {
+                        item->invalidateLayout();
+                    }
+                }
+            }
+            if (_descendantsDirty || _volatileDescendants) {
+                updateLayout(_attachedElements);
+                _descendantsDirty = false;
+            }
+        }
+        void _removeAnchored(ElementImpl *element) {
+            _anchoredElements.erase(std::remove(_anchoredElements.begin(), _anchoredElements.end(), element), _anchoredElements.end());
+        }
+        
     private:
         std::weak_ptr<ElementImpl> _anchorTarget;
+        std::vector<ElementImpl *> _anchoredElements; // siblings anchored to this element, they remove themselves on destruction
         HorizontalAnchor _hAnchor = HorizontalAnchor::LEFT;
         VerticalAnchor _vAnchor = VerticalAnchor::TOP;
+        
+        math::vector2f _layoutSize = math::vector2f(-1.0f, -1.0f); // so the first placing is a change
+        std::uint32_t _interactionOrder = 0;
+        bool _layoutDirty = true;
+        bool _layoutVolatile = false;
+        bool _descendantsDirty = false;
+        int _volatileDescendants = 0;
     };
 }
 
@@ -146,21 +432,23 @@ namespace ui {
 namespace ui {
     class InteractorImpl : public ElementImpl, public virtual StageInterface::Interactor {
     public:
-        InteractorImpl(const StageFacility &facility, const std::shared_ptr<Element> &parent) : ElementImpl(facility, parent) {}
-        ~InteractorImpl() override {}
+        InteractorImpl(const StageFacility &facility, const std::shared_ptr<Element> &parent) : ElementImpl(facility, parent), _interactionGrid(facility.getInteractionGrid()) {}
+        ~InteractorImpl() override {
+            // interactor may outlive the stage if it's held outside
+            if (std::shared_ptr<InteractionGrid> grid = _interactionGrid.lock()) {
+                grid->remove(this, _gridLocation);
+            }
+        }
         
         void setActiveArea(float offset, float radius) {
             _activeAreaOffset = offset;
             _activeAreaRadius = radius;
+            _onRectChanged();
         }
         void setActionHandler(util::callback<void(ui::Action action, float x, float y)> &&handler) override {
             _handler = std::move(handler);
         }
-        bool onInteraction(ui::Action action, std::size_t id, float x, float y) override {
-            if (ElementImpl::onInteraction(action, id, x, y)) {
-                return true;
-            }
-            
+        bool onInteraction(ui::Action action, std::size_t id, float x, float y) {
             bool isInArea = false;
             const math::vector2f lt = math::vector2f(_globalPosition.x + _activeAreaOffset, _globalPosition.y + _activeAreaOffset);
             const math::vector2f rb = math::vector2f(_globalPosition.x + _size.x - _activeAreaOffset, _globalPosition.y + _size.y - _activeAreaOffset);
@@ -202,6 +490,7 @@ namespace ui {
             if (isInArea && action == ui::Action::PRESS) {
                 _pointerId = id;
                 _currentAction = action;
+                _facility.getInteractionGrid()->setCaptured(this, true);
 
                 if (_handler) {
                     _handler(action, x, y);
@@ -219,6 +508,7 @@ namespace ui {
             if (action == ui::Action::RELEASE && _pointerId != foundation::INVALID_POINTER_ID) {
                 _pointerId = foundation::INVALID_POINTER_ID;
                 _currentAction = action;
+                _facility.getInteractionGrid()->setCaptured(this, false);
 
                 if (_handler) {
                     _handler(action, x, y);
@@ -229,6 +519,14 @@ namespace ui {
             return false;
         }
         
+    protected:
+        void _onRectChanged() override {
+            const float expand = _activeAreaRadius - _activeAreaOffset;
+            const math::vector2f lt = math::vector2f(_globalPosition.x - expand, _globalPosition.y - expand);
+            const math::vector2f rb = math::vector2f(_globalPosition.x + _size.x + expand, _globalPosition.y + _size.y + expand);
+            _facility.getInteractionGrid()->place(this, lt, rb, _gridLocation);
+        }
+        
     protected:
         bool _capturePointer;
         std::size_t _pointerId = foundation::INVALID_POINTER_ID;
@@ -237,6 +535,8 @@ namespace ui {
     private:
         float _activeAreaOffset = 0.0f;
         float _activeAreaRadius = 0.0f;
+        std::weak_ptr<InteractionGrid> _interactionGrid;
+        InteractionGrid::Location _gridLocation;
         
         util::callback<void(ui::Action action, float x, float y)> _handler;
     };
@@ -272,24 +572,18 @@ namespace ui {
                         _globalPosition.y = (1.0f - tpos.y) * 0.5f * _facility.getPlatform()->getScreenHeight();
                     }
                 }
-                
-                for (auto &item : _attachedElements) {
-                    item->updateCoordinates();
-                }
             }
         }
         void setScreenPosition(const math::vector2f &position) override {
             _state = CoordinateState::SCREEN;
             _screenPosition = position;
+            setLayoutVolatile(false);
         }
         void setWorldPosition(const math::vector3f &position) override {
             _state = CoordinateState::WORLD;
             _worldPosition = position;
+            setLayoutVolatile(true);
         }
-        bool onInteraction(ui::Action action, std::size_t id, float x, float y) override {
-            return ElementImpl::onInteraction(action, id, x, y);
-        }
-        
     private:
         enum class CoordinateState {
             ANCHOR = 0,
@@ -315,41 +609,75 @@ namespace ui {
         
     public:
         void setTexture(const char *texturePath) override {
-            std::string path = texturePath;
-            _facility.getResourceProvider()->getOrLoadTexture(texturePath, [weak = weak_from_this(), path](const foundation::RenderTexturePtr &texture) {
-                if (std::shared_ptr<ImageImpl> self = weak.lock()) {
-                    self->_size.x = texture->getWidth();
-                    self->_size.y = texture->getHeight();
-                    self->_texture = texture;
-                }
-            });
+            _texture = nullptr;
+            _texturePath = texturePath;
+            _textureRequested = false;
+            _requestTexture();
         }
         void setTexture(const foundation::RenderTexturePtr &texture) override {
-            _size.x = texture->getWidth();
-            _size.y = texture->getHeight();
+            _setSize(math::vector2f(texture->getWidth(), texture->getHeight()));
             _texture = texture;
+            _texturePath.clear();
+            _atlasTexture.reset();
+            _uv = math::vector4f(0, 0, 1, 1);
+            _instancesDirty = true;
         }
-        void draw() override {
-            const foundation::RenderingInterfacePtr &rendering = _facility.getRendering();
+        void draw(DrawList &drawList) override {
+            foundation::RenderTexturePtr texture = _texture ? _texture : _atlasTexture.lock();
             
-            if (_texture) {
-                DrawingInstance instance;
-                instance.positionAndSize = math::vector4f(_globalPosition, _size);
-                instance.uvCoords = math::vector4f(0, 0, 1, 1);
-                instance.color = math::vector4f(1.0f, 1.0f, 1.0f, 1.0f);
-                instance.args = math::vector4f(0.0f, 0.0f, 0.0f, 0.0f);
+            if (texture == nullptr && _texturePath.size()) {
+                _requestTexture();
+                texture = _atlasTexture.lock();
+            }
+            if (texture) {
+                if (_instancesDirty) {
+                    _instance.positionAndSize = math::vector4f(_globalPosition, _size);
+                    _instance.uvCoords = _uv;
+                    _instance.color = math::vector4f(1.0f, 1.0f, 1.0f, 1.0f);
+                    _instance.args = math::vector4f(0.0f, 0.0f, 0.0f, 0.0f);
+                }
                 
-                rendering->applyTextures({{_texture, foundation::SamplerType::NEAREST}});
-                rendering->draw(&instance, 1);
+                drawList.append(this, texture, &_instance, 1, _instancesDirty);
+                _instancesDirty = false;
                 
                 for (auto &item : _attachedElements) {
-                    item->draw();
+                    item->draw(drawList);
                 }
             }
         }
         
+    private:
+        // Atlas page is replaced when images are added to it, so it isn't kept and is requested again when expired
+        void _requestTexture() {
+            if (_textureRequested == false) {
+                _textureRequested = true;
+                _facility.getResourceProvider()->getOrLoadAtlasTexture(_texturePath.data(), [weak = weak_from_this(), path = _texturePath](const foundation::RenderTexturePtr &texture, const math::vector4f &uv) {
+                    if (std::shared_ptr<ImageImpl> self = weak.lock()) {
+                        if (self->_texturePath == path) {
+                            self->_textureRequested = false;
+                            
+                            if (texture) {
+                                self->_setSize(math::vector2f(std::roundf((uv.z - uv.x) * float(texture->getWidth())), std::roundf((uv.w - uv.y) * float(texture->getHeight()))));
+                                self->_atlasTexture = texture;
+                                self->_uv = uv;
+                                self->_instancesDirty = true;
+                            }
+                            else {
+                                self->_texturePath.clear();
+                            }
+                        }
+                    }
+                });
+            }
+        }
+        
     private:
         foundation::RenderTexturePtr _texture;
+        std::weak_ptr<foundation::RenderTexture> _atlasTexture;
+        std::string _texturePath;
+        math::vector4f _uv = math::vector4f(0, 0, 1, 1);
+        bool _textureRequested = false;
+        DrawingInstance _instance;
     };
 }
 
@@ -365,24 +693,28 @@ namespace ui {
         
     public:
         void setTexture(const char *texturePath, const math::vector3f &sliceArgs) override {
-            std::string path = texturePath;
-            _facility.getResourceProvider()->getOrLoadTexture(texturePath, [weak = weak_from_this(), path, sliceArgs](const foundation::RenderTexturePtr &texture) {
-                if (std::shared_ptr<Img9SliceImpl> self = weak.lock()) {
-                    self->_texture = texture;
-                    self->_sliceArgs = sliceArgs;
-                }
-            });
+            _texturePath = texturePath;
+            _sliceArgs = sliceArgs;
+            _textureRequested = false;
+            _instancesDirty = true;
+            _requestTexture();
         }
-        void draw() override {
-            const foundation::RenderingInterfacePtr &rendering = _facility.getRendering();
+        void draw(DrawList &drawList) override {
+            foundation::RenderTexturePtr texture = _texture.lock();
             
-            if (_texture) {
+            if (texture == nullptr && _texturePath.size()) {
+                _requestTexture();
+                texture = _texture.lock();
+            }
+            if (texture && _instancesDirty) {
+                const math::vector2f uvSize = math::vector2f(_uv.z - _uv.x, _uv.w - _uv.y);
+                const math::vector2f imageSize = uvSize * math::vector2f(texture->getWidth(), texture->getHeight());
                 const int EGDE_REPEAT_MAX = 10;
                 const int INSTANCES_MAX = EGDE_REPEAT_MAX * 4 + 5;
                 DrawingInstance instances[INSTANCES_MAX] = {0};
                 
                 const math::vector2f rbSliceStart = math::vector2f(_size.x - _sliceArgs.z, _size.y - _sliceArgs.z);
-                const math::vector2f txSliceSize = _sliceArgs.z / math::vector2f(_texture->getWidth(), _texture->getHeight());
+                const math::vector2f txSliceSize = _sliceArgs.z / imageSize;
 
                 math::vector2f edgeLeft = math::vector2f(_size.x - 2.0f * _sliceArgs.z, _size.y - 2.0f * _sliceArgs.z);
                 math::vector2f edgeOffset = math::vector2f(_sliceArgs.z, _sliceArgs.z);
@@ -402,38 +734,72 @@ namespace ui {
                 for (int i = 0; i < EGDE_REPEAT_MAX && edgeLeft.x > 0.0f; i++) {
                     const float repWidth = std::min(edgeLeft.x, _sliceArgs.x);
                     instances[index].positionAndSize = math::vector4f(_globalPosition + math::vector2f(edgeOffset.x, 0), math::vector2f(repWidth, _sliceArgs.z));
-                    instances[index++].uvCoords = math::vector4f(2.0f * txSliceSize.x, 0, 2.0f * txSliceSize.x + (repWidth / _texture->getWidth()), txSliceSize.y);
+                    instances[index++].uvCoords = math::vector4f(2.0f * txSliceSize.x, 0, 2.0f * txSliceSize.x + (repWidth / imageSize.x), txSliceSize.y);
                     instances[index].positionAndSize = math::vector4f(_globalPosition + math::vector2f(edgeOffset.x, rbSliceStart.y), math::vector2f(repWidth, _sliceArgs.z));
-                    instances[index++].uvCoords = math::vector4f(2.0f * txSliceSize.x, txSliceSize.y, 2.0f * txSliceSize.x + (repWidth / _texture->getWidth()), 2.0f * txSliceSize.y);
+                    instances[index++].uvCoords = math::vector4f(2.0f * txSliceSize.x, txSliceSize.y, 2.0f * txSliceSize.x + (repWidth / imageSize.x), 2.0f * txSliceSize.y);
                     edgeLeft.x -= _sliceArgs.x;
                     edgeOffset.x += _sliceArgs.x;
                 }
                 for (int i = 0; i < EGDE_REPEAT_MAX && edgeLeft.y > 0.0f; i++) {
                     const float repHeight = std::min(edgeLeft.y, _sliceArgs.y);
                     instances[index].positionAndSize = math::vector4f(_globalPosition + math::vector2f(0, edgeOffset.y), math::vector2f(_sliceArgs.z, repHeight));
-                    instances[index++].uvCoords = math::vector4f(0, 2.0f * txSliceSize.y, txSliceSize.x, 2.0f * txSliceSize.y + (repHeight / _texture->getHeight()));
+                    instances[index++].uvCoords = math::vector4f(0, 2.0f * txSliceSize.y, txSliceSize.x, 2.0f * txSliceSize.y + (repHeight / imageSize.y));
                     instances[index].positionAndSize = math::vector4f(_globalPosition + math::vector2f(rbSliceStart.x, edgeOffset.y), math::vector2f(_sliceArgs.z, repHeight));
-                    instances[index++].uvCoords = math::vector4f(txSliceSize.x, 2.0f * txSliceSize.y, 2.0f * txSliceSize.x, 2.0f * txSliceSize.y + (repHeight / _texture->getHeight()));
+                    instances[index++].uvCoords = math::vector4f(txSliceSize.x, 2.0f * txSliceSize.y, 2.0f * txSliceSize.x, 2.0f * txSliceSize.y + (repHeight / imageSize.y));
                     edgeLeft.y -= _sliceArgs.y;
                     edgeOffset.y += _sliceArgs.y;
                 }
+                // Texture coordinates above are relative to the image, they are moved to its place in atlas page
                 for (int i = 0; i < index; i++) {
+                    const math::vector4f &uv = instances[i].uvCoords;
+                    instances[i].uvCoords = math::vector4f(_uv.x + uv.x * uvSize.x, _uv.y + uv.y * uvSize.y, _uv.x + uv.z * uvSize.x, _uv.y + uv.w * uvSize.y);
                     instances[i].color = math::color(1.0f, 1.0f, 1.0f, 1.0f);
                     instances[i].args = math::vector4f(0.0f, 0.0f, 0.0f, 0.0f);
                 }
                 
-                rendering->applyTextures({{_texture, foundation::SamplerType::NEAREST}});
-                rendering->draw(instances, index);
+                _instances.assign(instances, instances + index);
+            }
+            if (texture) {
+                drawList.append(this, texture, _instances.data(), std::uint32_t(_instances.size()), _instancesDirty);
+                _instancesDirty = false;
                 
                 for (auto &item : _attachedElements) {
-                    item->draw();
+                    item->draw(drawList);
                 }
             }
         }
         
     private:
-        foundation::RenderTexturePtr _texture;
+        // Atlas page is replaced when images are added to it, so it isn't kept and is requested again when expired
+        void _requestTexture() {
+            if (_textureRequested == false) {
+                _textureRequested = true;
+                _facility.getResourceProvider()->getOrLoadAtlasTexture(_texturePath.data(), [weak = weak_from_this(), path = _texturePath](const foundation::RenderTexturePtr &texture, const math::vector4f &uv) {
+                    if (std::shared_ptr<Img9SliceImpl> self = weak.lock()) {
+                        if (self->_texturePath == path) {
+                            self->_textureRequested = false;
+                            
+                            if (texture) {
+                                self->_texture = texture;
+                                self->_uv = uv;
+                                self->_instancesDirty = true;
+                            }
+                            else {
+                                self->_texturePath.clear();
+                            }
+                        }
+                    }
+                });
+            }
+        }
+        
+    private:
+        std::weak_ptr<foundation::RenderTexture> _texture;
+        std::string _texturePath;
+        math::vector4f _uv = math::vector4f(0, 0, 1, 1);
         math::vector3f _sliceArgs;
+        bool _textureRequested = false;
+        std::vector<DrawingInstance, foundation::PoolAllocator<DrawingInstance, foundation::MemoryPoolId::UI, MEMORY_TAG_IMAGE_INSTANCES>> _instances;
     };
 }
 
@@ -447,7 +813,7 @@ namespace ui {
         
     public:
         void setText(const char *utf8text) override {
-            _size = _facility.getFontAtlasProvider()->getTextWidth(utf8text, _fontSize);
+            _setSize(_facility.getFontAtlasProvider()->getTextWidth(utf8text, _fontSize));
             _text = utf8text;
             _makeText();
         }
@@ -456,19 +822,34 @@ namespace ui {
             return _textureWeak.lock();
         }
         
-        void draw() override {
+        void draw(DrawList &drawList) override {
             if (_instances.size()) {
-                if (auto texture = _textureWeak.lock()) {
-                    const foundation::RenderingInterfacePtr &rendering = _facility.getRendering();
-                    
-                    std::uint32_t instanceCount = 0;
-                    _fillInstances(_shadow, _shadowColor, _shadowOffset, instanceCount);
-                    _fillInstances(_chars, _fontColor, {}, instanceCount);
-                    
-                    if (instanceCount) {
-                        rendering->applyTextures({{texture, foundation::SamplerType::NEAREST}});
-                        rendering->draw(_instances.data(), instanceCount);
+                // Shadow glyphs can be placed on another page than the characters, so both textures are watched
+                foundation::RenderTexturePtr texture = _textureWeak.lock();
+                foundation::RenderTexturePtr shadowTexture = _shadow.size() ? _shadowTextureWeak.lock() : nullptr;
+                
+                if (texture && (_shadow.empty() || shadowTexture)) {
+                    if (_instancesDirty) {
+                        _instanceCount = 0;
+                        _shadowInstanceCount = 0;
+                        
+                        if (_distanceField) {
+                            _fillDistanceFieldInstances();
+                        }
+                        else {
+                            _fillInstances(_shadow, _shadowColor, _shadowOffset, math::vector4f(1.0f, 0.0f, 0.0f, 0.0f), _instanceCount);
+                            _shadowInstanceCount = _instanceCount;
+                            _fillInstances(_chars, _fontColor, {}, math::vector4f(1.0f, 0.0f, 0.0f, 0.0f), _instanceCount);
+                        }
+                    }
+                    if (_shadowInstanceCount) {
+                        drawList.append(&_shadow, shadowTexture, _instances.data(), _shadowInstanceCount, _instancesDirty, foundation::SamplerType::NEAREST);
                     }
+                    
+                    // Distance is interpolated between texels, so scaled glyphs keep smooth edges
+                    const foundation::SamplerType sampler = _distanceField ? foundation::SamplerType::LINEAR : foundation::SamplerType::NEAREST;
+                    drawList.append(this, texture, _instances.data() + _shadowInstanceCount, _instanceCount - _shadowInstanceCount, _instancesDirty, sampler);
+                    _instancesDirty = false;
                 }
                 else {
                     _makeText();
@@ -482,32 +863,87 @@ namespace ui {
             _shadowColor = shadowColor;
             _shadowOffset = shadowOffset;
             _shadowBlur = shadowBlur;
+            _instancesDirty = true;
+        }
+        
+        void setDistanceField(bool distanceField, const math::color &outlineColor, float outlineWidth) {
+            _distanceField = distanceField;
+            _outlineColor = outlineColor;
+            _outlineWidth = outlineWidth;
+            _instancesDirty = true;
         }
         
     private:
+        // Characters and shadow are separate requests and may be delivered in any order
+        // Instances are made when both sets of the latest request are delivered
+        //
         void _makeText() {
+            const std::uint32_t requestIndex = ++_requestIndex;
+            
             _instances.clear();
-
-            if (_shadowColor.a > 0.0f) {
-                _facility.getFontAtlasProvider()->getTextFontAtlas(_text.data(), _fontSize, _shadowBlur, [weak = weak_from_this()](std::vector<resource::FontCharInfo> &&shadow, const foundation::RenderTexturePtr &) {
-                    if (shadow.size()) {
-                        if (std::shared_ptr<TextLineImpl> self = weak.lock()) {
-                            self->_shadow = std::move(shadow);
-                        }
+            _chars.clear();
+            _shadow.clear();
+            _shadowInstanceCount = 0;
+            _charsPending = true;
+            _shadowPending = _distanceField == false && _shadowColor.a > 0.0f;
+            
+            if (_distanceField) {
+                _facility.getFontAtlasProvider()->getTextFontAtlasSDF(_text.data(), _fontSize, [weak = weak_from_this(), requestIndex](std::vector<resource::FontCharInfo> &&chars, const foundation::RenderTexturePtr &texture) {
+                    std::shared_ptr<TextLineImpl> self = weak.lock();
+                    if (self && self->_requestIndex == requestIndex) {
+                        self->_chars = std::move(chars);
+                        self->_textureWeak = texture;
+                        self->_charsPending = false;
+                        self->_onTextDelivered();
                     }
                 });
+                return;
             }
-            _facility.getFontAtlasProvider()->getTextFontAtlas(_text.data(), _fontSize, 0, [weak = weak_from_this()](std::vector<resource::FontCharInfo> &&chars, const foundation::RenderTexturePtr &texture) {
-                if (chars.size()) {
-                    if (std::shared_ptr<TextLineImpl> self = weak.lock()) {
-                        self->_instances.resize(2 * chars.size());
-                        self->_chars = std::move(chars);
-                        self->_textureWeak = texture;
+
+            if (_shadowPending) {
+                _facility.getFontAtlasProvider()->getTextFontAtlas(_text.data(), _fontSize, _shadowBlur, [weak = weak_from_this(), requestIndex](std::vector<resource::FontCharInfo> &&shadow, const foundation::RenderTexturePtr &texture) {
+                    std::shared_ptr<TextLineImpl> self = weak.lock();
+                    if (self && self->_requestIndex == requestIndex) {
+                        self->_shadow = std::move(shadow);
+                        self->_shadowTextureWeak = texture;
+                        self->_shadowPending = false;
+                        self->_onTextDelivered();
                     }
+                });
+            }
+            _facility.getFontAtlasProvider()->getTextFontAtlas(_text.data(), _fontSize, 0, [weak = weak_from_this(), requestIndex](std::vector<resource::FontCharInfo> &&chars, const foundation::RenderTexturePtr &texture) {
+                std::shared_ptr<TextLineImpl> self = weak.lock();
+                if (self && self->_requestIndex == requestIndex) {
+                    self->_chars = std::move(chars);
+                    self->_textureWeak = texture;
+                    self->_charsPending = false;
+                    self->_onTextDelivered();
                 }
             });
         }
-        void _fillInstances(const std::vector<resource::FontCharInfo> &src, const math::color &color, const math::vector2f &offset, std::uint32_t &instanceCount) {
+        void _onTextDelivered() {
+            if (_charsPending == false && _shadowPending == false && _chars.size()) {
+                _instances.resize(_distanceField ? 3 * _chars.size() : _shadow.size() + _chars.size());
+                _instancesDirty = true;
+            }
+        }
+        // Shadow, outline and glyphs are drawn from the same distance field texels with different edge and its softness
+        // args.z is texel value of edge, args.w is how fast alpha changes with texel value
+        //
+        void _fillDistanceFieldInstances() {
+            const float pxPerUnit = 2.0f * float(resource::FontAtlasProvider::SDF_SPREAD) * float(_fontSize) / float(resource::FontAtlasProvider::SDF_REFERENCE_SIZE);
+            const float outline = _outlineColor.a > 0.0f ? 0.5f - _outlineWidth / pxPerUnit : 0.5f;
+            
+            if (_shadowColor.a > 0.0f) {
+                _fillInstances(_chars, _shadowColor, _shadowOffset, math::vector4f(1.0f, 1.0f, outline, pxPerUnit / float(1 + 2 * _shadowBlur)), _instanceCount);
+            }
+            if (_outlineColor.a > 0.0f) {
+                _fillInstances(_chars, _outlineColor, {}, math::vector4f(1.0f, 1.0f, outline, pxPerUnit), _instanceCount);
+            }
+            
+            _fillInstances(_chars, _fontColor, {}, math::vector4f(1.0f, 1.0f, 0.5f, pxPerUnit), _instanceCount);
+        }
+        void _fillInstances(const std::vector<resource::FontCharInfo> &src, const math::color &color, const math::vector2f &offset, const math::vector4f &args, std::uint32_t &instanceCount) {
             float offsetX = offset.x;
             
             for (auto &ch : src) {
@@ -515,7 +951,7 @@ namespace ui {
                     _instances[instanceCount].positionAndSize = math::vector4f(_globalPosition.x + offsetX + ch.lsb, _globalPosition.y + ch.voffset + offset.y, ch.pxSize.x, ch.pxSize.y);
                     _instances[instanceCount].uvCoords = math::vector4f(ch.txLT, ch.txRB);
                     _instances[instanceCount].color = color;
-                    _instances[instanceCount].args = math::vector4f(1.0f, 0.0f, 0.0f, 0.0f);
+                    _instances[instanceCount].args = args;
                     instanceCount++;
                 }
                 
@@ -530,11 +966,20 @@ namespace ui {
         math::color _shadowColor;
         math::vector2f _shadowOffset;
         std::uint8_t _shadowBlur = 0;
+        bool _distanceField = false;
+        math::color _outlineColor;
+        float _outlineWidth = 0.0f;
         std::string _text;
         std::weak_ptr<foundation::RenderTexture> _textureWeak;
+        std::weak_ptr<foundation::RenderTexture> _shadowTextureWeak;
         std::vector<resource::FontCharInfo> _chars;
         std::vector<resource::FontCharInfo> _shadow;
-        std::vector<DrawingInstance> _instances;
+        std::uint32_t _requestIndex = 0;
+        bool _charsPending = false;
+        bool _shadowPending = false;
+        std::vector<DrawingInstance, foundation::PoolAllocator<DrawingInstance, foundation::MemoryPoolId::UI, MEMORY_TAG_TEXT_INSTANCES>> _instances;
+        std::uint32_t _instanceCount = 0;
+        std::uint32_t _shadowInstanceCount = 0;
     };
 }
 
@@ -557,6 +1002,7 @@ namespace ui {
         const foundation::RenderingInterfacePtr &getRendering() const override { return _rendering; }
         const resource::ResourceProviderPtr &getResourceProvider() const override { return _resourceProvider; }
         const resource::FontAtlasProviderPtr &getFontAtlasProvider() const override { return _fontAtlasProvider; }
+        const std::shared_ptr<InteractionGrid> &getInteractionGrid() const override { return _interactionGrid; }
         
     public:
         auto addPivot(const std::shared_ptr<Element> &parent, PivotParams &&params) -> std::shared_ptr<Pivot> override;
@@ -567,6 +1013,9 @@ namespace ui {
         void clear() override;
         void updateAndDraw(float dtSec) override;
         
+    private:
+        void _addElement(const std::shared_ptr<Element> &parent, const std::shared_ptr<ElementImpl> &element);
+        
     private:
         const foundation::PlatformInterfacePtr _platform;
         const foundation::RenderingInterfacePtr _rendering;
@@ -575,7 +1024,12 @@ namespace ui {
         
         foundation::EventHandlerToken _touchEventsToken;
         foundation::RenderShaderPtr _uiShader;
+        const std::shared_ptr<InteractionGrid> _interactionGrid;
+        std::vector<InteractorImpl *> _interactionCandidates;
+        bool _interactionOrderDirty = false;
         std::list<std::shared_ptr<ElementImpl>> _topLevelElements;
+        math::vector2f _screenSize = math::vector2f(0, 0);
+        DrawList _drawList;
     };
     
     std::shared_ptr<StageInterface> StageInterface::instance(
@@ -607,7 +1061,9 @@ namespace {
         }
         fssrc {
             float4 texcolor = _tex2d(0, input_texcoord);
-            output_color[0] = input_color * _lerp(texcolor, float4(1.0, 1.0, 1.0, texcolor.r), input_args.x);
+            float  sdfalpha = _clamp((texcolor.r - input_args.z) * input_args.w + 0.5);
+            float4 glyphcolor = float4(1.0, 1.0, 1.0, _lerp(texcolor.r, sdfalpha, input_args.y));
+            output_color[0] = input_color * _lerp(texcolor, glyphcolor, input_args.x);
         }
     )";
 }
@@ -624,6 +1080,7 @@ namespace ui {
     , _resourceProvider(resourceProvider)
     , _fontAtlasProvider(fontAtlasProvider)
     , _touchEventsToken(nullptr)
+    , _interactionGrid(std::make_shared<InteractionGrid>())
     {
         _uiShader = _rendering->createShader("stage_element", g_uiShaderSrc, layouts::VTXUIUV);
         _touchEventsToken = _platform->addPointerEventHandler([this](const foundation::PlatformPointerEventArgs &args) {
@@ -636,8 +1093,28 @@ namespace ui {
                 action = ui::Action::MOVE;
             }
             
-            for (const auto &topLevelElement : _topLevelElements) {
-                if (topLevelElement->onInteraction(action, args.pointerID, args.coordinateX, args.coordinateY)) {
+            if (_interactionOrderDirty) {
+                std::uint32_t order = 0;
+                ElementImpl::updateInteractionOrder(_topLevelElements, order);
+                _interactionOrderDirty = false;
+            }
+            
+            // Press can only hit interactors under pointer, move and release go to interactors that have captured it
+            _interactionCandidates.clear();
+            
+            if (action == ui::Action::PRESS) {
+                _interactionGrid->getCandidates(args.coordinateX, args.coordinateY, _interactionCandidates);
+            }
+            else {
+                _interactionGrid->getCaptured(_interactionCandidates);
+            }
+            
+            std::sort(_interactionCandidates.begin(), _interactionCandidates.end(), [](const InteractorImpl *left, const InteractorImpl *right) {
+                return left->getInteractionOrder() < right->getInteractionOrder();
+            });
+            
+            for (InteractorImpl *interactor : _interactionCandidates) {
+                if (interactor->onInteraction(action, args.pointerID, args.coordinateX, args.coordinateY)) {
                     return true;
                 }
             }
@@ -654,12 +1131,7 @@ namespace ui {
         std::shared_ptr<PivotImpl> result = std::make_shared<PivotImpl>(*this, parent);
         result->setAnchor(params.anchorTarget, params.anchorH, params.anchorV, params.anchorOffset.x, params.anchorOffset.y);
         
-        if (parent == nullptr) {
-            _topLevelElements.emplace_back(result);
-        }
-        else {
-            std::dynamic_pointer_cast<ElementImpl>(parent)->attachElement(result);
-        }
+        _addElement(parent, result);
         
         return result;
     }
@@ -673,12 +1145,7 @@ namespace ui {
             result->setActiveArea(params.activeAreaOffset, params.activeAreaRadius);
             result->setTexture(params.texture);
                         
-            if (parent == nullptr) {
-                _topLevelElements.emplace_back(result);
-            }
-            else {
-                std::dynamic_pointer_cast<ElementImpl>(parent)->attachElement(result);
-            }
+            _addElement(parent, result);
         }
         else {
             _platform->logError("[StageInterfaceImpl::addImage] '%s' is not existing texture\n", params.texture);
@@ -696,12 +1163,7 @@ namespace ui {
             result->setActiveArea(params.activeAreaOffset, params.activeAreaRadius);
             result->setTexture(params.texture, params.sliceArgs);
                         
-            if (parent == nullptr) {
-                _topLevelElements.emplace_back(result);
-            }
-            else {
-                std::dynamic_pointer_cast<ElementImpl>(parent)->attachElement(result);
-            }
+            _addElement(parent, result);
         }
         else {
             _platform->logError("[StageInterfaceImpl::addImage] '%s' is not existing texture\n", params.texture);
@@ -715,15 +1177,22 @@ namespace ui {
         std::shared_ptr<TextLineImpl> result = std::make_shared<TextLineImpl>(*this, parent);
         result->setAnchor(params.anchorTarget, params.anchorH, params.anchorV, params.anchorOffset.x, params.anchorOffset.y);
         result->setFontParameters(params.fontColor, params.fontSize, params.shadowOffset, params.shadowColor, params.shadowBlur);
+        result->setDistanceField(params.distanceField, params.outlineColor, params.outlineWidth);
+
+        _addElement(parent, result);
 
+        return result;
+    }
+    
+    void StageInterfaceImpl::_addElement(const std::shared_ptr<Element> &parent, const std::shared_ptr<ElementImpl> &element) {
         if (parent == nullptr) {
-            _topLevelElements.emplace_back(result);
+            _topLevelElements.emplace_back(element);
         }
         else {
-            std::dynamic_pointer_cast<ElementImpl>(parent)->attachElement(result);
+            std::dynamic_pointer_cast<ElementImpl>(parent)->attachElement(element);
         }
-
-        return result;
+        
+        _interactionOrderDirty = true;
     }
     
     void StageInterfaceImpl::clear() {
@@ -731,12 +1200,28 @@ namespace ui {
     }
     
     void StageInterfaceImpl::updateAndDraw(float dtSec) {
-        _rendering->forTarget(nullptr, nullptr, math::color(0.3f, 0.3f, 0.3f, 1.0f), [&](foundation::RenderingInterface &rendering) {
-            rendering.applyShader(_uiShader, foundation::RenderTopology::TRIANGLESTRIP, foundation::BlendType::MIXING, foundation::DepthBehavior::DISABLED);
+        const math::vector2f screenSize = math::vector2f(_platform->getScreenWidth(), _platform->getScreenHeight());
+        
+        if (_screenSize.x != screenSize.x || _screenSize.y != screenSize.y) {
+            _screenSize = screenSize;
+            
             for (const auto &topLevelElement : _topLevelElements) {
-                topLevelElement->updateCoordinates();
-                topLevelElement->draw();
+                topLevelElement->invalidateLayout();
             }
+        }
+        
+        ElementImpl::updateLayout(_topLevelElements);
+        _drawList.begin();
+        
+        for (const auto &topLevelElement : _topLevelElements) {
+            topLevelElement->draw(_drawList);
+        }
+        
+        _drawList.end();
+        
+        _rendering->forTarget(nullptr, nullptr, math::color(0.3f, 0.3f, 0.3f, 1.0f), [&](foundation::RenderingInterface &rendering) {
+            rendering.applyShader(_uiShader, foundation::RenderTopology::TRIANGLESTRIP, foundation::BlendType::MIXING, foundation::DepthBehavior::DISABLED);
+            _drawList.flush(rendering);
         });
     }
     
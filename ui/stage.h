@@ -122,6 +122,10 @@ namespace ui {
             const math::color shadowColor = math::color(0.0f, 0.0f, 0.0f, 0.0f);
             const math::vector2f shadowOffset = {0, 0};
             const std::uint8_t shadowBlur = 0;
+            // Glyphs are scaled from one distance field for all sizes. Shadow, glow (shadow without offset) and outline are made by shader
+            const bool distanceField = false;
+            const math::color outlineColor = math::color(0.0f, 0.0f, 0.0f, 0.0f);
+            const float outlineWidth = 0.0f;
         };
         struct TextBlockParams {
             const std::shared_ptr<StageInterface::Element> anchorTarget;